@@ -39,6 +39,16 @@ public:
         return _max;
     }
 
+    Vector3d center() const {
+        return 0.5 * (this->_min + this->_max);
+    }
+
+//    表面积，SAH 用来估计光线打中的概率
+    double area() const {
+        Vector3d extent = this->_max - this->_min;
+        return 2.0 * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+    }
+
     bool hit(const Ray &ray, double tMin, double tMax) const {
         for (int i = 0; i < 3; i++) {
             double invDir = 1.0 / ray.direction()[i];
@@ -1,72 +1,284 @@
 #ifndef BVH_HPP
 #define BVH_HPP
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
 #include "hitable.hpp"
 
+/**
+ * 分箱 SAH 建树参数
+ * 代价 = traversalCost + (左面积 * 左个数 + 右面积 * 右个数) / 父面积 * intersectionCost
+ */
+struct BVHBuildOptions {
+    int binCount = 16;              // 每个轴上质心范围分成多少个箱
+    int maxLeafSize = 4;            // 叶子最多放几个物体，超过时无论代价如何都继续划分
+    double traversalCost = 1.0;     // 访问一个内部节点的代价
+    double intersectionCost = 1.0;  // 和一个物体求交的代价
+};
+
+/**
+ * 建树统计
+ * sahCost 是整棵树的期望代价，按根节点面积归一化
+ */
+struct BVHBuildStats {
+    int primitiveCount = 0;
+    int nodeCount = 0;
+    int leafCount = 0;
+    int maxLeafSize = 0;
+    int maxDepth = 0;
+    double sahCost = 0;
+    double buildSeconds = 0;
+
+    friend std::ostream &operator<<(std::ostream &os, const BVHBuildStats &stats) {
+        os << "primitives: " << stats.primitiveCount << " nodes: " << stats.nodeCount
+           << " leaves: " << stats.leafCount << " max leaf size: " << stats.maxLeafSize
+           << " max depth: " << stats.maxDepth << " sah cost: " << stats.sahCost
+           << " build: " << stats.buildSeconds * 1000 << " ms";
+        return os;
+    }
+};
+
+//每个线程访问过的 BVH 节点数，和 ThreadRayCount 一起可以算出每条光线平均访问多少节点
+thread_local uint64_t ThreadBVHNodeVisits = 0;
+
 class BVHNode : public Hitable {
 private:
+//    建树前算好每个物体的包围盒和质心，建树过程中不再调用 boundingBox
+    struct BuildPrimitive {
+        AABB box;
+        Vector3d centroid;
+        Hitable *hitable;
+    };
+
+    struct BuildContext {
+        BVHBuildOptions options;
+        std::vector<BuildPrimitive> primitives;
+        BVHBuildStats stats;
+        double rootArea;
+    };
+
+    struct Bin {
+        AABB box;
+        int count = 0;
+    };
+
     AABB _box;
     Hitable *_left;
     Hitable *_right;
-public:
-    BVHNode() {}
 
-    BVHNode(std::vector<Hitable *> list, double time0, double time1) {
-        if (list.size() == 1) {
-            this->_left = list[0];
-            this->_right = list[0];
-        } else if (list.size() == 2) {
-            this->_left = list[0];
-            this->_right = list[1];
-        } else {
-//            随机一个维度排序
-            int axis = int(3 * drand48());
-            std::sort(list.begin(), list.end(), [axis,time0,time1](Hitable *h1, Hitable *h2) {
-                AABB box1, box2;
-                bool ret1 = h1->boundingBox(time0, time1, box1);
-                bool ret2 = h2->boundingBox(time0, time1, box2);
-                if (!ret1 || !ret2) {
-                    std::runtime_error("hitable no bound box");
+    BVHNode(BuildContext &context, int begin, int end, int depth) {
+        this->build(context, begin, end, depth);
+    }
+
+    static AABB RangeBox(const BuildContext &context, int begin, int end) {
+        AABB box = context.primitives[begin].box;
+        for (int i = begin + 1; i < end; i++) {
+            box = AABB::Union(box, context.primitives[i].box);
+        }
+        return box;
+    }
+
+    static AABB CentroidBox(const BuildContext &context, int begin, int end) {
+        Vector3d min = context.primitives[begin].centroid, max = min;
+        for (int i = begin + 1; i < end; i++) {
+            min = min.cwiseMin(context.primitives[i].centroid);
+            max = max.cwiseMax(context.primitives[i].centroid);
+        }
+        return AABB(min, max);
+    }
+
+    static int BinIndex(const BuildContext &context, double centroid, double min, double extent) {
+        int bin = int(context.options.binCount * (centroid - min) / extent);
+        return std::min(std::max(bin, 0), context.options.binCount - 1);
+    }
+
+//    在 [begin, end) 上找代价最小的划分，返回代价，axis / splitBin 为划分位置，找不到时返回 Infinity
+    static double FindSplit(const BuildContext &context, int begin, int end, const AABB &box,
+                            const AABB &centroidBox, int &axis, int &splitBin) {
+        const int binCount = context.options.binCount;
+        double best = Infinity;
+        std::vector<Bin> bins(binCount);
+        std::vector<double> rightArea(binCount);
+        for (int a = 0; a < 3; a++) {
+            double min = centroidBox.min()[a];
+            double extent = centroidBox.max()[a] - min;
+            if (extent <= 0) {
+                continue;
+            }
+            std::fill(bins.begin(), bins.end(), Bin());
+            for (int i = begin; i < end; i++) {
+                const BuildPrimitive &primitive = context.primitives[i];
+                Bin &bin = bins[BinIndex(context, primitive.centroid[a], min, extent)];
+                bin.box = bin.count ? AABB::Union(bin.box, primitive.box) : primitive.box;
+                bin.count++;
+            }
+//            从右往左扫一遍记下右侧面积，再从左往右扫一遍算代价
+            AABB accumulated;
+            int rightCount = 0;
+            for (int b = binCount - 1; b > 0; b--) {
+                if (bins[b].count) {
+                    accumulated = rightCount ? AABB::Union(accumulated, bins[b].box) : bins[b].box;
+                    rightCount += bins[b].count;
+                }
+                rightArea[b] = rightCount ? accumulated.area() : 0;
+            }
+            int leftCount = 0;
+            for (int b = 0; b < binCount - 1; b++) {
+                if (bins[b].count) {
+                    accumulated = leftCount ? AABB::Union(accumulated, bins[b].box) : bins[b].box;
+                    leftCount += bins[b].count;
+                }
+                rightCount = (end - begin) - leftCount;
+                if (leftCount == 0 || rightCount == 0) {
+                    continue;
+                }
+                double cost = context.options.traversalCost +
+                              (accumulated.area() * leftCount + rightArea[b + 1] * rightCount) / box.area() *
+                              context.options.intersectionCost;
+                if (cost < best) {
+                    best = cost;
+                    axis = a;
+                    splitBin = b;
                 }
-                return box1.min()[axis] < box2.min()[axis];
-            });
+            }
+        }
+        return best;
+    }
 
-            auto beginning = list.begin();
-            auto middling = list.begin() + (list.size() / 2);
-            auto ending = list.end();
+//    划分 [begin, end)，返回右半边的起点
+    static int Partition(BuildContext &context, int begin, int end, const AABB &box, const AABB &centroidBox) {
+        int axis = 0, splitBin = 0;
+        double splitCost = FindSplit(context, begin, end, box, centroidBox, axis, splitBin);
+        auto first = context.primitives.begin() + begin;
+        auto last = context.primitives.begin() + end;
+        if (splitCost == Infinity) {
+//            质心重合，SAH 无法区分，按下标对半分
+            return begin + (end - begin) / 2;
+        }
+        double min = centroidBox.min()[axis];
+        double extent = centroidBox.max()[axis] - min;
+        auto middle = std::partition(first, last, [&](const BuildPrimitive &primitive) {
+            return BinIndex(context, primitive.centroid[axis], min, extent) <= splitBin;
+        });
+        return int(middle - context.primitives.begin());
+    }
 
-            auto leftList = std::vector<Hitable *>(beginning, middling);
-            auto rightList = std::vector<Hitable *>(middling, ending);
+//    物体少于 maxLeafSize 并且直接求交比再划分便宜时做叶子
+    static bool ShouldBeLeaf(const BuildContext &context, int begin, int end, const AABB &box) {
+        int count = end - begin;
+        if (count == 1) {
+            return true;
+        }
+        if (count > context.options.maxLeafSize) {
+            return false;
+        }
+        AABB centroidBox = CentroidBox(context, begin, end);
+        int axis, splitBin;
+        return count * context.options.intersectionCost <=
+               FindSplit(context, begin, end, box, centroidBox, axis, splitBin);
+    }
 
-            this->_left = new BVHNode(leftList, time0, time1);
-            this->_right = new BVHNode(rightList, time0, time1);
+    static Hitable *BuildChild(BuildContext &context, int begin, int end, int depth) {
+        AABB box = RangeBox(context, begin, end);
+        if (!ShouldBeLeaf(context, begin, end, box)) {
+            return new BVHNode(context, begin, end, depth);
         }
-        AABB box1, box2;
-        bool ret1 = this->_left->boundingBox(time0, time1, box1);
-        bool ret2 = this->_right->boundingBox(time0, time1, box2);
-        if (!ret1 || !ret2) {
-            std::runtime_error("hitable no bound box");
+        double area = context.rootArea > 0 ? box.area() / context.rootArea : 1;
+        context.stats.leafCount++;
+        context.stats.maxLeafSize = std::max(context.stats.maxLeafSize, end - begin);
+        context.stats.maxDepth = std::max(context.stats.maxDepth, depth);
+        context.stats.sahCost += area * (end - begin) * context.options.intersectionCost;
+        if (end - begin == 1) {
+            return context.primitives[begin].hitable;
         }
-        this->_box = AABB::Union(box1, box2);
+        std::vector<Hitable *> list;
+        for (int i = begin; i < end; i++) {
+            list.push_back(context.primitives[i].hitable);
+        }
+        return new HitableList(list);
     }
 
-    virtual bool hit(const Ray &ray, double tMin, double tMax, HitRecord &record) const {
-        if (this->_box.hit(ray, tMin, tMax)) {
-            HitRecord leftRec, rightRec;
-            bool hitLeft = this->_left->hit(ray, tMin, tMax, leftRec);
-            bool hitRight = this->_right->hit(ray, tMin, tMax, rightRec);
-            if (hitLeft && hitRight) {
-                record = leftRec.t < rightRec.t ? leftRec : rightRec;
-                return true;
-            } else if (hitLeft) {
-                record = leftRec;
-                return true;
-            } else if (hitRight) {
-                record = rightRec;
-                return true;
+    void build(BuildContext &context, int begin, int end, int depth) {
+        this->_box = RangeBox(context, begin, end);
+        double area = context.rootArea > 0 ? this->_box.area() / context.rootArea : 1;
+        context.stats.nodeCount++;
+        context.stats.sahCost += area * context.options.traversalCost;
+        if (end - begin == 1) {
+//            只有一个物体的树，左右是同一个
+            this->_left = this->_right = BuildChild(context, begin, end, depth + 1);
+            return;
+        }
+        AABB centroidBox = CentroidBox(context, begin, end);
+        int middle = Partition(context, begin, end, this->_box, centroidBox);
+        this->_left = BuildChild(context, begin, middle, depth + 1);
+        this->_right = BuildChild(context, middle, end, depth + 1);
+    }
+
+public:
+    BVHNode() {}
+
+    /**
+     * 分箱 SAH 建树，结果只由输入顺序决定
+     * @param stats 不为空时写入建树统计
+     */
+    BVHNode(const std::vector<Hitable *> &list, double time0, double time1,
+            const BVHBuildOptions &options = BVHBuildOptions(), BVHBuildStats *stats = nullptr) {
+        auto start = std::chrono::steady_clock::now();
+        if (list.empty()) {
+            throw std::runtime_error("bvh of empty list");
+        }
+        BuildContext context;
+        context.options = options;
+        context.options.binCount = std::max(2, options.binCount);
+        context.options.maxLeafSize = std::max(1, options.maxLeafSize);
+        context.primitives.reserve(list.size());
+        for (Hitable *hitable:list) {
+            AABB box;
+            if (!hitable->boundingBox(time0, time1, box)) {
+                throw std::runtime_error("hitable no bound box");
             }
+            context.primitives.push_back(BuildPrimitive{box, box.center(), hitable});
+        }
+        context.rootArea = RangeBox(context, 0, int(list.size())).area();
+        context.stats.primitiveCount = int(list.size());
+        this->build(context, 0, int(list.size()), 0);
+        context.stats.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (stats) {
+            *stats = context.stats;
+        }
+    }
+
+    const AABB &box() const {
+        return this->_box;
+    }
+
+    Hitable *left() const {
+        return this->_left;
+    }
+
+    Hitable *right() const {
+        return this->_right;
+    }
+
+    virtual bool hit(const Ray &ray, double tMin, double tMax, HitRecord &record) const {
+        ThreadBVHNodeVisits++;
+        if (!this->_box.hit(ray, tMin, tMax)) {
+            return false;
+        }
+//        右子树只需要找比左子树更近的交点
+        bool hitLeft = this->_left->hit(ray, tMin, tMax, record);
+        if (this->_right == this->_left) {
+            return hitLeft;
+        }
+        HitRecord rightRec;
+        if (this->_right->hit(ray, tMin, hitLeft ? record.t : tMax, rightRec)) {
+            record = rightRec;
+            return true;
         }
-        return false;
+        return hitLeft;
     }
 
     virtual bool boundingBox(double time0, double time1, AABB &box) const {
@@ -158,12 +158,11 @@ public:
         bool hit = false;
         double closest = tMax;
         for (const Hitable *hitable:this->_list) {
-            if (hitable->hit(ray, tMin, tMax, temp)) {
+//            只找比已有交点更近的
+            if (hitable->hit(ray, tMin, closest, temp)) {
                 hit = true;
-                if (closest > temp.t) {
-                    closest = temp.t;
-                    record = temp;
-                }
+                closest = temp.t;
+                record = temp;
             }
         }
         return hit;
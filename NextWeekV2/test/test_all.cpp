@@ -18,8 +18,12 @@
 
 using namespace std;
 
+//求交的光线数，和 ThreadBVHNodeVisits 一起算每条光线访问的 BVH 节点数
+uint64_t RayCount = 0;
+
 Vector3d color(const Ray &ray, Hitable *world, int depth) {
     HitRecord record;
+    RayCount++;
 //    ignore hit when t is near zero
     if (world->hit(ray, 0.001, MAXFLOAT, record)) {
         Ray scattered;
@@ -94,11 +98,9 @@ Hitable *cornellBox() {
     }
     list.push_back(new Translate(new RotateY(new BVHNode(boxes, 0, 1), 15), Vector3d(-100, 270, 395)));
 
-    auto start = std::chrono::system_clock::now();
-    Hitable *bvh = new BVHNode(list, 0, 1);
-    auto stop = std::chrono::system_clock::now();
-    std::cout << "build bvh cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
-              << " seconds\n";
+    BVHBuildStats stats;
+    Hitable *bvh = new BVHNode(list, 0, 1, BVHBuildOptions(), &stats);
+    std::cout << "build bvh cost: " << stats << "\n";
 
 //    return new HitableList(list);
     return bvh;
@@ -151,4 +153,5 @@ int main() {
     auto stop = std::chrono::system_clock::now();
     std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
               << " seconds\n";
+    std::cout << "rays: " << RayCount << " bvh nodes per ray: " << double(ThreadBVHNodeVisits) / RayCount << "\n";
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define RANDOM_HPP
 
 #include <random>
+#include <ctime>
 
 struct RandomConfig {
     std::default_random_engine RandomEngine = std::default_random_engine(time(nullptr));
@@ -12,7 +13,7 @@ class Random {
 public:
 //        double 下 p(end) = 0 因此并不关心
     static double GenUniformRandom(double start, double end) {
-        std::uniform_int_distribution<double> dis(start * RandomConfigInstance.RandomScale,
+        std::uniform_real_distribution<double> dis(start * RandomConfigInstance.RandomScale,
                                                   end * RandomConfigInstance.RandomScale);
         return dis(RandomConfigInstance.RandomEngine) / RandomConfigInstance.RandomScale;
     }
@@ -0,0 +1,159 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+
+/**
+ * 线性（bump）分配器：按块向系统要内存，块内只移动指针，不能单独释放某个对象
+ * 同一个 Arena 里的对象按创建顺序紧挨着放，release 时一次性归还所有块
+ * 有非平凡析构函数的对象（例如持有 std::vector 的 HitableList、LinearBVH）登记下来，release 时倒序析构
+ */
+class Arena {
+public:
+    static const size_t HugePageSize = size_t(2) << 20;
+
+private:
+    struct Block {
+        char *data;
+        size_t size;
+        bool mapped;    // mmap 出来的块用 munmap 归还
+    };
+
+    struct Destructor {
+        void *object;
+        void (*destroy)(void *);
+    };
+
+    size_t _blockSize;
+    bool _hugePages;
+    std::vector<Block> _blocks;
+    std::vector<Destructor> _destructors;
+    char *_current = nullptr;
+    size_t _remaining = 0;
+    size_t _used = 0;
+    size_t _count = 0;
+
+    template<typename T>
+    static void Destroy(void *object) {
+        static_cast<T *>(object)->~T();
+    }
+
+//    大页：先试 MAP_HUGETLB（需要系统预留大页），不行再用普通页加 MADV_HUGEPAGE 请求透明大页
+    Block allocateBlock(size_t size) {
+        if (this->_hugePages) {
+            size = (size + HugePageSize - 1) / HugePageSize * HugePageSize;
+            void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+            p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+            if (p == MAP_FAILED) {
+                p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (p == MAP_FAILED) {
+                    throw std::bad_alloc();
+                }
+#ifdef MADV_HUGEPAGE
+                madvise(p, size, MADV_HUGEPAGE);
+#endif
+            }
+            return Block{static_cast<char *>(p), size, true};
+        }
+        return Block{static_cast<char *>(::operator new(size)), size, false};
+    }
+
+public:
+    explicit Arena(size_t blockSize = 256 << 10, bool hugePages = false) :
+            _blockSize(blockSize), _hugePages(hugePages) {}
+
+    Arena(const Arena &) = delete;
+
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena() {
+        this->release();
+    }
+
+    void *allocate(size_t size, size_t alignment) {
+        size_t padding = (alignment - reinterpret_cast<uintptr_t>(this->_current) % alignment) % alignment;
+        if (!this->_current || padding + size > this->_remaining) {
+//            放不下就开新块，块里剩下的空间不再使用；特别大的对象单独占一块
+            Block block = this->allocateBlock(std::max(this->_blockSize, size + alignment));
+            this->_blocks.push_back(block);
+            this->_current = block.data;
+            this->_remaining = block.size;
+            padding = (alignment - reinterpret_cast<uintptr_t>(this->_current) % alignment) % alignment;
+        }
+        char *p = this->_current + padding;
+        this->_current = p + size;
+        this->_remaining -= padding + size;
+        this->_used += size;
+        return p;
+    }
+
+//    在 arena 里构造一个对象；对齐至少 16 字节，满足 Eigen 定长向量的要求
+    template<typename T, typename... Args>
+    T *create(Args &&... args) {
+        void *p = this->allocate(sizeof(T), std::max(alignof(T), size_t(16)));
+        T *object = new(p) T(std::forward<Args>(args)...);
+        this->_count++;
+        if (!std::is_trivially_destructible<T>::value) {
+            this->_destructors.push_back(Destructor{object, &Destroy<T>});
+        }
+        return object;
+    }
+
+//    arena 为空时退回到 new，不归 arena 管理的调用方保持原来的行为
+    template<typename T, typename... Args>
+    static T *New(Arena *arena, Args &&... args) {
+        if (arena) {
+            return arena->create<T>(std::forward<Args>(args)...);
+        }
+        return new T(std::forward<Args>(args)...);
+    }
+
+//    析构登记过的对象并归还所有块，之后 arena 可以继续使用
+    void release() {
+        for (auto it = this->_destructors.rbegin(); it != this->_destructors.rend(); ++it) {
+            it->destroy(it->object);
+        }
+        this->_destructors.clear();
+        for (const Block &block : this->_blocks) {
+            if (block.mapped) {
+                munmap(block.data, block.size);
+            } else {
+                ::operator delete(block.data);
+            }
+        }
+        this->_blocks.clear();
+        this->_current = nullptr;
+        this->_remaining = 0;
+        this->_used = 0;
+        this->_count = 0;
+    }
+
+//    对象实际占用的字节数（不含对齐和块尾浪费的空间）
+    size_t usedBytes() const {
+        return this->_used;
+    }
+
+    size_t reservedBytes() const {
+        size_t bytes = 0;
+        for (const Block &block : this->_blocks) {
+            bytes += block.size;
+        }
+        return bytes;
+    }
+
+    size_t objectCount() const {
+        return this->_count;
+    }
+};
+
+#endif //ARENA_HPP
@@ -5,15 +5,15 @@
 
 class AABB {
 private:
-    Vector3d _min, _max;
+    Vector3 _min, _max;
 public:
     static AABB Union(AABB box0, AABB box1) {
-        Vector3d min{
+        Vector3 min{
                 std::min(box0._min.x(), box1._min.x()),
                 std::min(box0._min.y(), box1._min.y()),
                 std::min(box0._min.z(), box1._min.z())
         };
-        Vector3d max{
+        Vector3 max{
                 std::max(box0._max.x(), box1._max.x()),
                 std::max(box0._max.y(), box1._max.y()),
                 std::max(box0._max.z(), box1._max.z())
@@ -29,31 +29,48 @@ public:
 public:
     AABB() {}
 
-    AABB(const Vector3d &min, const Vector3d &max) : _min(min), _max(max) {}
+    AABB(const Vector3 &min, const Vector3 &max) : _min(min), _max(max) {}
 
-    const Vector3d &min() const {
+    const Vector3 &min() const {
         return _min;
     }
 
-    const Vector3d &max() const {
+    const Vector3 &max() const {
         return _max;
     }
 
-    bool hit(const Ray &ray, double tMin, double tMax) const {
+    Vector3 center() const {
+        return 0.5 * (this->_min + this->_max);
+    }
+
+//    表面积，SAH 用来估计光线打中的概率
+    Float area() const {
+        Vector3 extent = this->_max - this->_min;
+        return 2.0 * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+    }
+
+/**
+     * 一个轴上的板测试，near/far 是已经按光线方向符号挑好的近端和远端平面，不需要再交换
+     * 方向分量为 0 且原点正好在平面上时 0 * inf 得到 NaN，NaN 的比较结果为 false，区间不收紧，相当于忽略这个轴
+     * 三个轴都算完再比较一次，没有依赖数据的分支
+     */
+    static void ClipSlab(Float near, Float far, Float origin, Float invDir, Float &tMin, Float &tMax) {
+        Float t0 = (near - origin) * invDir;
+        Float t1 = (far - origin) * invDir;
+        tMin = t0 > tMin ? t0 : tMin;
+        tMax = t1 < tMax ? t1 : tMax;
+    }
+
+    bool hit(const Ray &ray, Float tMin, Float tMax) const {
+        const Vector3 &origin = ray.origin();
+        const Vector3 &invDir = ray.invDirection();
+        const int *sign = ray.sign();
         for (int i = 0; i < 3; i++) {
-            double invDir = 1.0 / ray.direction()[i];
-            double t0 = (this->_min[i] - ray.origin()[i]) * invDir;
-            double t1 = (this->_max[i] - ray.origin()[i]) * invDir;
-            if (invDir < 0.0) {
-                std::swap(t0, t1);
-            }
-            tMin = std::max(t0, tMin);
-            tMax = std::min(t1, tMax);
-            if (tMax <= tMin) {
-                return false;
-            }
+            const Vector3 &near = sign[i] ? this->_max : this->_min;
+            const Vector3 &far = sign[i] ? this->_min : this->_max;
+            ClipSlab(near[i], far[i], origin[i], invDir[i], tMin, tMax);
         }
-        return true;
+        return tMin < tMax;
     }
 };
 
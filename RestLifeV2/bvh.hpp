@@ -1,75 +1,617 @@
 #ifndef BVH_HPP
 #define BVH_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
 #include "hitable.hpp"
+#include "arena.hpp"
+#include "bvh_stats.hpp"
+#include "thread_pool.hpp"
+
+enum class BVHBuildMethod {
+    SAH,        // 分箱 SAH，树的质量好
+    Morton      // 按质心的 Morton 码排序后按最高的不同位划分（LBVH），建得快
+};
+
+/**
+ * 建树参数
+ * SAH 代价 = traversalCost + (左面积 * 左个数 + 右面积 * 右个数) / 父面积 * intersectionCost
+ */
+struct BVHBuildOptions {
+    BVHBuildMethod method = BVHBuildMethod::SAH;
+    int binCount = 16;              // 每个轴上质心范围分成多少个箱
+    int maxLeafSize = 4;            // 叶子最多放几个物体，超过时无论代价如何都继续划分
+    double traversalCost = 1.0;     // 访问一个内部节点的代价
+    double intersectionCost = 1.0;  // 和一个物体求交的代价
+    ThreadPool *pool = nullptr;     // 不为空时并行建树
+    int parallelThreshold = 4096;   // 物体数超过这个值的子树才拆成并行任务
+    Arena *arena = nullptr;         // 不为空时 BVHNode 的节点和叶子列表从这里分配
+    int maxDepth = 0;               // 叶子深度的上限，0 表示不限；快到上限的子树改为按质心中位数对半分
+
+//    复制一份，maxDepth 不超过 depth；用固定大小遍历栈的 BVH 用它保证栈放得下
+    BVHBuildOptions limitDepth(int depth) const {
+        BVHBuildOptions options = *this;
+        options.maxDepth = options.maxDepth > 0 ? std::min(options.maxDepth, depth) : depth;
+        return options;
+    }
+};
+
+/**
+ * 建树统计
+ * sahCost 是整棵树的期望代价，按根节点面积归一化
+ * overlap 是所有内部节点两个子盒子相交部分的面积之和，同样按根节点面积归一化，越大说明同一条光线越容易两边都要走
+ */
+struct BVHBuildStats {
+    int primitiveCount = 0;
+    int nodeCount = 0;
+    int leafCount = 0;
+    int maxLeafSize = 0;
+    int maxDepth = 0;
+    double sahCost = 0;
+    double overlap = 0;
+    double buildSeconds = 0;
+    std::vector<int> depthHistogram;        // 每个深度上的叶子数
+    std::vector<int> leafSizeHistogram;     // 每种物体数的叶子有多少个
+
+    friend std::ostream &operator<<(std::ostream &os, const BVHBuildStats &stats) {
+        os << "primitives: " << stats.primitiveCount << " nodes: " << stats.nodeCount
+           << " leaves: " << stats.leafCount << " max leaf size: " << stats.maxLeafSize
+           << " max depth: " << stats.maxDepth << " sah cost: " << stats.sahCost
+           << " overlap: " << stats.overlap << " build: " << stats.buildSeconds * 1000 << " ms";
+        return os;
+    }
+
+//    多行的汇总，带叶子深度和叶子大小的分布
+    void report(std::ostream &os) const {
+        os << *this << "\n  leaf depth:";
+        for (size_t depth = 0; depth < this->depthHistogram.size(); depth++) {
+            if (this->depthHistogram[depth] > 0) {
+                os << " " << depth << ":" << this->depthHistogram[depth];
+            }
+        }
+        os << "\n  leaf size:";
+        for (size_t size = 0; size < this->leafSizeHistogram.size(); size++) {
+            if (this->leafSizeHistogram[size] > 0) {
+                os << " " << size << ":" << this->leafSizeHistogram[size];
+            }
+        }
+        os << "\n";
+    }
+};
+
+/**
+ * BVH 建树
+ * 建好的树是一个节点数组，0 号是根；叶子引用 primitives() 中连续的一段，物体数组原地划分，不复制子列表
+ * 有 k 个物体的子树最多 2k - 1 个节点，所以 [begin, end) 的左子树从 index + 1 开始，右子树从 index + 2 * 左边个数 开始，
+ * 各个子树写数组中互不重叠的一段，可以并行建，节点编号也与线程数无关（数组中会有空位）
+ * BVHNode、LinearBVH 都从这里生成
+ */
+class BVHBuilder {
+public:
+    struct Primitive {
+        AABB box;
+        Vector3 centroid;
+        Hitable *hitable;
+    };
+
+    struct Node {
+        AABB box;
+        int left = -1, right = -1;  // 内部节点的两个子节点
+        int begin = 0, count = 0;   // 叶子的物体范围，count 为 0 表示内部节点
+        int axis = 0;               // 划分轴
+
+        bool leaf() const {
+            return this->count > 0;
+        }
+    };
+
+private:
+    struct Bin {
+        AABB box;
+        int count = 0;
+    };
+
+    BVHBuildOptions _options;
+    std::vector<Primitive> _primitives;
+    std::vector<uint32_t> _codes;       // Morton 码，和 _primitives 一起排序
+    std::vector<Node> _nodes;
+    BVHBuildStats _stats;
+
+    static AABB Union(const AABB &box0, const AABB &box1, bool empty) {
+        return empty ? box1 : AABB::Union(box0, box1);
+    }
+
+    bool parallel(int count) const {
+        return this->_options.pool && count > this->_options.parallelThreshold;
+    }
+
+//    把 [begin, end) 分块（物体多时并行）做 body(chunkBegin, chunkEnd, chunk)，返回块数
+    template<typename Body>
+    int chunked(int begin, int end, const Body &body) const {
+        int count = end - begin;
+        if (!this->parallel(count)) {
+            body(begin, end, 0);
+            return 1;
+        }
+        int grain = this->_options.parallelThreshold;
+        int chunks = (count + grain - 1) / grain;
+        this->_options.pool->parallelFor(chunks, [&](int chunk) {
+            body(begin + chunk * grain, std::min(end, begin + (chunk + 1) * grain), chunk);
+        });
+        return chunks;
+    }
+
+//    物体包围盒的并集和质心的包围盒
+    void rangeBoxes(int begin, int end, AABB &box, AABB &centroids) const {
+        int chunks = std::max(1, (end - begin + this->_options.parallelThreshold - 1) / this->_options.parallelThreshold);
+        std::vector<AABB> boxes(chunks), centroidBoxes(chunks);
+        chunks = this->chunked(begin, end, [&](int chunkBegin, int chunkEnd, int chunk) {
+            Vector3 min = this->_primitives[chunkBegin].box.min(), max = this->_primitives[chunkBegin].box.max();
+            Vector3 cMin = this->_primitives[chunkBegin].centroid, cMax = cMin;
+            for (int i = chunkBegin + 1; i < chunkEnd; i++) {
+                min = min.cwiseMin(this->_primitives[i].box.min());
+                max = max.cwiseMax(this->_primitives[i].box.max());
+                cMin = cMin.cwiseMin(this->_primitives[i].centroid);
+                cMax = cMax.cwiseMax(this->_primitives[i].centroid);
+            }
+            boxes[chunk] = AABB(min, max);
+            centroidBoxes[chunk] = AABB(cMin, cMax);
+        });
+        box = boxes[0];
+        centroids = centroidBoxes[0];
+        for (int chunk = 1; chunk < chunks; chunk++) {
+            box = AABB::Union(box, boxes[chunk]);
+            centroids = AABB::Union(centroids, centroidBoxes[chunk]);
+        }
+    }
+
+    int binIndex(double centroid, double min, double extent) const {
+        int bin = int(this->_options.binCount * (centroid - min) / extent);
+        return std::min(std::max(bin, 0), this->_options.binCount - 1);
+    }
+
+//    在 [begin, end) 上找代价最小的划分，返回代价，axis / splitBin 为划分位置，找不到时返回 Infinity
+    double findSplit(int begin, int end, const AABB &box, const AABB &centroids, int &axis, int &splitBin) const {
+        const int binCount = this->_options.binCount;
+        double best = Infinity;
+        std::vector<Bin> bins(binCount);
+        std::vector<double> rightArea(binCount);
+        for (int a = 0; a < 3; a++) {
+            double min = centroids.min()[a];
+            double extent = centroids.max()[a] - min;
+            if (extent <= 0) {
+                continue;
+            }
+//            每块各自分箱再按块的顺序合并，结果与是否并行无关
+            std::fill(bins.begin(), bins.end(), Bin());
+            auto binRange = [&](int chunkBegin, int chunkEnd, std::vector<Bin> &target) {
+                for (int i = chunkBegin; i < chunkEnd; i++) {
+                    const Primitive &primitive = this->_primitives[i];
+                    Bin &bin = target[this->binIndex(primitive.centroid[a], min, extent)];
+                    bin.box = Union(bin.box, primitive.box, bin.count == 0);
+                    bin.count++;
+                }
+            };
+            if (!this->parallel(end - begin)) {
+                binRange(begin, end, bins);
+            } else {
+                int chunks = (end - begin + this->_options.parallelThreshold - 1) / this->_options.parallelThreshold;
+                std::vector<std::vector<Bin>> chunkBins(chunks, std::vector<Bin>(binCount));
+                this->chunked(begin, end, [&](int chunkBegin, int chunkEnd, int chunk) {
+                    binRange(chunkBegin, chunkEnd, chunkBins[chunk]);
+                });
+                for (int chunk = 0; chunk < chunks; chunk++) {
+                    for (int b = 0; b < binCount; b++) {
+                        if (chunkBins[chunk][b].count) {
+                            bins[b].box = Union(bins[b].box, chunkBins[chunk][b].box, bins[b].count == 0);
+                            bins[b].count += chunkBins[chunk][b].count;
+                        }
+                    }
+                }
+            }
+//            从右往左扫一遍记下右侧面积，再从左往右扫一遍算代价
+            AABB accumulated;
+            int rightCount = 0;
+            for (int b = binCount - 1; b > 0; b--) {
+                if (bins[b].count) {
+                    accumulated = Union(accumulated, bins[b].box, rightCount == 0);
+                    rightCount += bins[b].count;
+                }
+                rightArea[b] = rightCount ? accumulated.area() : 0;
+            }
+            int leftCount = 0;
+            for (int b = 0; b < binCount - 1; b++) {
+                if (bins[b].count) {
+                    accumulated = Union(accumulated, bins[b].box, leftCount == 0);
+                    leftCount += bins[b].count;
+                }
+                rightCount = (end - begin) - leftCount;
+                if (leftCount == 0 || rightCount == 0) {
+                    continue;
+                }
+                double cost = this->_options.traversalCost +
+                              (accumulated.area() * leftCount + rightArea[b + 1] * rightCount) / box.area() *
+                              this->_options.intersectionCost;
+                if (cost < best) {
+                    best = cost;
+                    axis = a;
+                    splitBin = b;
+                }
+            }
+        }
+        return best;
+    }
+
+    static int LongestAxis(const AABB &box) {
+        int axis = 0;
+        for (int a = 1; a < 3; a++) {
+            if (box.max()[a] - box.min()[a] > box.max()[axis] - box.min()[axis]) {
+                axis = a;
+            }
+        }
+        return axis;
+    }
+
+//    从 depth 层往下按 SAH 划分可能超过 maxDepth 时返回 true，
+//    之后按中位数对半分，count 个物体最多再用 ceil(log2(count)) 层
+    bool nearDepthLimit(int depth, int count) const {
+        if (this->_options.maxDepth <= 0) {
+            return false;
+        }
+        int levels = 0;
+        while ((int64_t(1) << levels) < count) {
+            levels++;
+        }
+        return depth + 1 + levels >= this->_options.maxDepth;
+    }
+
+//    按最长轴上的质心中位数对半分，返回分界
+    int medianSplit(int begin, int end, const AABB &centroids, int &axis) {
+        int middle = begin + (end - begin) / 2;
+        axis = LongestAxis(centroids);
+        std::nth_element(this->_primitives.begin() + begin, this->_primitives.begin() + middle,
+                         this->_primitives.begin() + end, [axis](const Primitive &a, const Primitive &b) {
+                    return a.centroid[axis] < b.centroid[axis];
+                });
+        return middle;
+    }
+
+    void makeLeaf(int index, int begin, int end, const AABB &box) {
+        Node &node = this->_nodes[index];
+        node.box = box;
+        node.begin = begin;
+        node.count = end - begin;
+    }
+
+//    两个子树互不相交，够大时作为两个任务并行建
+    template<typename Build>
+    void buildChildren(int index, int begin, int middle, int end, int axis, const Build &build) {
+        Node &node = this->_nodes[index];
+        node.left = index + 1;
+        node.right = index + 2 * (middle - begin);
+        node.axis = axis;
+        if (this->parallel(end - begin)) {
+            this->_options.pool->parallelFor(2, [&](int k) {
+                k == 0 ? build(node.left, begin, middle) : build(node.right, middle, end);
+            });
+        } else {
+            build(node.left, begin, middle);
+            build(node.right, middle, end);
+        }
+    }
+
+    void buildSAH(int index, int begin, int end, int depth) {
+        AABB box, centroids;
+        this->rangeBoxes(begin, end, box, centroids);
+        int count = end - begin;
+        bool limited = count > 1 && this->nearDepthLimit(depth, count);
+        int axis = 0, splitBin = 0;
+        double splitCost = count > 1 && !limited ? this->findSplit(begin, end, box, centroids, axis, splitBin)
+                                                 : Infinity;
+
+//        物体不超过 maxLeafSize 并且直接求交比再划分便宜时做叶子
+        if (count == 1 || (count <= this->_options.maxLeafSize &&
+                           (limited || count * this->_options.intersectionCost <= splitCost))) {
+            this->makeLeaf(index, begin, end, box);
+            return;
+        }
+
+        int middle;
+        if (limited) {
+            middle = this->medianSplit(begin, end, centroids, axis);
+        } else if (splitCost == Infinity) {
+//            质心重合，SAH 无法区分，按下标对半分
+            middle = begin + count / 2;
+            axis = LongestAxis(box);
+        } else {
+            double min = centroids.min()[axis];
+            double extent = centroids.max()[axis] - min;
+            auto split = std::partition(this->_primitives.begin() + begin, this->_primitives.begin() + end,
+                                        [&](const Primitive &primitive) {
+                                            return this->binIndex(primitive.centroid[axis], min, extent) <= splitBin;
+                                        });
+            middle = int(split - this->_primitives.begin());
+        }
+        this->_nodes[index].box = box;
+        this->buildChildren(index, begin, middle, end, axis, [this, depth](int child, int childBegin, int childEnd) {
+            this->buildSAH(child, childBegin, childEnd, depth + 1);
+        });
+    }
+
+//    每个分量 10 位，相邻两位之间插入两个 0
+    static uint32_t ExpandBits(uint32_t v) {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+
+//    位 3k + 2 / 3k + 1 / 3k 分别来自 x / y / z
+    static uint32_t MortonCode(const Vector3 &p) {
+        uint32_t x = uint32_t(std::min(std::max(p.x() * 1024.0, 0.0), 1023.0));
+        uint32_t y = uint32_t(std::min(std::max(p.y() * 1024.0, 0.0), 1023.0));
+        uint32_t z = uint32_t(std::min(std::max(p.z() * 1024.0, 0.0), 1023.0));
+        return ExpandBits(x) * 4 + ExpandBits(y) * 2 + ExpandBits(z);
+    }
+
+    void sortMorton() {
+        int n = int(this->_primitives.size());
+        AABB box, centroids;
+        this->rangeBoxes(0, n, box, centroids);
+        Vector3 extent = (centroids.max() - centroids.min()).cwiseMax(Vector3{1e-12, 1e-12, 1e-12});
+        std::vector<std::pair<uint32_t, int>> keys(n);
+        this->chunked(0, n, [&](int chunkBegin, int chunkEnd, int) {
+            for (int i = chunkBegin; i < chunkEnd; i++) {
+                Vector3 p = (this->_primitives[i].centroid - centroids.min()).cwiseQuotient(extent);
+                keys[i] = std::make_pair(MortonCode(p), i);
+            }
+        });
+//        码相同时按原来的顺序，保证结果确定
+        std::sort(keys.begin(), keys.end());
+        std::vector<Primitive> sorted(n);
+        this->_codes.resize(n);
+        this->chunked(0, n, [&](int chunkBegin, int chunkEnd, int) {
+            for (int i = chunkBegin; i < chunkEnd; i++) {
+                sorted[i] = this->_primitives[keys[i].second];
+                this->_codes[i] = keys[i].first;
+            }
+        });
+        this->_primitives.swap(sorted);
+    }
+
+    void buildMorton(int index, int begin, int end, int depth) {
+        int count = end - begin;
+        int middle = -1, axis = 0;
+        if (count > this->_options.maxLeafSize && this->nearDepthLimit(depth, count)) {
+//            物体已经按 Morton 码排好序，直接对半分
+            middle = begin + count / 2;
+        } else if (count > this->_options.maxLeafSize) {
+//            从最高位往下找第一个在这一段里不同的位，二分出第一个该位为 1 的物体
+            uint32_t different = this->_codes[begin] ^ this->_codes[end - 1];
+            if (different) {
+                int bit = 31;
+                while (!(different >> bit & 1)) {
+                    bit--;
+                }
+                middle = int(std::lower_bound(this->_codes.begin() + begin, this->_codes.begin() + end,
+                                              this->_codes[end - 1] & ~((1u << bit) - 1)) - this->_codes.begin());
+                axis = 2 - bit % 3;
+            } else {
+                middle = begin + count / 2;
+            }
+        }
+        if (middle < 0) {
+            AABB box, centroids;
+            this->rangeBoxes(begin, end, box, centroids);
+            this->makeLeaf(index, begin, end, box);
+            return;
+        }
+        this->buildChildren(index, begin, middle, end, axis, [this, depth](int child, int childBegin, int childEnd) {
+            this->buildMorton(child, childBegin, childEnd, depth + 1);
+        });
+//        包围盒由子节点合并而来
+        const Node &node = this->_nodes[index];
+        this->_nodes[index].box = AABB::Union(this->_nodes[node.left].box, this->_nodes[node.right].box);
+    }
+
+//    建完之后遍历一遍统计
+    void collectStats(int index, int depth, double rootArea) {
+        const Node &node = this->_nodes[index];
+        double area = rootArea > 0 ? node.box.area() / rootArea : 1;
+        if (node.leaf()) {
+            this->_stats.leafCount++;
+            this->_stats.maxLeafSize = std::max(this->_stats.maxLeafSize, node.count);
+            this->_stats.maxDepth = std::max(this->_stats.maxDepth, depth);
+            this->_stats.sahCost += area * node.count * this->_options.intersectionCost;
+            if (int(this->_stats.depthHistogram.size()) <= depth) {
+                this->_stats.depthHistogram.resize(depth + 1, 0);
+            }
+            this->_stats.depthHistogram[depth]++;
+            if (int(this->_stats.leafSizeHistogram.size()) <= node.count) {
+                this->_stats.leafSizeHistogram.resize(node.count + 1, 0);
+            }
+            this->_stats.leafSizeHistogram[node.count]++;
+            return;
+        }
+        this->_stats.nodeCount++;
+        this->_stats.sahCost += area * this->_options.traversalCost;
+        const AABB &left = this->_nodes[node.left].box, &right = this->_nodes[node.right].box;
+        Vector3 min = left.min().cwiseMax(right.min()), max = left.max().cwiseMin(right.max());
+        if ((min.array() < max.array()).all() && rootArea > 0) {
+            this->_stats.overlap += AABB(min, max).area() / rootArea;
+        }
+        this->collectStats(node.left, depth + 1, rootArea);
+        this->collectStats(node.right, depth + 1, rootArea);
+    }
+
+public:
+    BVHBuilder(const std::vector<Hitable *> &list, double time0, double time1,
+               const BVHBuildOptions &options = BVHBuildOptions()) : _options(options) {
+        auto start = std::chrono::steady_clock::now();
+        if (list.empty()) {
+            throw std::runtime_error("bvh of empty list");
+        }
+        this->_options.binCount = std::max(2, options.binCount);
+        this->_options.maxLeafSize = std::min(std::max(1, options.maxLeafSize), 0xFFFF);
+        this->_options.parallelThreshold = std::max(64, options.parallelThreshold);
+        int n = int(list.size());
+        this->_primitives.resize(n);
+        std::atomic<bool> bounded(true);
+        this->chunked(0, n, [&](int chunkBegin, int chunkEnd, int) {
+            for (int i = chunkBegin; i < chunkEnd; i++) {
+                AABB box;
+                if (!list[i]->boundingBox(time0, time1, box)) {
+                    bounded = false;
+                }
+                this->_primitives[i] = Primitive{box, box.center(), list[i]};
+            }
+        });
+        if (!bounded) {
+            throw std::runtime_error("hitable no bound box");
+        }
+        this->_nodes.resize(2 * n - 1);
+        if (this->_options.method == BVHBuildMethod::Morton) {
+            this->sortMorton();
+            this->buildMorton(0, 0, n, 0);
+        } else {
+            this->buildSAH(0, 0, n, 0);
+        }
+        this->_stats.primitiveCount = n;
+        this->collectStats(0, 0, this->_nodes[0].box.area());
+        this->_stats.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+//    下标按子树预留，中间可能有没用到的空位，应当从根开始沿 left / right 访问
+    const std::vector<Node> &nodes() const {
+        return this->_nodes;
+    }
+
+//    按叶子顺序重排过的物体
+    const std::vector<Primitive> &primitives() const {
+        return this->_primitives;
+    }
+
+    const BVHBuildStats &stats() const {
+        return this->_stats;
+    }
+
+    const BVHBuildOptions &options() const {
+        return this->_options;
+    }
+};
 
 class BVHNode : public Hitable {
 private:
+    friend class Arena;
+
     AABB _box;
     Hitable *_left;
     Hitable *_right;
+    int _leftCount = 0, _rightCount = 0;    // 子节点是叶子时的物体数，只用于统计
+    bool _leftLeaf = true, _rightLeaf = true;   // 子节点不是 BVHNode（物体或 HitableList）
+
+//    叶子只有一个物体时直接返回它，否则用 HitableList 包起来
+    static Hitable *Create(const BVHBuilder &builder, int index) {
+        const BVHBuilder::Node &node = builder.nodes()[index];
+        Arena *arena = builder.options().arena;
+        if (!node.leaf()) {
+            return Arena::New<BVHNode>(arena, builder, index);
+        }
+        if (node.count == 1) {
+            return builder.primitives()[node.begin].hitable;
+        }
+        std::vector<Hitable *> list;
+        for (int i = node.begin; i < node.begin + node.count; i++) {
+            list.push_back(builder.primitives()[i].hitable);
+        }
+        return Arena::New<HitableList>(arena, list);
+    }
+
+    BVHNode(const BVHBuilder &builder, int index) {
+        this->init(builder, index);
+    }
+
+    void init(const BVHBuilder &builder, int index) {
+        const BVHBuilder::Node &node = builder.nodes()[index];
+        this->_box = node.box;
+        if (node.leaf()) {
+//            整棵树只有一个叶子，左右是同一个
+            this->_left = this->_right = Create(builder, index);
+            this->_leftCount = this->_rightCount = node.count;
+        } else {
+            this->_left = Create(builder, node.left);
+            this->_right = Create(builder, node.right);
+            this->_leftCount = builder.nodes()[node.left].count;
+            this->_rightCount = builder.nodes()[node.right].count;
+            this->_leftLeaf = builder.nodes()[node.left].leaf();
+            this->_rightLeaf = builder.nodes()[node.right].leaf();
+        }
+    }
+
 public:
     BVHNode() {}
 
-    BVHNode(std::vector<Hitable *> list, double time0, double time1) {
-        if (list.size() == 1) {
-            this->_left = list[0];
-            this->_right = list[0];
-        } else if (list.size() == 2) {
-            this->_left = list[0];
-            this->_right = list[1];
-        } else {
-//            随机一个维度排序
-            int axis = int(3 * drand48());
-            std::sort(list.begin(), list.end(), [axis,time0,time1](Hitable *h1, Hitable *h2) {
-                AABB box1, box2;
-                bool ret1 = h1->boundingBox(time0, time1, box1);
-                bool ret2 = h2->boundingBox(time0, time1, box2);
-                if (!ret1 || !ret2) {
-                    std::runtime_error("hitable no bound box");
-                }
-                return box1.min()[axis] < box2.min()[axis];
-            });
+    /**
+     * 分箱 SAH 建树，结果只由输入顺序决定
+     * @param stats 不为空时写入建树统计
+     */
+    BVHNode(const std::vector<Hitable *> &list, double time0, double time1,
+            const BVHBuildOptions &options = BVHBuildOptions(), BVHBuildStats *stats = nullptr) {
+        BVHBuilder builder(list, time0, time1, options);
+        this->init(builder, 0);
+        if (stats) {
+            *stats = builder.stats();
+        }
+    }
 
-            auto beginning = list.begin();
-            auto middling = list.begin() + (list.size() / 2);
-            auto ending = list.end();
-
-            auto leftList = std::vector<Hitable *>(beginning, middling);
-            auto rightList = std::vector<Hitable *>(middling, ending);
-
-            this->_left = new BVHNode(leftList, time0, time1);
-            this->_right = new BVHNode(rightList, time0, time1);
-        }
-        AABB box1, box2;
-        bool ret1 = this->_left->boundingBox(time0, time1, box1);
-        bool ret2 = this->_right->boundingBox(time0, time1, box2);
-        if (!ret1 || !ret2) {
-            std::runtime_error("hitable no bound box");
-        }
-        this->_box = AABB::Union(box1, box2);
-    }
-
-    virtual bool hit(const Ray &ray, double tMin, double tMax, HitRecord &record) const {
-        if (this->_box.hit(ray, tMin, tMax)) {
-            HitRecord leftRec, rightRec;
-            bool hitLeft = this->_left->hit(ray, tMin, tMax, leftRec);
-            bool hitRight = this->_right->hit(ray, tMin, tMax, rightRec);
-            if (hitLeft && hitRight) {
-                record = leftRec.t < rightRec.t ? leftRec : rightRec;
-                return true;
-            } else if (hitLeft) {
-                record = leftRec;
-                return true;
-            } else if (hitRight) {
-                record = rightRec;
-                return true;
-            }
+    const AABB &box() const {
+        return this->_box;
+    }
+
+    Hitable *left() const {
+        return this->_left;
+    }
+
+    Hitable *right() const {
+        return this->_right;
+    }
+
+//    遍历时不用 RTTI 就能知道子节点是不是 BVHNode
+    bool leftLeaf() const {
+        return this->_leftLeaf;
+    }
+
+    bool rightLeaf() const {
+        return this->_rightLeaf;
+    }
+
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
+        BVH_STATS_NODE(1);
+        if (!this->_box.hit(ray, tMin, tMax)) {
+            return false;
+        }
+//        右子树只需要找比左子树更近的交点
+        BVH_STATS_PRIMITIVES(this->_leftCount);
+        bool hitLeft = this->_left->hit(ray, tMin, tMax, record);
+        if (this->_right == this->_left) {
+            return hitLeft;
+        }
+        BVH_STATS_PRIMITIVES(this->_rightCount);
+        HitRecord rightRec;
+        if (this->_right->hit(ray, tMin, hitLeft ? record.t : tMax, rightRec)) {
+            record = rightRec;
+            return true;
         }
-        return false;
+        return hitLeft;
     }
 
-    virtual bool boundingBox(double time0, double time1, AABB &box) const {
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
         box = this->_box;
         return true;
     };
@@ -0,0 +1,152 @@
+#ifndef BVH_STATS_HPP
+#define BVH_STATS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//每个线程访问过的 BVH 节点数，和 ThreadRayCount 一起可以算出每条光线平均访问多少节点；只在定义了 BVH_STATS 时计数
+thread_local uint64_t ThreadBVHNodeVisits = 0;
+
+/**
+ * 求交遍历的计数器
+ * boxes 是做过的包围盒测试数，四叉 BVH 访问一个节点测四个盒子；primitives 是叶子里调用物体求交的次数
+ */
+struct TraversalCounters {
+    uint64_t rays = 0;
+    uint64_t nodes = 0;
+    uint64_t boxes = 0;
+    uint64_t primitives = 0;
+
+    void add(const TraversalCounters &other) {
+        this->rays += other.rays;
+        this->nodes += other.nodes;
+        this->boxes += other.boxes;
+        this->primitives += other.primitives;
+    }
+};
+
+/**
+ * 按弹射次数分开的遍历统计，每个线程一份，不需要原子操作
+ * 线程退出时把计数合并到全局，Report 时再加上还活着的线程（此时它们应当都空闲）
+ */
+class TraversalStats {
+public:
+    static const int MaxBounce = 16;    // 更深的弹射都算在最后一档
+
+private:
+    TraversalCounters _bounces[MaxBounce + 1];
+    int _bounce = 0;
+
+    static std::mutex &Mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::vector<TraversalStats *> &Live() {
+        static std::vector<TraversalStats *> live;
+        return live;
+    }
+
+    static std::vector<TraversalCounters> &Retired() {
+        static std::vector<TraversalCounters> retired(MaxBounce + 1);
+        return retired;
+    }
+
+    static void Print(std::ostream &os, const char *name, const TraversalCounters &counters) {
+        double rays = double(counters.rays);
+        os << std::setw(6) << name << std::setw(12) << counters.rays
+           << std::setw(12) << counters.nodes / rays << std::setw(12) << counters.boxes / rays
+           << std::setw(12) << counters.primitives / rays << "\n";
+    }
+
+public:
+    TraversalStats() {
+        std::lock_guard<std::mutex> lock(Mutex());
+        Live().push_back(this);
+    }
+
+    ~TraversalStats() {
+        std::lock_guard<std::mutex> lock(Mutex());
+        for (int b = 0; b <= MaxBounce; b++) {
+            Retired()[b].add(this->_bounces[b]);
+        }
+        std::vector<TraversalStats *> &live = Live();
+        live.erase(std::remove(live.begin(), live.end(), this), live.end());
+    }
+
+//    发出一条第 bounce 次弹射的光线，之后的计数都算在这一档
+    void ray(int bounce) {
+        this->_bounce = bounce < MaxBounce ? bounce : MaxBounce;
+        this->_bounces[this->_bounce].rays++;
+    }
+
+    TraversalCounters &current() {
+        return this->_bounces[this->_bounce];
+    }
+
+    static std::vector<TraversalCounters> Collect() {
+        std::lock_guard<std::mutex> lock(Mutex());
+        std::vector<TraversalCounters> total = Retired();
+        for (const TraversalStats *stats : Live()) {
+            for (int b = 0; b <= MaxBounce; b++) {
+                total[b].add(stats->_bounces[b]);
+            }
+        }
+        return total;
+    }
+
+//    每条光线平均访问的节点、测试的盒子和物体，按弹射次数分行
+    static void Report(std::ostream &os) {
+        std::vector<TraversalCounters> bounces = Collect();
+        TraversalCounters total;
+        os << "traversal stats (per ray)\n" << std::setw(6) << "bounce" << std::setw(12) << "rays"
+           << std::setw(12) << "nodes" << std::setw(12) << "boxes" << std::setw(12) << "primitives" << "\n";
+        for (int b = 0; b <= MaxBounce; b++) {
+            total.add(bounces[b]);
+            if (bounces[b].rays > 0) {
+                std::string name = std::to_string(b) + (b == MaxBounce ? "+" : "");
+                Print(os, name.c_str(), bounces[b]);
+            }
+        }
+        if (total.rays > 0) {
+            Print(os, "all", total);
+        } else if (total.nodes > 0) {
+//            直接调用 hit 而不经过积分器时没有按光线计数
+            os << "  nodes: " << total.nodes << " boxes: " << total.boxes << " primitives: " << total.primitives
+               << " (rays not counted)\n";
+        }
+    }
+};
+
+/**
+ * BVH_STATS_RAY(bounce)    积分器发出一条光线
+ * BVH_STATS_NODE(boxCount) 访问一个节点，测试了 boxCount 个包围盒
+ * BVH_STATS_PRIMITIVES(count) 对 count 个物体调用求交
+ * BVH_STATS_REPORT(os)     打印汇总，放在 main 的最后
+ * 没有定义 BVH_STATS 时全部展开为空，遍历代码里不留任何计数
+ */
+#ifdef BVH_STATS
+
+thread_local TraversalStats ThreadTraversalStats;
+
+#define BVH_STATS_RAY(bounce) ThreadTraversalStats.ray(bounce)
+#define BVH_STATS_NODE(boxCount) (ThreadBVHNodeVisits++, ThreadTraversalStats.current().nodes++, \
+                                  ThreadTraversalStats.current().boxes += (boxCount))
+#define BVH_STATS_PRIMITIVES(count) (ThreadTraversalStats.current().primitives += (count))
+#define BVH_STATS_REPORT(os) TraversalStats::Report(os)
+
+#else
+
+#define BVH_STATS_RAY(bounce) ((void) 0)
+#define BVH_STATS_NODE(boxCount) ((void) 0)
+#define BVH_STATS_PRIMITIVES(count) ((void) 0)
+#define BVH_STATS_REPORT(os) ((void) 0)
+
+#endif
+
+#endif //BVH_STATS_HPP
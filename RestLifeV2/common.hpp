@@ -7,78 +7,77 @@
 #include <Eigen/Dense>
 #include "random.hpp"
 
-using Eigen::Vector3d;
+/**
+ * 渲染器的标量类型，光线、包围盒、交点、相机、材质和 PDF 都用它
+ * 默认是 double；定义 RESTLIFE_FLOAT 时整个渲染器用 float 构建，向量只有一半大，访存也减半
+ * 随机数、计时、统计和 BVH 建树的代价估计始终是 double
+ * Eigen 会把 double 的标量提升为 float，所以 0.5 * v 这样的写法在两种构建下都能用
+ */
+#ifdef RESTLIFE_FLOAT
+typedef float Float;
+#else
+typedef double Float;
+#endif
 
-const double Infinity = std::numeric_limits<double>::infinity();
+typedef Eigen::Matrix<Float, 3, 1> Vector3;
 
-Vector3d lerp(double t, Vector3d start, Vector3d end) {
+const Float Infinity = std::numeric_limits<Float>::infinity();
+
+Vector3 lerp(Float t, Vector3 start, Vector3 end) {
     return (1.0 - t) * start + t * end;
 }
 
-void UpdateProgress(double progress) {
-    int barWidth = 70;
-
-    std::cout << "[";
-    int pos = barWidth * progress;
-    for (int i = 0; i < barWidth; ++i) {
-        if (i < pos) std::cout << "=";
-        else if (i == pos) std::cout << ">";
-        else std::cout << " ";
-    }
-//    \r：回车不换行
-    std::cout << "] " << int(progress * 100.0) << " %\r";
-    std::cout.flush();
-};
-
-Vector3d randomUnitSphere() {
-    Vector3d p;
+Vector3 randomUnitSphere() {
+    Vector3 p;
     do {
 //        (0,1)->(-1,1)
-        p = 2.0 * Vector3d{drand48(), drand48(), drand48()} - Vector3d{1, 1, 1};
+        p = 2.0 * Vector3(Random::GenUniform(),
+                          Random::GenUniform(),
+                          Random::GenUniform()) - Vector3{1, 1, 1};
     } while (p.norm() >= 1.0);
     return p;
 }
 
-Vector3d randomUnitDisk() {
-    Vector3d p;
+Vector3 randomUnitDisk() {
+    Vector3 p;
     do {
 //        (0,1)->(-1,1)
-        p = 2.0 * Vector3d{drand48(), drand48(), 0} - Vector3d{1, 1, 0};
+        p = 2.0 * Vector3(Random::GenUniform(), Random::GenUniform(), 0) - Vector3{1, 1, 0};
     } while (p.dot(p) >= 1.0);
     return p;
 }
 
-Vector3d randomCosineDirection() {
-    double r1 = Random::GenUniformRandom(0, 1);
-    double r2 = Random::GenUniformRandom(0, 1);
-    double theta = sqrt(1 - r2);
-    double phi = 2 * M_PI * r1;
-    double x = cos(phi) * 2 * sqrt(r2);
-    double y = sin(phi) * 2 * sqrt(r2);
-    double z = theta;
+Vector3 randomCosineDirection() {
+    Float r1 = Random::GenUniform();
+    Float r2 = Random::GenUniform();
+    Float theta = sqrt(1 - r2);
+    Float phi = 2 * M_PI * r1;
+    Float x = cos(phi) * 2 * sqrt(r2);
+    Float y = sin(phi) * 2 * sqrt(r2);
+    Float z = theta;
     return {x, y, z};
 }
 
-Vector3d randomToSphere(double radius, double distanceSquared) {
-    double r1 = Random::GenUniformRandom(0, 1);
-    double r2 = Random::GenUniformRandom(0, 1);
-    double z = 1 + r2 * (sqrt(1 - radius * radius / distanceSquared) - 1);
-    double phi = 2 * M_PI * r1;
-    double x = cos(phi) * sqrt(1 - z * z);
-    double y = sin(phi) * sqrt(1 - z * z);
+Vector3 randomToSphere(Float radius, Float distanceSquared) {
+    Float r1 = Random::GenUniform();
+    Float r2 = Random::GenUniform();
+    Float z = 1 + r2 * (sqrt(1 - radius * radius / distanceSquared) - 1);
+    Float phi = 2 * M_PI * r1;
+    Float x = cos(phi) * sqrt(1 - z * z);
+    Float y = sin(phi) * sqrt(1 - z * z);
     return {x, y, z};
 }
 
 //图像中的黑点是产生了Nan的像素，消除它或者忽略它
-Vector3d deNan(const Vector3d &v) {
-    Vector3d tmp = v;
-    if (!isnormal(tmp.x())) {
+Vector3 deNan(const Vector3 &v) {
+    Vector3 tmp = v;
+    if (!std::isnormal(tmp.x())) {
         tmp[0] = 0;
     }
-    if (!isnormal(tmp.y())) {
+    if (!std::isnormal(tmp.y())) {
         tmp[1] = 0;
     }
-    if (!isnormal(tmp.z())) {
+    if (!std::isnormal(tmp.z())) {
         tmp[2] = 0;
     }
 ////    无法判断
@@ -114,7 +113,7 @@ Vector3d deNan(const Vector3d &v) {
     return tmp;
 }
 
-inline double degrees_to_radians(double degrees) {
+inline Float degrees_to_radians(Float degrees) {
     return degrees * M_PI / 180.0;
 }
 
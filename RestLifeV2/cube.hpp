@@ -2,45 +2,44 @@
 #define CURB_HPP
 
 #include "rect.hpp"
+#include "arena.hpp"
 
 class Cube : public Hitable {
 private:
-    Vector3d _min, _max;
+    Vector3 _min, _max;
     HitableList *_sides;
 public:
     Cube() {}
 
-    Cube(const Vector3d &min, const Vector3d &max, Material *material) : _min(min), _max(max) {
+//    arena 不为空时六个面和它们的列表都放在 arena 里
+    Cube(const Vector3 &min, const Vector3 &max, Material *material, Arena *arena = nullptr) : _min(min), _max(max) {
+        this->_sides = Arena::New<HitableList>(arena, Sides(min, max, material, arena));
+    }
+
+//    六个面，实例化时用来建一次共享的 BLAS
+    static std::vector<Hitable *> Sides(const Vector3 &min, const Vector3 &max, Material *material,
+                                        Arena *arena = nullptr) {
         std::vector<Hitable *> list;
-        list.push_back(new XYRect(this->_min.x(), this->_max.x(),
-                                  this->_min.y(), this->_max.y(),
-                                  this->_min.z(), material));
-        list.push_back(new XYRect(this->_min.x(), this->_max.x(),
-                                  this->_min.y(), this->_max.y(),
-                                  this->_max.z(), material));
-
-        list.push_back(new XZRect(this->_min.x(), this->_max.x(),
-                                  this->_min.z(), this->_max.z(),
-                                  this->_min.y(), material));
-        list.push_back(new XZRect(this->_min.x(), this->_max.x(),
-                                  this->_min.z(), this->_max.z(),
-                                  this->_max.y(), material));
-
-        list.push_back(new YZRect(this->_min.y(), this->_max.y(),
-                                  this->_min.z(), this->_max.z(),
-                                  this->_min.x(), material));
-        list.push_back(new YZRect(this->_min.y(), this->_max.y(),
-                                  this->_min.z(), this->_max.z(),
-                                  this->_max.x(), material));
-
-        this->_sides = new HitableList(list);
+        list.push_back(Arena::New<XYRect>(arena, min.x(), max.x(), min.y(), max.y(), min.z(), material));
+        list.push_back(Arena::New<XYRect>(arena, min.x(), max.x(), min.y(), max.y(), max.z(), material));
+
+        list.push_back(Arena::New<XZRect>(arena, min.x(), max.x(), min.z(), max.z(), min.y(), material));
+        list.push_back(Arena::New<XZRect>(arena, min.x(), max.x(), min.z(), max.z(), max.y(), material));
+
+        list.push_back(Arena::New<YZRect>(arena, min.y(), max.y(), min.z(), max.z(), min.x(), material));
+        list.push_back(Arena::New<YZRect>(arena, min.y(), max.y(), min.z(), max.z(), max.x(), material));
+        return list;
+    }
+
+    const HitableList *sides() const {
+        return this->_sides;
     }
 
-    virtual bool hit(const Ray &ray, double tMin, double tMax, HitRecord &record) const {
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
         return this->_sides->hit(ray, tMin, tMax, record);
     };
 
-    virtual bool boundingBox(double time0, double time1, AABB &box) const {
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
         box = AABB(this->_min, this->_max);
         return true;
     };
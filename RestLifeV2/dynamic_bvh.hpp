@@ -0,0 +1,86 @@
+#ifndef DYNAMIC_BVH_HPP
+#define DYNAMIC_BVH_HPP
+
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include "linear_bvh.hpp"
+
+/**
+ * 一帧的加速结构更新统计
+ * degradation 是当前 SAH 代价和上次重建后代价的比值
+ */
+struct BVHUpdateStats {
+    bool rebuilt = false;
+    double sahCost = 0;
+    double degradation = 1;
+    double seconds = 0;
+
+    friend std::ostream &operator<<(std::ostream &os, const BVHUpdateStats &stats) {
+        os << (stats.rebuilt ? "rebuild" : "refit") << ": " << stats.seconds * 1000 << " ms, sah cost: "
+           << stats.sahCost << " (" << stats.degradation << "x)";
+        return os;
+    }
+};
+
+/**
+ * 用于动画的 BVH
+ * 每帧物体移动之后调用 update()：默认只自底向上 refit 包围盒，
+ * refit 后的 SAH 代价超过上次重建时的 rebuildThreshold 倍才按原来的参数重新建树
+ */
+class DynamicBVH : public Hitable {
+private:
+    std::vector<Hitable *> _list;
+    double _time0, _time1;
+    BVHBuildOptions _options;
+    double _rebuildThreshold;
+    std::unique_ptr<LinearBVH> _bvh;
+    double _builtCost = 0;
+
+    void rebuild() {
+        this->_bvh.reset(new LinearBVH(this->_list, this->_time0, this->_time1, this->_options));
+        this->_builtCost = this->_bvh->sahCost(this->_options.traversalCost, this->_options.intersectionCost);
+    }
+
+public:
+    DynamicBVH(const std::vector<Hitable *> &list, double time0, double time1,
+               const BVHBuildOptions &options = BVHBuildOptions(), double rebuildThreshold = 1.3) :
+            _list(list), _time0(time0), _time1(time1), _options(options), _rebuildThreshold(rebuildThreshold) {
+        this->rebuild();
+    }
+
+    BVHUpdateStats update() {
+        BVHUpdateStats stats;
+        auto start = std::chrono::steady_clock::now();
+        this->_bvh->refit(this->_time0, this->_time1);
+        stats.sahCost = this->_bvh->sahCost(this->_options.traversalCost, this->_options.intersectionCost);
+        if (stats.sahCost > this->_builtCost * this->_rebuildThreshold) {
+            this->rebuild();
+            stats.rebuilt = true;
+            stats.sahCost = this->_builtCost;
+        }
+        stats.degradation = this->_builtCost > 0 ? stats.sahCost / this->_builtCost : 1;
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+
+//    快门时间变了（例如每帧的快门区间不同）时先改时间再 update
+    void setTime(double time0, double time1) {
+        this->_time0 = time0;
+        this->_time1 = time1;
+    }
+
+    const LinearBVH &bvh() const {
+        return *this->_bvh;
+    }
+
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
+        return this->_bvh->hit(ray, tMin, tMax, record);
+    }
+
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
+        return this->_bvh->boundingBox(time0, time1, box);
+    }
+};
+
+#endif //DYNAMIC_BVH_HPP
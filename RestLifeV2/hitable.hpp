@@ -9,10 +9,10 @@
 class Material;
 
 struct HitRecord {
-    double t;               // 光线的t
-    Vector3d p;             // 交点
-    Vector3d normal;        // 交点法线
-    double u, v;            // 交点纹理坐标
+    Float t;                // 光线的t
+    Vector3 p;              // 交点
+    Vector3 normal;         // 交点法线
+    Float u, v;             // 交点纹理坐标
     Material *material;     // 交点材质
 
     friend std::ostream &operator<<(std::ostream &os, const HitRecord &record) {
@@ -24,30 +24,30 @@ struct HitRecord {
 
 class Hitable {
 public:
-    virtual bool hit(const Ray &ray, double tMin, double tMax, HitRecord &record) const = 0;
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const = 0;
 
-    virtual bool boundingBox(double time0, double time1, AABB &box) const = 0;
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const = 0;
 
 //    返回o点到物体的随机方向的pdf
-    virtual double pdfValue(const Vector3d &o, const Vector3d &direction) const {
+    virtual Float pdfValue(const Vector3 &o, const Vector3 &direction) const {
         return 0;
     }
 
 //    返回o点到物体的随机方向
-    virtual Vector3d random(const Vector3d &o) {
+    virtual Vector3 random(const Vector3 &o) {
         return {1, 0, 0};
     }
 };
 
 class Sphere : public Hitable {
 private:
-    Vector3d _center;
-    double _radius;
+    Vector3 _center;
+    Float _radius;
     Material *_material;
 
-    static void GetSphereUV(const Vector3d &p, double &u, double &v) {
-        double phi = atan2(p.z(), p.x());
-        double theta = asin(p.y());
+    static void GetSphereUV(const Vector3 &p, Float &u, Float &v) {
+        Float phi = atan2(p.z(), p.x());
+        Float theta = asin(p.y());
         u = 1 - (phi + M_PI) / (2 * M_PI);
         v = (theta + M_PI / 2) / M_PI;
     }
@@ -55,61 +55,85 @@ private:
 public:
     Sphere() {}
 
-    Sphere(const Vector3d &center, double radius) : _center(center), _radius(radius) {}
+    Sphere(const Vector3 &center, Float radius) : _center(center), _radius(radius) {}
 
-    Sphere(const Vector3d &center, double radius, Material *material) :
+    Sphere(const Vector3 &center, Float radius, Material *material) :
             _center(center), _radius(radius), _material(material) {}
 
-    virtual bool hit(const Ray &ray, double tMin, double tMax, HitRecord &record) const {
+    const Vector3 &center() const {
+        return this->_center;
+    }
+
+//    动画中移动球，之后要 refit 包含它的 BVH
+    void setCenter(const Vector3 &center) {
+        this->_center = center;
+    }
+
+    Float radius() const {
+        return this->_radius;
+    }
+
+    Material *material() const {
+        return this->_material;
+    }
+
+//    只用参数求交，不需要 Sphere 对象；场景快照直接在文件里的记录上调用
+    static bool Hit(const Vector3 &center, Float radius, Material *material,
+                    const Ray &ray, Float tMin, Float tMax, HitRecord &record) {
         //t*t*B*B+2*t*B*(A-C)+(A-C)*(A-C)-R*R=0
-        Vector3d oc = ray.origin() - this->_center;
-        double a = ray.direction().dot(ray.direction());
-        double b = 2.0 * oc.dot(ray.direction());
-        double c = oc.dot(oc) - this->_radius * this->_radius;
-        double discriminant = b * b - 4 * a * c;
+        Vector3 oc = ray.origin() - center;
+        Float a = ray.direction().dot(ray.direction());
+        Float b = 2.0 * oc.dot(ray.direction());
+        Float c = oc.dot(oc) - radius * radius;
+        Float discriminant = b * b - 4 * a * c;
         if (discriminant > 0) {
-            double t = (-b - sqrt(discriminant)) / (2.0 * a);
+            Float t = (-b - sqrt(discriminant)) / (2.0 * a);
+//            解二次方程得到的 t 误差较大，把交点投影回球面上，推开交点时才有可靠的误差上界
             if (t < tMax && t > tMin) {
                 record.t = t;
-                record.p = ray(t);
-                record.normal = (record.p - this->_center) / this->_radius;
-                record.material = this->_material;
-                Sphere::GetSphereUV((record.p - this->_center) / this->_radius, record.u, record.v);
+                record.p = center + (ray(t) - center).normalized() * radius;
+                record.normal = (record.p - center) / radius;
+                record.material = material;
+                Sphere::GetSphereUV((record.p - center) / radius, record.u, record.v);
                 return true;
             }
             t = (-b + sqrt(discriminant)) / (2.0 * a);
             if (t < tMax && t > tMin) {
                 record.t = t;
-                record.p = ray(t);
-                record.normal = (record.p - this->_center) / this->_radius;
-                record.material = this->_material;
-                Sphere::GetSphereUV((record.p - this->_center) / this->_radius, record.u, record.v);
+                record.p = center + (ray(t) - center).normalized() * radius;
+                record.normal = (record.p - center) / radius;
+                record.material = material;
+                Sphere::GetSphereUV((record.p - center) / radius, record.u, record.v);
                 return true;
             }
         }
         return false;
     }
 
-    virtual bool boundingBox(double time0, double time1, AABB &box) const {
-        box = AABB(this->_center - Vector3d{this->_radius, this->_radius, this->_radius},
-                   this->_center + Vector3d{this->_radius, this->_radius, this->_radius});
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
+        return Hit(this->_center, this->_radius, this->_material, ray, tMin, tMax, record);
+    }
+
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
+        box = AABB(this->_center - Vector3{this->_radius, this->_radius, this->_radius},
+                   this->_center + Vector3{this->_radius, this->_radius, this->_radius});
         return true;
     }
 
-    virtual double pdfValue(const Vector3d &o, const Vector3d &direction) const {
+    virtual Float pdfValue(const Vector3 &o, const Vector3 &direction) const {
         HitRecord record;
-        if (this->hit(Ray(o, direction), 0.001, MAXFLOAT, record)) {
-            double cosThetaMax = sqrt(1 - this->_radius * this->_radius / (this->_center - o).squaredNorm());
-            double solidAngle = 2 * M_PI * (1 - cosThetaMax);
+        if (this->hit(Ray(o, direction), 0, MAXFLOAT, record)) {
+            Float cosThetaMax = sqrt(1 - this->_radius * this->_radius / (this->_center - o).squaredNorm());
+            Float solidAngle = 2 * M_PI * (1 - cosThetaMax);
             return 1 / solidAngle;
         } else {
             return 0;
         }
     }
 
-    virtual Vector3d random(const Vector3d &o) {
-        Vector3d direction = this->_center - o;
-        double distanceSquared = direction.squaredNorm();
+    virtual Vector3 random(const Vector3 &o) {
+        Vector3 direction = this->_center - o;
+        Float distanceSquared = direction.squaredNorm();
         ONB uvw(direction);
         return uvw.local(randomToSphere(this->_radius, distanceSquared));
     }
@@ -117,61 +141,98 @@ public:
 
 class MovingSphere : public Hitable {
 private:
-    Vector3d _center0, _center1;
-    double _time0, _time1;
-    double _radius;
+    Vector3 _center0, _center1;
+    Float _time0, _time1;
+    Float _radius;
     Material *_material;
 public:
     MovingSphere() {}
 
-    MovingSphere(const Vector3d &center0, const Vector3d &center1,
-                 double time0, double time1,
-                 double radius, Material *material) :
+    MovingSphere(const Vector3 &center0, const Vector3 &center1,
+                 Float time0, Float time1,
+                 Float radius, Material *material) :
             _center0(center0), _center1(center1),
             _time0(time0), _time1(time1),
             _radius(radius), _material(material) {}
 
-    Vector3d center(double time) const {
-        return this->_center0 +
-               (time - this->_time0) / (this->_time1 - this->_time0) * (this->_center1 - this->_center0);
+    const Vector3 &center0() const {
+        return this->_center0;
+    }
+
+    const Vector3 &center1() const {
+        return this->_center1;
+    }
+
+    void setCenters(const Vector3 &center0, const Vector3 &center1) {
+        this->_center0 = center0;
+        this->_center1 = center1;
+    }
+
+    Float time0() const {
+        return this->_time0;
+    }
+
+    Float time1() const {
+        return this->_time1;
+    }
+
+    Float radius() const {
+        return this->_radius;
+    }
+
+    Material *material() const {
+        return this->_material;
     }
 
-    virtual bool hit(const Ray &ray, double tMin, double tMax, HitRecord &record) const {
+    static Vector3 Center(const Vector3 &center0, const Vector3 &center1, Float time0, Float time1, Float time) {
+        return center0 + (time - time0) / (time1 - time0) * (center1 - center0);
+    }
+
+    Vector3 center(Float time) const {
+        return Center(this->_center0, this->_center1, this->_time0, this->_time1, time);
+    }
+
+//    center 是光线时刻的球心，和 Sphere::Hit 的区别是不计算纹理坐标
+    static bool Hit(const Vector3 &center, Float radius, Material *material,
+                    const Ray &ray, Float tMin, Float tMax, HitRecord &record) {
         //t*t*B*B+2*t*B*(A-C)+(A-C)*(A-C)-R*R=0
-        Vector3d center = this->center(ray.time());
-        Vector3d oc = ray.origin() - center;
-        double a = ray.direction().dot(ray.direction());
-        double b = 2.0 * oc.dot(ray.direction());
-        double c = oc.dot(oc) - this->_radius * this->_radius;
-        double discriminant = b * b - 4 * a * c;
+        Vector3 oc = ray.origin() - center;
+        Float a = ray.direction().dot(ray.direction());
+        Float b = 2.0 * oc.dot(ray.direction());
+        Float c = oc.dot(oc) - radius * radius;
+        Float discriminant = b * b - 4 * a * c;
         if (discriminant > 0) {
-            double t = (-b - sqrt(discriminant)) / (2.0 * a);
+            Float t = (-b - sqrt(discriminant)) / (2.0 * a);
             if (t < tMax && t > tMin) {
                 record.t = t;
-                record.p = ray(t);
-                record.normal = (record.p - center) / this->_radius;
-                record.material = this->_material;
+                record.p = center + (ray(t) - center).normalized() * radius;
+                record.normal = (record.p - center) / radius;
+                record.material = material;
                 return true;
             }
             t = (-b + sqrt(discriminant)) / (2.0 * a);
             if (t < tMax && t > tMin) {
                 record.t = t;
-                record.p = ray(t);
-                record.normal = (record.p - center) / this->_radius;
-                record.material = this->_material;
+                record.p = center + (ray(t) - center).normalized() * radius;
+                record.normal = (record.p - center) / radius;
+                record.material = material;
                 return true;
             }
         }
         return false;
     }
 
-    virtual bool boundingBox(double time0, double time1, AABB &box) const {
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
+        return Hit(this->center(ray.time()), this->_radius, this->_material, ray, tMin, tMax, record);
+    }
+
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
         AABB box0(
-                this->center(time0) - Vector3d{this->_radius, this->_radius, this->_radius},
-                this->center(time0) + Vector3d{this->_radius, this->_radius, this->_radius});
+                this->center(time0) - Vector3{this->_radius, this->_radius, this->_radius},
+                this->center(time0) + Vector3{this->_radius, this->_radius, this->_radius});
         AABB box1(
-                this->center(time1) - Vector3d{this->_radius, this->_radius, this->_radius},
-                this->center(time1) + Vector3d{this->_radius, this->_radius, this->_radius});
+                this->center(time1) - Vector3{this->_radius, this->_radius, this->_radius},
+                this->center(time1) + Vector3{this->_radius, this->_radius, this->_radius});
         box = AABB::Union(box0, box1);
         return true;
     }
@@ -188,23 +249,26 @@ public:
         this->_size = list.size();
     }
 
-    virtual bool hit(const Ray &ray, double tMin, double tMax, HitRecord &record) const {
+    const std::vector<Hitable *> &list() const {
+        return this->_list;
+    }
+
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
         HitRecord temp;
         bool hit = false;
-        double closest = tMax;
+        Float closest = tMax;
         for (const Hitable *hitable:this->_list) {
-            if (hitable->hit(ray, tMin, tMax, temp)) {
+//            只找比已有交点更近的
+            if (hitable->hit(ray, tMin, closest, temp)) {
                 hit = true;
-                if (closest > temp.t) {
-                    closest = temp.t;
-                    record = temp;
-                }
+                closest = temp.t;
+                record = temp;
             }
         }
         return hit;
     }
 
-    virtual bool boundingBox(double time0, double time1, AABB &box) const {
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
         if (this->_size < 1) {
             return false;
         }
@@ -223,16 +287,16 @@ public:
         return true;
     }
 
-    virtual double pdfValue(const Vector3d &o, const Vector3d &direction) const {
-        double weight = 1.0 / this->_size;
-        double sum = 0;
+    virtual Float pdfValue(const Vector3 &o, const Vector3 &direction) const {
+        Float weight = 1.0 / this->_size;
+        Float sum = 0;
         for (int i = 0; i < this->_size; i++) {
             sum += weight * this->_list[i]->pdfValue(o, direction);
         }
         return sum;
     }
 
-    virtual Vector3d random(const Vector3d &o) {
+    virtual Vector3 random(const Vector3 &o) {
         int index = Random::GenUniformRandomi(0, this->_size);
         return this->_list[index]->random(o);
     }
@@ -0,0 +1,171 @@
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.hpp"
+
+enum class ImageFormat {
+    PPM,    // 二进制 P6，gamma 校正后量化到 8 位
+    PFM     // 线性 float，保留 HDR 信息
+};
+
+/**
+ * 后台写图像
+ * 渲染线程把完成的块交给 submit 后立即返回，写线程负责转换格式，
+ * 并在文件中前面的行都完成后按顺序把它们写出去
+ * 只缓存已经有块落进来、但还不能写出的行，按行渲染时内存和一行差不多；块的顺序越乱，缓存的行越多
+ */
+class ImageWriter {
+private:
+    struct Block {
+        int x0, y0, x1, y1;
+        std::vector<Vector3> pixels;
+    };
+
+    std::ofstream _fout;
+    int _nx, _ny;
+    ImageFormat _format;
+    int _pixelBytes;
+    std::vector<std::vector<char>> _rows;   // 还没写出去的行，第一次有块落进来时才分配，写出后释放
+    std::vector<int> _rowRemaining;
+    int _nextRow = 0;       // 文件中下一个要写的行
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<Block> _queue;
+    bool _closed = false;
+    std::thread _thread;
+
+//    文件中第 row 行对应的图像行（图像第 0 行在最上面，pfm 从最下面一行开始存）
+    int imageRow(int row) const {
+        return this->_format == ImageFormat::PFM ? this->_ny - 1 - row : row;
+    }
+
+    void store(const Block &block) {
+        int width = block.x1 - block.x0;
+        size_t rowBytes = size_t(this->_nx) * this->_pixelBytes;
+        for (int y = block.y0; y < block.y1; y++) {
+            if (this->_rows[y].empty()) {
+                this->_rows[y].resize(rowBytes);
+            }
+            for (int x = block.x0; x < block.x1; x++) {
+                const Vector3 &pixel = block.pixels[(y - block.y0) * width + (x - block.x0)];
+                char *dst = &this->_rows[y][size_t(x) * this->_pixelBytes];
+                if (this->_format == ImageFormat::PPM) {
+                    unsigned char rgb[3] = {ToByte(pixel.x()), ToByte(pixel.y()), ToByte(pixel.z())};
+                    memcpy(dst, rgb, 3);
+                } else {
+                    float rgb[3] = {float(pixel.x()), float(pixel.y()), float(pixel.z())};
+                    memcpy(dst, rgb, 12);
+                }
+            }
+            this->_rowRemaining[y] -= width;
+        }
+        while (this->_nextRow < this->_ny && this->_rowRemaining[this->imageRow(this->_nextRow)] == 0) {
+            std::vector<char> &row = this->_rows[this->imageRow(this->_nextRow)];
+            this->_fout.write(row.data(), rowBytes);
+            std::vector<char>().swap(row);
+            this->_nextRow++;
+        }
+    }
+
+    void writerLoop() {
+        while (true) {
+            Block block;
+            {
+                std::unique_lock<std::mutex> lock(this->_mutex);
+                this->_condition.wait(lock, [this] { return this->_closed || !this->_queue.empty(); });
+                if (this->_queue.empty()) {
+                    return;
+                }
+                block = std::move(this->_queue.front());
+                this->_queue.pop_front();
+            }
+            this->store(block);
+        }
+    }
+
+public:
+//    gamma 校正，先把 c 限制到 [0, 1]（负数、NaN 当作 0），再转换就不会越界
+    static unsigned char ToByte(double c) {
+        if (!(c > 0)) {
+            c = 0;
+        } else if (c > 1) {
+            c = 1;
+        }
+        return (unsigned char) int(255.99 * sqrt(c));
+    }
+
+//    一次性写整张图（按 ppm 顺序排列）
+    static void Write(const std::string &path, const std::vector<Vector3> &framebuffer,
+                      int nx, int ny, ImageFormat format) {
+        ImageWriter writer(path, nx, ny, format);
+        writer.submit(0, 0, nx, ny, framebuffer.data(), nx);
+        writer.close();
+    }
+
+    ImageWriter(const std::string &path, int nx, int ny, ImageFormat format) :
+            _fout(path, std::ios::binary), _nx(nx), _ny(ny), _format(format),
+            _pixelBytes(format == ImageFormat::PPM ? 3 : 12),
+            _rows(ny), _rowRemaining(ny, nx) {
+        if (!this->_fout) {
+            throw std::runtime_error("can not open " + path);
+        }
+        if (format == ImageFormat::PPM) {
+            this->_fout << "P6\n" << nx << " " << ny << "\n255\n";
+        } else {
+//            比例为负表示小端
+            uint16_t probe = 1;
+            bool littleEndian = *reinterpret_cast<unsigned char *>(&probe) == 1;
+            this->_fout << "PF\n" << nx << " " << ny << "\n" << (littleEndian ? "-1.0" : "1.0") << "\n";
+        }
+        this->_thread = std::thread(&ImageWriter::writerLoop, this);
+    }
+
+    ~ImageWriter() {
+        this->close();
+    }
+
+    /**
+     * 提交一块线性颜色，拷贝后立即返回
+     * @param stride    pixels 中一行的像素数
+     */
+    void submit(int x0, int y0, int x1, int y1, const Vector3 *pixels, int stride) {
+        Block block{x0, y0, x1, y1, {}};
+        block.pixels.reserve(size_t(x1 - x0) * (y1 - y0));
+        for (int y = y0; y < y1; y++) {
+            block.pixels.insert(block.pixels.end(), pixels + size_t(y - y0) * stride,
+                                pixels + size_t(y - y0) * stride + (x1 - x0));
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            this->_queue.push_back(std::move(block));
+        }
+        this->_condition.notify_one();
+    }
+
+//    等待所有块写完并关闭文件
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            if (this->_closed) {
+                return;
+            }
+            this->_closed = true;
+        }
+        this->_condition.notify_one();
+        this->_thread.join();
+        this->_fout.close();
+    }
+};
+
+#endif //IMAGE_HPP
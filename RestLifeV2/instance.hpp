@@ -0,0 +1,160 @@
+#ifndef INSTANCE_HPP
+#define INSTANCE_HPP
+
+#include <cmath>
+#include <stdexcept>
+#include "hitable.hpp"
+
+/**
+ * 3x4 仿射变换，左边 3x3 是线性部分，最后一列是平移
+ */
+typedef Eigen::Matrix<Float, 3, 4> Matrix34;
+typedef Eigen::Matrix<Float, 3, 3> Matrix3;
+
+inline Matrix34 IdentityTransform() {
+    Matrix34 m = Matrix34::Zero();
+    m.leftCols<3>().setIdentity();
+    return m;
+}
+
+inline Matrix34 TranslateTransform(const Vector3 &offset) {
+    Matrix34 m = IdentityTransform();
+    m.col(3) = offset;
+    return m;
+}
+
+//和 RotateY 的转向一致
+inline Matrix34 RotateYTransform(Float angle) {
+    Float radians = degrees_to_radians(angle);
+    Matrix34 m = IdentityTransform();
+    m(0, 0) = cos(radians);
+    m(0, 2) = sin(radians);
+    m(2, 0) = -sin(radians);
+    m(2, 2) = cos(radians);
+    return m;
+}
+
+inline Matrix34 ScaleTransform(const Vector3 &scale) {
+    Matrix34 m = Matrix34::Zero();
+    m.leftCols<3>().diagonal() = scale;
+    return m;
+}
+
+//先做 second 再做 first
+inline Matrix34 ComposeTransform(const Matrix34 &first, const Matrix34 &second) {
+    Matrix34 m;
+    m.leftCols<3>() = first.leftCols<3>() * second.leftCols<3>();
+    m.col(3) = first.leftCols<3>() * second.col(3) + first.col(3);
+    return m;
+}
+
+inline Matrix34 InverseTransform(const Matrix34 &transform) {
+    Matrix3 linear = transform.leftCols<3>();
+    if (std::abs(linear.determinant()) < 1e-12) {
+        throw std::runtime_error("instance transform is not invertible");
+    }
+    Matrix34 m;
+    m.leftCols<3>() = linear.inverse();
+    m.col(3) = -m.leftCols<3>() * transform.col(3);
+    return m;
+}
+
+/**
+ * 两层加速结构中的实例
+ * 底层（BLAS）是每种几何体只建一次的 BVH，通常是 LinearBVH，被任意多个实例共享；
+ * 实例只存一个指针和物体空间到世界空间的变换及其逆，顶层（TLAS）就是在这些实例上建的 LinearBVH。
+ * 内存和建树时间只随不同几何体的数量增长，和实例数量无关。
+ * 材质跟着 BLAS 走，同一个 BLAS 的所有实例材质相同
+ */
+class Instance : public Hitable {
+private:
+    Hitable *_blas;
+    Matrix34 _transform;    // 物体空间 -> 世界空间
+    Matrix34 _inverse;      // 世界空间 -> 物体空间
+    AABB _box;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    Instance(Hitable *blas, const Matrix34 &transform) : _blas(blas) {
+        this->setTransform(transform);
+    }
+
+//    动画中改变实例的位置，BLAS 不动；之后要 refit 顶层 BVH
+    void setTransform(const Matrix34 &transform) {
+        this->_transform = transform;
+        this->_inverse = InverseTransform(transform);
+//        世界空间的包围盒取物体包围盒八个角变换后的包围盒
+        AABB box;
+        if (!this->_blas->boundingBox(0, 1, box)) {
+            throw std::runtime_error("hitable no bound box");
+        }
+        Vector3 min(Infinity, Infinity, Infinity);
+        Vector3 max(-Infinity, -Infinity, -Infinity);
+        for (int k = 0; k < 8; k++) {
+            Vector3 corner{k & 1 ? box.max().x() : box.min().x(),
+                           k & 2 ? box.max().y() : box.min().y(),
+                           k & 4 ? box.max().z() : box.min().z()};
+            Vector3 p = this->_transform.leftCols<3>() * corner + this->_transform.col(3);
+            min = min.cwiseMin(p);
+            max = max.cwiseMax(p);
+        }
+        this->_box = AABB(min, max);
+    }
+
+    Hitable *blas() const {
+        return this->_blas;
+    }
+
+    const Matrix34 &transform() const {
+        return this->_transform;
+    }
+
+    const Matrix34 &inverse() const {
+        return this->_inverse;
+    }
+
+//    把光线变到物体空间求交，再把交点变回来；场景快照里的实例也用这个
+    static bool Hit(const Hitable &blas, const Matrix34 &transform, const Matrix34 &inverse,
+                    const Ray &ray, Float tMin, Float tMax, HitRecord &record) {
+        Vector3 origin = inverse.leftCols<3>() * ray.origin() + inverse.col(3);
+        Vector3 direction = inverse.leftCols<3>() * ray.direction();
+//        Ray 会把方向归一化，有缩放时物体空间的 t 是世界空间的 scale 倍
+        Float scale = direction.norm();
+        Ray localRay(origin, direction, ray.time());
+        if (!blas.hit(localRay, tMin * scale, tMax * scale, record)) {
+            return false;
+        }
+        record.t /= scale;
+        record.p = transform.leftCols<3>() * record.p + transform.col(3);
+//        法线用逆变换的转置
+        record.normal = (inverse.leftCols<3>().transpose() * record.normal).normalized();
+        return true;
+    }
+
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
+        return Hit(*this->_blas, this->_transform, this->_inverse, ray, tMin, tMax, record);
+    }
+
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
+        box = this->_box;
+        return true;
+    }
+
+//    方向 w 变到物体空间是 A w / |A w|（A 是逆变换的线性部分），立体角的雅可比是 |det A| / |A w|^3
+    virtual Float pdfValue(const Vector3 &o, const Vector3 &direction) const {
+        Matrix3 inverseLinear = this->_inverse.leftCols<3>();
+        Vector3 localDirection = inverseLinear * direction.normalized();
+        Float length = localDirection.norm();
+        Vector3 localOrigin = inverseLinear * o + this->_inverse.col(3);
+        return this->_blas->pdfValue(localOrigin, localDirection / length) *
+               std::abs(inverseLinear.determinant()) / (length * length * length);
+    }
+
+    virtual Vector3 random(const Vector3 &o) {
+        Vector3 localOrigin = this->_inverse.leftCols<3>() * o + this->_inverse.col(3);
+        return (this->_transform.leftCols<3>() * this->_blas->random(localOrigin)).normalized();
+    }
+};
+
+#endif //INSTANCE_HPP
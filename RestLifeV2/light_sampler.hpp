@@ -0,0 +1,224 @@
+#ifndef LIGHT_SAMPLER_HPP
+#define LIGHT_SAMPLER_HPP
+
+#include <stdexcept>
+#include <vector>
+#include "hitable.hpp"
+#include "rect.hpp"
+#include "cube.hpp"
+#include "material.hpp"
+#include "bvh.hpp"
+#include "linear_bvh.hpp"
+
+/**
+ * 别名表（Vose 方法）：按权重从 n 个元素中抽一个，O(n) 建表，O(1) 抽样
+ * 每个格子放一个元素的一部分概率和一个"别名"，均匀选格子后再用一次比较决定取格子本身还是别名
+ */
+class AliasTable {
+private:
+    std::vector<double> _threshold;     // 取格子本身的概率
+    std::vector<int> _alias;
+    std::vector<double> _probability;   // 归一化后每个元素的概率
+
+public:
+    AliasTable() {}
+
+    explicit AliasTable(const std::vector<double> &weights) {
+        int n = int(weights.size());
+        double total = 0;
+        for (double weight : weights) {
+            if (!(weight >= 0)) {
+                throw std::runtime_error("alias table weight must be non-negative");
+            }
+            total += weight;
+        }
+        if (n == 0 || total <= 0) {
+            throw std::runtime_error("alias table needs a positive total weight");
+        }
+        this->_threshold.resize(n);
+        this->_alias.resize(n);
+        this->_probability.resize(n);
+//        按平均值缩放：小于 1 的格子从大于 1 的元素借概率补满
+        std::vector<int> small, large;
+        std::vector<double> scaled(n);
+        for (int i = 0; i < n; i++) {
+            this->_probability[i] = weights[i] / total;
+            scaled[i] = this->_probability[i] * n;
+            (scaled[i] < 1 ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            int s = small.back();
+            int l = large.back();
+            small.pop_back();
+            this->_threshold[s] = scaled[s];
+            this->_alias[s] = l;
+            scaled[l] -= 1 - scaled[s];
+            if (scaled[l] < 1) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+//        剩下的格子只差舍入误差，直接取自己
+        for (int i : small) {
+            this->_threshold[i] = 1;
+            this->_alias[i] = i;
+        }
+        for (int i : large) {
+            this->_threshold[i] = 1;
+            this->_alias[i] = i;
+        }
+    }
+
+    int size() const {
+        return int(this->_probability.size());
+    }
+
+//    u 是 [0, 1) 的均匀随机数，整数部分选格子，小数部分决定取格子还是别名
+    int sample(double u) const {
+        double scaled = u * this->size();
+        int i = std::min(int(scaled), this->size() - 1);
+        return scaled - i < this->_threshold[i] ? i : this->_alias[i];
+    }
+
+    double probability(int i) const {
+        return this->_probability[i];
+    }
+};
+
+/**
+ * 多光源采样：把场景中所有发光的物体（材质是 DiffuseLight）按发光功率（亮度 × 面积）建别名表
+ * 作为 light 传给积分器：
+ *  random 用别名表 O(1) 选一个光源，再在它上面采样方向
+ *  pdfValue 在光源自己的 BVH 里找这条光线穿过的光源，只累加这些光源的 概率 × 光源上的 pdf，不扫描全部光源
+ * 目前支持 Sphere 和三种矩形；Translate / RotateY / Instance 里面的光源不参与采样，
+ * 打中它们时 pdfValue 为 0，MIS 积分器按 BSDF 采样计入，结果仍然无偏
+ */
+class LightSampler : public Hitable {
+private:
+    LinearBVH _bvh;
+    std::vector<Float> _probability;    // 和 _bvh.primitives() 一一对应
+    AliasTable _table;
+
+    static const std::vector<Hitable *> &CheckLights(const std::vector<Hitable *> &lights) {
+        if (lights.empty()) {
+            throw std::runtime_error("no emissive primitive for light sampling");
+        }
+        return lights;
+    }
+
+    static const Material *EmissiveMaterial(const Hitable *hitable) {
+        const Material *material = nullptr;
+        if (const Sphere *sphere = dynamic_cast<const Sphere *>(hitable)) {
+            material = sphere->material();
+        } else if (const XYRect *xy = dynamic_cast<const XYRect *>(hitable)) {
+            material = xy->_material;
+        } else if (const XZRect *xz = dynamic_cast<const XZRect *>(hitable)) {
+            material = xz->_material;
+        } else if (const YZRect *yz = dynamic_cast<const YZRect *>(hitable)) {
+            material = yz->_material;
+        }
+        return material && material->type() == MaterialType::DiffuseLight ? material : nullptr;
+    }
+
+//    展开容器找发光的物体，和 SceneSnapshot 展开 BVH 的方式一样
+    static void Gather(const Hitable *hitable, std::vector<Hitable *> &lights) {
+        if (const BVHNode *bvh = dynamic_cast<const BVHNode *>(hitable)) {
+            Gather(bvh->left(), lights);
+            if (bvh->right() != bvh->left()) {
+                Gather(bvh->right(), lights);
+            }
+        } else if (const LinearBVH *linear = dynamic_cast<const LinearBVH *>(hitable)) {
+            for (Hitable *primitive : linear->primitives()) {
+                Gather(primitive, lights);
+            }
+        } else if (const HitableList *hitableList = dynamic_cast<const HitableList *>(hitable)) {
+            for (Hitable *item : hitableList->list()) {
+                Gather(item, lights);
+            }
+        } else if (const Cube *cube = dynamic_cast<const Cube *>(hitable)) {
+            Gather(cube->sides(), lights);
+        } else if (EmissiveMaterial(hitable)) {
+            lights.push_back(const_cast<Hitable *>(hitable));
+        }
+    }
+
+public:
+//    发光功率：发光颜色的亮度乘以面积，纹理取物体中心处的值
+    static double Power(const Hitable *light) {
+        const Material *material = EmissiveMaterial(light);
+        if (!material) {
+            return 0;
+        }
+        double area = 0;
+        Vector3 center;
+        if (const Sphere *sphere = dynamic_cast<const Sphere *>(light)) {
+            area = 4 * M_PI * sphere->radius() * sphere->radius();
+            center = sphere->center();
+        } else if (const XYRect *xy = dynamic_cast<const XYRect *>(light)) {
+            area = (xy->_x1 - xy->_x0) * (xy->_y1 - xy->_y0);
+            center = Vector3(0.5 * (xy->_x0 + xy->_x1), 0.5 * (xy->_y0 + xy->_y1), xy->_k);
+        } else if (const XZRect *xz = dynamic_cast<const XZRect *>(light)) {
+            area = (xz->_x1 - xz->_x0) * (xz->_z1 - xz->_z0);
+            center = Vector3(0.5 * (xz->_x0 + xz->_x1), xz->_k, 0.5 * (xz->_z0 + xz->_z1));
+        } else if (const YZRect *yz = dynamic_cast<const YZRect *>(light)) {
+            area = (yz->_y1 - yz->_y0) * (yz->_z1 - yz->_z0);
+            center = Vector3(yz->_k, 0.5 * (yz->_y0 + yz->_y1), 0.5 * (yz->_z0 + yz->_z1));
+        }
+        Vector3 emit = static_cast<const DiffuseLight *>(material)->emit()->value(0.5, 0.5, center);
+        return (0.2126 * emit.x() + 0.7152 * emit.y() + 0.0722 * emit.z()) * area;
+    }
+
+//    场景里所有可以采样的发光物体
+    static std::vector<Hitable *> Extract(const Hitable *world) {
+        std::vector<Hitable *> lights;
+        Gather(world, lights);
+        return lights;
+    }
+
+//    time0 / time1 同建 BVH 的时间范围
+    LightSampler(const std::vector<Hitable *> &lights, double time0, double time1) :
+            _bvh(CheckLights(lights), time0, time1) {
+        std::vector<double> power;
+        for (Hitable *light : this->_bvh.primitives()) {
+            power.push_back(Power(light));
+        }
+        this->_table = AliasTable(power);
+        for (int i = 0; i < this->_table.size(); i++) {
+            this->_probability.push_back(Float(this->_table.probability(i)));
+        }
+    }
+
+//    自动从场景中找出光源
+    LightSampler(const Hitable *world, double time0, double time1) : LightSampler(Extract(world), time0, time1) {}
+
+    const std::vector<Hitable *> &lights() const {
+        return this->_bvh.primitives();
+    }
+
+    Float probability(int index) const {
+        return this->_probability[index];
+    }
+
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
+        return this->_bvh.hit(ray, tMin, tMax, record);
+    }
+
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
+        return this->_bvh.boundingBox(time0, time1, box);
+    }
+
+    virtual Float pdfValue(const Vector3 &o, const Vector3 &direction) const {
+        const std::vector<Hitable *> &lights = this->_bvh.primitives();
+        Float pdf = 0;
+        this->_bvh.traverse(Ray(o, direction), 0, Infinity, [&](int k) {
+            pdf += this->_probability[k] * lights[k]->pdfValue(o, direction);
+        });
+        return pdf;
+    }
+
+    virtual Vector3 random(const Vector3 &o) {
+        return this->_bvh.primitives()[this->_table.sample(Random::GenUniform())]->random(o);
+    }
+};
+
+#endif //LIGHT_SAMPLER_HPP
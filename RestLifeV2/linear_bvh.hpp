@@ -0,0 +1,312 @@
+#ifndef LINEAR_BVH_HPP
+#define LINEAR_BVH_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include "bvh.hpp"
+
+/**
+ * 扁平化的 BVH 节点，32 字节，两个正好放进一条缓存行
+ * 内部节点的左子节点紧跟在自己后面，offset 是右子节点的下标；叶子的 offset 是第一个物体的下标
+ */
+struct LinearBVHNode {
+    float min[3], max[3];   // 向外取整的 float 包围盒，保证不会比 double 的包围盒小
+    uint32_t offset;
+    uint16_t count;         // 叶子中的物体数，0 表示内部节点
+    uint8_t axis;           // 内部节点的划分轴，遍历时据此先走近的子节点
+    uint8_t pad;
+
+    bool leaf() const {
+        return this->count > 0;
+    }
+};
+
+static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode should be 32 bytes");
+
+/**
+ * 数组形式的 BVH
+ * 非递归遍历：显式栈，先走光线方向上近的子节点，找到交点后立刻缩短 tMax，
+ * 远处的子树大多在包围盒测试时就被剔除；叶子可以是任意 Hitable
+ */
+class LinearBVH : public Hitable {
+private:
+    static const int StackSize = 64;
+
+    AABB _box;
+    std::vector<LinearBVHNode> _nodes;
+    std::vector<Hitable *> _primitives;
+    int _depth = 0;
+
+    static float RoundDown(double x) {
+        float f = float(x);
+        return double(f) > x ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    static float RoundUp(double x) {
+        float f = float(x);
+        return double(f) < x ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+
+    int addNode(const AABB &box) {
+        LinearBVHNode node;
+        for (int a = 0; a < 3; a++) {
+            node.min[a] = RoundDown(box.min()[a]);
+            node.max[a] = RoundUp(box.max()[a]);
+        }
+        node.offset = 0;
+        node.count = 0;
+        node.axis = 0;
+        node.pad = 0;
+        this->_nodes.push_back(node);
+        return int(this->_nodes.size()) - 1;
+    }
+
+    void addLeaf(const AABB &box, const std::vector<Hitable *> &list) {
+        int index = this->addNode(box);
+        this->_nodes[index].offset = uint32_t(this->_primitives.size());
+        this->_nodes[index].count = uint16_t(list.size());
+        this->_primitives.insert(this->_primitives.end(), list.begin(), list.end());
+    }
+
+    void flatten(const BVHBuilder &builder, int index, int depth) {
+        const BVHBuilder::Node &node = builder.nodes()[index];
+        this->_depth = std::max(this->_depth, depth);
+        if (node.leaf()) {
+            std::vector<Hitable *> list;
+            for (int i = node.begin; i < node.begin + node.count; i++) {
+                list.push_back(builder.primitives()[i].hitable);
+            }
+            this->addLeaf(node.box, list);
+            return;
+        }
+        int current = this->addNode(node.box);
+        this->_nodes[current].axis = uint8_t(node.axis);
+        this->flatten(builder, node.left, depth + 1);
+        this->_nodes[current].offset = uint32_t(this->_nodes.size());
+        this->flatten(builder, node.right, depth + 1);
+    }
+
+//    已经建好的 BVHNode 树：BVHNode 是内部节点，其它 Hitable 都当作单个物体的叶子
+    void flatten(const Hitable *hitable, double time0, double time1, int depth) {
+        this->_depth = std::max(this->_depth, depth);
+        const BVHNode *bvh = dynamic_cast<const BVHNode *>(hitable);
+        AABB box;
+        if (!bvh) {
+            if (!hitable->boundingBox(time0, time1, box)) {
+                throw std::runtime_error("hitable no bound box");
+            }
+            this->addLeaf(box, {const_cast<Hitable *>(hitable)});
+            return;
+        }
+        if (bvh->left() == bvh->right()) {
+            this->flatten(bvh->left(), time0, time1, depth);
+            return;
+        }
+        int current = this->addNode(bvh->box());
+//        划分轴取两个子节点中心相距最远的轴
+        AABB leftBox, rightBox;
+        bvh->left()->boundingBox(time0, time1, leftBox);
+        bvh->right()->boundingBox(time0, time1, rightBox);
+        Vector3 distance = (rightBox.center() - leftBox.center()).cwiseAbs();
+        int axis = 0;
+        for (int a = 1; a < 3; a++) {
+            axis = distance[a] > distance[axis] ? a : axis;
+        }
+        this->_nodes[current].axis = uint8_t(axis);
+        this->flatten(bvh->left(), time0, time1, depth + 1);
+        this->_nodes[current].offset = uint32_t(this->_nodes.size());
+        this->flatten(bvh->right(), time0, time1, depth + 1);
+    }
+
+    void checkDepth() const {
+        if (this->_depth >= StackSize) {
+            throw std::runtime_error("bvh too deep for LinearBVH traversal stack");
+        }
+    }
+
+//    建树时限制树深，只有物体多到 ceil(log2(n)) 接近栈大小时 checkDepth 才会失败
+    void build(const std::vector<Hitable *> &list, double time0, double time1, const BVHBuildOptions &options,
+               BVHBuildStats *stats) {
+        BVHBuilder builder(list, time0, time1, options.limitDepth(StackSize - 1));
+        this->_box = builder.nodes()[0].box;
+        this->_nodes.reserve(builder.nodes().size());
+        this->_primitives.reserve(list.size());
+        this->flatten(builder, 0, 0);
+        this->checkDepth();
+        if (stats) {
+            *stats = builder.stats();
+        }
+    }
+
+public:
+//    板测试，用光线里缓存的方向倒数和符号，NaN 的处理见 AABB::ClipSlab
+    static bool HitBox(const LinearBVHNode &node, const Vector3 &origin, const Vector3 &invDir, const int *sign,
+                       Float tMin, Float tMax) {
+        for (int a = 0; a < 3; a++) {
+            AABB::ClipSlab(sign[a] ? node.max[a] : node.min[a], sign[a] ? node.min[a] : node.max[a],
+                           origin[a], invDir[a], tMin, tMax);
+        }
+        return tMin < tMax;
+    }
+
+    LinearBVH(const std::vector<Hitable *> &list, double time0, double time1,
+              const BVHBuildOptions &options = BVHBuildOptions(), BVHBuildStats *stats = nullptr) {
+        this->build(list, time0, time1, options, stats);
+    }
+
+//    扁平化一棵现成的 BVHNode 树，时间范围要和建这棵树时一样，树本身不会被释放
+//    树深超过遍历栈时用展开出来的物体重新建一棵限制了深度的树
+    LinearBVH(const BVHNode *root, double time0, double time1) {
+        this->_box = root->box();
+        this->flatten(root, time0, time1, 0);
+        if (this->_depth >= StackSize) {
+            std::vector<Hitable *> list;
+            list.swap(this->_primitives);
+            this->_nodes.clear();
+            this->_depth = 0;
+            this->build(list, time0, time1, BVHBuildOptions(), nullptr);
+        }
+    }
+
+    const std::vector<LinearBVHNode> &nodes() const {
+        return this->_nodes;
+    }
+
+    const std::vector<Hitable *> &primitives() const {
+        return this->_primitives;
+    }
+
+    size_t memoryBytes() const {
+        return this->_nodes.size() * sizeof(LinearBVHNode) + this->_primitives.size() * sizeof(Hitable *);
+    }
+
+    /**
+     * 物体移动后自底向上重新计算包围盒，拓扑不变
+     * 子节点的下标总比父节点大，倒序扫一遍数组就能保证先算完子节点
+     */
+    void refit(double time0, double time1) {
+        for (int i = int(this->_nodes.size()) - 1; i >= 0; i--) {
+            LinearBVHNode &node = this->_nodes[i];
+            if (node.leaf()) {
+                AABB box;
+                for (uint32_t k = node.offset; k < node.offset + node.count; k++) {
+                    AABB primitiveBox;
+                    if (!this->_primitives[k]->boundingBox(time0, time1, primitiveBox)) {
+                        throw std::runtime_error("hitable no bound box");
+                    }
+                    box = k == node.offset ? primitiveBox : AABB::Union(box, primitiveBox);
+                }
+                for (int a = 0; a < 3; a++) {
+                    node.min[a] = RoundDown(box.min()[a]);
+                    node.max[a] = RoundUp(box.max()[a]);
+                }
+                continue;
+            }
+            const LinearBVHNode &left = this->_nodes[i + 1];
+            const LinearBVHNode &right = this->_nodes[node.offset];
+            for (int a = 0; a < 3; a++) {
+                node.min[a] = std::min(left.min[a], right.min[a]);
+                node.max[a] = std::max(left.max[a], right.max[a]);
+            }
+        }
+        const LinearBVHNode &root = this->_nodes[0];
+        this->_box = AABB({root.min[0], root.min[1], root.min[2]}, {root.max[0], root.max[1], root.max[2]});
+    }
+
+//    和 BVHBuildStats::sahCost 同样的定义，refit 之后用来判断树的质量变差了多少
+    double sahCost(double traversalCost = 1.0, double intersectionCost = 1.0) const {
+        auto area = [](const LinearBVHNode &node) {
+            double x = node.max[0] - node.min[0], y = node.max[1] - node.min[1], z = node.max[2] - node.min[2];
+            return 2.0 * (x * y + y * z + z * x);
+        };
+        double rootArea = area(this->_nodes[0]);
+        double cost = 0;
+        for (const LinearBVHNode &node : this->_nodes) {
+            cost += area(node) * (node.leaf() ? node.count * intersectionCost : traversalCost);
+        }
+        return rootArea > 0 ? cost / rootArea : cost;
+    }
+
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
+        const Vector3 &origin = ray.origin();
+        const Vector3 &invDir = ray.invDirection();
+        const int *negative = ray.sign();
+        int stack[StackSize];
+        int top = 0;
+        int current = 0;
+        bool hit = false;
+        HitRecord temp;
+        while (true) {
+            const LinearBVHNode &node = this->_nodes[current];
+            BVH_STATS_NODE(1);
+            if (HitBox(node, origin, invDir, negative, tMin, tMax)) {
+                if (node.leaf()) {
+                    BVH_STATS_PRIMITIVES(node.count);
+                    for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                        if (this->_primitives[i]->hit(ray, tMin, tMax, temp)) {
+                            hit = true;
+                            tMax = temp.t;
+                            record = temp;
+                        }
+                    }
+                } else if (negative[node.axis]) {
+//                    光线沿划分轴负方向走，右子节点更近
+                    stack[top++] = current + 1;
+                    current = int(node.offset);
+                    continue;
+                } else {
+                    stack[top++] = int(node.offset);
+                    current = current + 1;
+                    continue;
+                }
+            }
+            if (top == 0) {
+                break;
+            }
+            current = stack[--top];
+        }
+        return hit;
+    }
+
+    /**
+     * 访问光线在 [tMin, tMax] 内穿过的所有叶子里的物体，不找最近交点，也不缩短 tMax
+     * visit(k) 的 k 是 primitives() 的下标，物体本身是否和光线相交由调用方判断
+     */
+    template<typename Visitor>
+    void traverse(const Ray &ray, Float tMin, Float tMax, const Visitor &visit) const {
+        const Vector3 &origin = ray.origin();
+        const Vector3 &invDir = ray.invDirection();
+        const int *negative = ray.sign();
+        int stack[StackSize];
+        int top = 0;
+        int current = 0;
+        while (true) {
+            const LinearBVHNode &node = this->_nodes[current];
+            BVH_STATS_NODE(1);
+            if (HitBox(node, origin, invDir, negative, tMin, tMax)) {
+                if (node.leaf()) {
+                    for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                        visit(int(i));
+                    }
+                } else {
+                    stack[top++] = int(node.offset);
+                    current = current + 1;
+                    continue;
+                }
+            }
+            if (top == 0) {
+                break;
+            }
+            current = stack[--top];
+        }
+    }
+
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
+        box = this->_box;
+        return true;
+    }
+};
+
+#endif //LINEAR_BVH_HPP
@@ -1,6 +1,11 @@
 #ifndef MATERIAL_HPP
 #define MATERIAL_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
 #include "texture.hpp"
 #include "hitable.hpp"
 #include "onb.hpp"
@@ -9,153 +14,307 @@
 struct ScatterRecord {
     Ray specularRay;
     bool isSpecular;        // 只是改变光的方向，而本身并没有颜色，也就没有散射光，不需要pdf
-    Vector3d attenuation;   // 衰减
-    PDF *pdf;               // 散射光的 pdf
+    Vector3 attenuation;    // 衰减
+    ScatterPDF pdf;         // 散射光的 pdf，按值存放
 };
 
+//out = in + 2B, B=dot(-in,n)*n=--dot(in,n)*n
+Vector3 reflect(const Vector3 &v, const Vector3 &n) {
+    return (v - 2 * v.dot(n) * n).normalized();
+}
+
+//ni*sin(theta_i)=nt*sin(theta_t)
+bool refract(const Vector3 &v, const Vector3 &n, Float niOverNt, Vector3 &refracted) {
+    Vector3 uv = v.normalized();
+    Float dt = uv.dot(n);  // -cos(theta_i)
+    Float discriminant = 1.0 - niOverNt * niOverNt * (1 - dt * dt);
+//    sqrt(discriminant)=cos(theta_t)
+    if (discriminant > 0) {
+        refracted = niOverNt * (uv - n * dt) - n * sqrt(discriminant);
+        refracted = refracted.normalized();
+        return true;
+    } else {
+        return false;
+    }
+}
+
+//菲涅尔反射
+Float schlick(Float cosine, Float refIdx) {
+    Float r0 = (1 - refIdx) / (1 + refIdx);
+    r0 = r0 * r0;
+//    lerp: pow((1 - cosine), 5) to 1
+    return (1 - r0) * pow((1 - cosine), 5) + r0;
+}
+
+//None 是不散射也不发光的空材质
+enum class MaterialType : uint8_t {
+    None, Lambertian, Metal, Dielectric, DiffuseLight
+};
+
+//把材质类型变成编译期常量，传给 Material::Dispatch 的回调
+template<MaterialType Type>
+using MaterialTag = std::integral_constant<MaterialType, Type>;
+
+/**
+ * 封闭的材质集合：类型标签加一组扁平的参数，scatter / scatterPDF / emitted 用 switch 分派，没有虚函数
+ * 子类（Lambertian、Metal、Dielectric、DiffuseLight）只负责设置标签和参数，不能添加成员，所有材质大小相同
+ * 带模板参数的 scatterAs 等函数在编译期就确定了类型，批量着色时按类型分组，一组只分派一次，BSDF 代码可以内联进循环
+ */
 class Material {
+protected:
+    MaterialType _type = MaterialType::None;
+    Texture *_texture = nullptr;    // Lambertian 的反射率，DiffuseLight 的发光颜色
+    Vector3 _albedo{0, 0, 0};       // Metal 的反射率
+    Float _parameter = 0;           // Metal 的模糊度，Dielectric 的折射率
+
 public:
-    virtual bool scatter(const Ray &ray, const HitRecord &hitRecord, ScatterRecord &scatterRecord) const {
-        return false;
-    };
+    MaterialType type() const {
+        return this->_type;
+    }
 
-    virtual double scatterPDF(const Ray &ray, const HitRecord &hitRecord, Ray const &scattered) const {
-        return 0;
-    };
+    /**
+     * 对一种类型的材质调用 body(MaterialTag<Type>())，body 里用 decltype(tag)::value 取出类型
+     * 在一批同类型交点的循环外调用，把运行时的类型变成模板参数
+     */
+    template<typename Body>
+    static void Dispatch(MaterialType type, const Body &body) {
+        switch (type) {
+            case MaterialType::None:
+                body(MaterialTag<MaterialType::None>());
+                break;
+            case MaterialType::Lambertian:
+                body(MaterialTag<MaterialType::Lambertian>());
+                break;
+            case MaterialType::Metal:
+                body(MaterialTag<MaterialType::Metal>());
+                break;
+            case MaterialType::Dielectric:
+                body(MaterialTag<MaterialType::Dielectric>());
+                break;
+            case MaterialType::DiffuseLight:
+                body(MaterialTag<MaterialType::DiffuseLight>());
+                break;
+        }
+    }
 
-    virtual Vector3d emitted(const Ray &ray, const HitRecord &hitRecord, double u, double v, const Vector3d &p) const {
-        return Vector3d{0, 0, 0};
+    /**
+     * 批量着色：先把 items 按材质类型排序（同类型里再按材质地址，其余保持原来的顺序），
+     * 再对每一组同类型的条目 [begin, end) 调用一次 body(tag, begin, end)
+     * @param materialOf materialOf(item) 返回条目交点的材质
+     */
+    template<typename Item, typename MaterialOf, typename Body>
+    static void ShadeBatch(std::vector<Item> &items, const MaterialOf &materialOf, const Body &body) {
+        std::stable_sort(items.begin(), items.end(), [&](const Item &a, const Item &b) {
+            const Material *ma = materialOf(a);
+            const Material *mb = materialOf(b);
+            return ma->_type != mb->_type ? ma->_type < mb->_type : std::less<const Material *>()(ma, mb);
+        });
+        for (size_t begin = 0, end; begin < items.size(); begin = end) {
+            MaterialType type = materialOf(items[begin])->_type;
+            for (end = begin + 1; end < items.size() && materialOf(items[end])->_type == type; end++);
+            Dispatch(type, [&](auto tag) {
+                body(tag, begin, end);
+            });
+        }
     }
+
+//    调用方保证 Type 就是这个材质的类型
+    template<MaterialType Type>
+    bool scatterAs(const Ray &ray, const HitRecord &record, ScatterRecord &scatterRecord) const;
+
+    template<MaterialType Type>
+    Float scatterPDFAs(const Ray &ray, const HitRecord &hitRecord, Ray const &scattered) const;
+
+    template<MaterialType Type>
+    Vector3 emittedAs(const Ray &ray, const HitRecord &record, Float u, Float v, const Vector3 &p) const;
+
+//    按类型标签分派，定义在各类型的特化之后
+    bool scatter(const Ray &ray, const HitRecord &hitRecord, ScatterRecord &scatterRecord) const;
+
+    Float scatterPDF(const Ray &ray, const HitRecord &hitRecord, Ray const &scattered) const;
+
+    Vector3 emitted(const Ray &ray, const HitRecord &hitRecord, Float u, Float v, const Vector3 &p) const;
 };
 
+//没有特化的组合：不散射、不发光
+template<MaterialType Type>
+bool Material::scatterAs(const Ray &ray, const HitRecord &record, ScatterRecord &scatterRecord) const {
+    return false;
+}
+
+template<MaterialType Type>
+Float Material::scatterPDFAs(const Ray &ray, const HitRecord &hitRecord, Ray const &scattered) const {
+    return 0;
+}
+
+template<MaterialType Type>
+Vector3 Material::emittedAs(const Ray &ray, const HitRecord &record, Float u, Float v, const Vector3 &p) const {
+    return Vector3{0, 0, 0};
+}
+
 //Lambertian 反射：理想散射
+template<>
+inline bool Material::scatterAs<MaterialType::Lambertian>(const Ray &ray, const HitRecord &hitRecord,
+                                                          ScatterRecord &scatterRecord) const {
+    scatterRecord.isSpecular = false;
+    scatterRecord.attenuation = this->_texture->value(hitRecord.u, hitRecord.v, hitRecord.p);
+    scatterRecord.pdf = ScatterPDF::Cosine(hitRecord.normal);
+    return true;
+}
+
+//均匀分布的概率pdf（先乘均匀分布的概率pdf，再除个性化采样的概率pdf）
+template<>
+inline Float Material::scatterPDFAs<MaterialType::Lambertian>(const Ray &ray, const HitRecord &hitRecord,
+                                                              Ray const &scattered) const {
+    Float cosine = hitRecord.normal.dot(scattered.direction());
+    cosine = cosine < 0 ? 0 : cosine;
+    return cosine / M_PI;
+}
+
+//金属：镜面反射，_parameter 是模糊度
+template<>
+inline bool Material::scatterAs<MaterialType::Metal>(const Ray &ray, const HitRecord &record,
+                                                     ScatterRecord &scatterRecord) const {
+    Vector3 reflected = reflect(ray.direction(), record.normal);
+    scatterRecord.specularRay = Ray::Spawn(record.p, record.normal, reflected + this->_parameter * randomUnitSphere(),
+                                           ray.time());
+    scatterRecord.isSpecular = true;
+    scatterRecord.attenuation = this->_albedo;
+    scatterRecord.pdf = ScatterPDF();
+    return true;
+}
+
+//电解质：折射，_parameter 是折射率
+template<>
+inline bool Material::scatterAs<MaterialType::Dielectric>(const Ray &ray, const HitRecord &record,
+                                                          ScatterRecord &scatterRecord) const {
+    Float refIdx = this->_parameter;
+    scatterRecord.isSpecular = true;
+    scatterRecord.pdf = ScatterPDF();
+    scatterRecord.attenuation = Vector3(1.0, 1.0, 1.0);
+    Vector3 reflected = reflect(ray.direction(), record.normal);
+    Vector3 outwardNormal;
+    Float niOverNt;
+    Float cosine;
+    if (ray.direction().dot(record.normal) > 0) {
+        outwardNormal = -record.normal;
+        niOverNt = refIdx;
+        cosine = refIdx * ray.direction().dot(record.normal);
+    } else {
+        outwardNormal = record.normal;
+        niOverNt = 1.0 / refIdx;
+        cosine = -ray.direction().dot(record.normal);
+    }
+    Vector3 refracted;
+    Float reflectProb;
+    if (refract(ray.direction(), outwardNormal, niOverNt, refracted)) {
+        reflectProb = schlick(cosine, refIdx);
+    } else {
+        reflectProb = 1.0; // 全反射
+    }
+    if (Random::GenUniform() < reflectProb) {
+        scatterRecord.specularRay = Ray::Spawn(record.p, record.normal, reflected, ray.time());
+    } else {
+        scatterRecord.specularRay = Ray::Spawn(record.p, record.normal, refracted, ray.time());
+    }
+    return true;
+}
+
+template<>
+inline Vector3 Material::emittedAs<MaterialType::DiffuseLight>(const Ray &ray, const HitRecord &record,
+                                                               Float u, Float v, const Vector3 &p) const {
+//    天花板周围的灯有噪声，因为灯是双面的，这里删除一个面，只要向下的光
+    if (record.normal.dot(ray.direction()) < 0.0) {
+        return this->_texture->value(u, v, p);
+    } else {
+        return {0, 0, 0};
+    }
+}
+
+inline bool Material::scatter(const Ray &ray, const HitRecord &hitRecord, ScatterRecord &scatterRecord) const {
+    switch (this->_type) {
+        case MaterialType::Lambertian:
+            return this->scatterAs<MaterialType::Lambertian>(ray, hitRecord, scatterRecord);
+        case MaterialType::Metal:
+            return this->scatterAs<MaterialType::Metal>(ray, hitRecord, scatterRecord);
+        case MaterialType::Dielectric:
+            return this->scatterAs<MaterialType::Dielectric>(ray, hitRecord, scatterRecord);
+        default:
+            return false;
+    }
+}
+
+inline Float Material::scatterPDF(const Ray &ray, const HitRecord &hitRecord, Ray const &scattered) const {
+    if (this->_type == MaterialType::Lambertian) {
+        return this->scatterPDFAs<MaterialType::Lambertian>(ray, hitRecord, scattered);
+    }
+    return 0;
+}
+
+inline Vector3 Material::emitted(const Ray &ray, const HitRecord &hitRecord, Float u, Float v,
+                                 const Vector3 &p) const {
+    if (this->_type == MaterialType::DiffuseLight) {
+        return this->emittedAs<MaterialType::DiffuseLight>(ray, hitRecord, u, v, p);
+    }
+    return Vector3{0, 0, 0};
+}
+
 class Lambertian : public Material {
-private:
-//    Vector3d _albedo; // 反射率
-    Texture *_albedo;
 public:
-    explicit Lambertian(Texture *albedo) : _albedo(albedo) {}
+    explicit Lambertian(Texture *albedo) {
+        this->_type = MaterialType::Lambertian;
+        this->_texture = albedo;
+    }
 
-    virtual bool scatter(const Ray &ray, const HitRecord &hitRecord, ScatterRecord &scatterRecord) const {
-        scatterRecord.isSpecular = false;
-        scatterRecord.attenuation = this->_albedo->value(hitRecord.u, hitRecord.v, hitRecord.p);
-        scatterRecord.pdf = new CosinePDF(hitRecord.normal);
-        return true;
-    };
-
-//    均匀分布的概率pdf（先乘均匀分布的概率pdf，再除个性化采样的概率pdf）
-    virtual double scatterPDF(const Ray &ray, const HitRecord &hitRecord, Ray const &scattered) const {
-        double cosine = hitRecord.normal.dot(scattered.direction());
-        cosine = cosine < 0 ? 0 : cosine;
-        return cosine / M_PI;
-    };
+    Texture *albedo() const {
+        return this->_texture;
+    }
 };
 
-//out = in + 2B, B=dot(-in,n)*n=--dot(in,n)*n
-Vector3d reflect(const Vector3d &v, const Vector3d &n) {
-    return (v - 2 * v.dot(n) * n).normalized();
-}
-
 ////金属模型
 class Metal : public Material {
-private:
-    Vector3d _albedo; // 反射率
-    double _fuzz = 0; // 模糊度参数（=反射偏移的球半径），最大为1，球体越大，反射的模糊度越高，这时并不再是镜面反射；默认无影响
 public:
-    explicit Metal(const Vector3d &albedo, double fuzz = 0) : _albedo(albedo) {
+//    fuzz 是模糊度参数（=反射偏移的球半径），最大为1，球体越大，反射的模糊度越高，这时并不再是镜面反射；默认无影响
+    explicit Metal(const Vector3 &albedo, Float fuzz = 0) {
+        this->_type = MaterialType::Metal;
+        this->_albedo = albedo;
         if (fuzz < 1) {
-            this->_fuzz = fuzz;
+            this->_parameter = fuzz;
         } else {
-            this->_fuzz = 1;
+            this->_parameter = 1;
         }
     }
 
-    virtual bool scatter(const Ray &ray, const HitRecord &record,  ScatterRecord &scatterRecord) const {
-        Vector3d reflected = reflect(ray.direction(), record.normal);
-        scatterRecord.specularRay = Ray(record.p, reflected + this->_fuzz * randomUnitSphere());
-        scatterRecord.isSpecular = true;
-        scatterRecord.attenuation = this->_albedo;
-        scatterRecord.pdf = nullptr;
-        return true;
+    const Vector3 &albedo() const {
+        return this->_albedo;
     }
-};
 
-//ni*sin(theta_i)=nt*sin(theta_t)
-bool refract(const Vector3d &v, const Vector3d &n, double niOverNt, Vector3d &refracted) {
-    Vector3d uv = v.normalized();
-    double dt = uv.dot(n); // -cos(theta_i)
-    double discriminant = 1.0 - niOverNt * niOverNt * (1 - dt * dt);
-//    sqrt(discriminant)=cos(theta_t)
-    if (discriminant > 0) {
-        refracted = niOverNt * (uv - n * dt) - n * sqrt(discriminant);
-        refracted = refracted.normalized();
-        return true;
-    } else {
-        return false;
+    Float fuzz() const {
+        return this->_parameter;
     }
-}
-
-//菲涅尔反射
-double schlick(double cosine, double refIdx) {
-    double r0 = (1 - refIdx) / (1 + refIdx);
-    r0 = r0 * r0;
-//    lerp: pow((1 - cosine), 5) to 1
-    return (1 - r0) * pow((1 - cosine), 5) + r0;
-}
+};
 
-//电解质：折射
 class Dielectric : public Material {
-private:
-    double _redIdx; // 折射率
 public:
-    Dielectric(double redIdx) : _redIdx(redIdx) {}
-
-    virtual bool scatter(const Ray &ray, const HitRecord &record, ScatterRecord &scatterRecord) const {
-        scatterRecord.isSpecular = true;
-        scatterRecord.pdf = nullptr;
-        scatterRecord.attenuation = Vector3d (1.0, 1.0, 1.0);
-        Vector3d reflected = reflect(ray.direction(), record.normal);
-        Vector3d outwardNormal;
-        double niOverNt;
-        double cosine;
-        if (ray.direction().dot(record.normal) > 0) {
-            outwardNormal = -record.normal;
-            niOverNt = this->_redIdx;
-            cosine = this->_redIdx * ray.direction().dot(record.normal);
-        } else {
-            outwardNormal = record.normal;
-            niOverNt = 1.0 / this->_redIdx;
-            cosine = -ray.direction().dot(record.normal);
-        }
-        Vector3d refracted;
-        double reflectProb;
-        if (refract(ray.direction(), outwardNormal, niOverNt, refracted)) {
-            reflectProb = schlick(cosine, this->_redIdx);
-        } else {
-            reflectProb = 1.0; // 全反射
-        }
-        if (drand48() < reflectProb) {
-            scatterRecord.specularRay = Ray(record.p, reflected);
-        } else {
-            scatterRecord.specularRay  = Ray(record.p, refracted);
-        }
-        return true;
+    Dielectric(Float redIdx) {
+        this->_type = MaterialType::Dielectric;
+        this->_parameter = redIdx;
+    }
+
+    Float refIdx() const {
+        return this->_parameter;
     }
 };
 
 class DiffuseLight : public Material {
-private:
-    Texture *_emit;
 public:
-    DiffuseLight(Texture *emit) : _emit(emit) {}
+    DiffuseLight(Texture *emit) {
+        this->_type = MaterialType::DiffuseLight;
+        this->_texture = emit;
+    }
 
-    virtual Vector3d emitted(const Ray &ray, const HitRecord &record, double u, double v, const Vector3d &p) const {
-//        天花板周围的灯有噪声，因为灯是双面的，这里删除一个面，只要向下的光
-        if (record.normal.dot(ray.direction()) < 0.0) {
-            return this->_emit->value(u, v, p);
-        } else {
-            return {0, 0, 0};
-        }
+    Texture *emit() const {
+        return this->_texture;
     }
 };
 
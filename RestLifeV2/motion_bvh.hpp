@@ -0,0 +1,188 @@
+#ifndef MOTION_BVH_HPP
+#define MOTION_BVH_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include "bvh.hpp"
+
+/**
+ * 运动 BVH 节点，64 字节正好一条缓存行
+ * 存快门开始和结束两个时刻的包围盒，光线的时刻在两者之间线性插值
+ */
+struct MotionBVHNode {
+    float min0[3], max0[3];     // time0 时的包围盒
+    float min1[3], max1[3];     // time1 时的包围盒
+    uint32_t offset;            // 内部节点：右子节点下标（左子节点紧跟在后面）；叶子：第一个物体的下标
+    uint16_t count;             // 叶子中的物体数，0 表示内部节点
+    uint8_t axis;
+    uint8_t pad[9];
+
+    bool leaf() const {
+        return this->count > 0;
+    }
+};
+
+static_assert(sizeof(MotionBVHNode) == 64, "MotionBVHNode should be 64 bytes");
+
+/**
+ * 运动模糊用的 BVH
+ * 普通 BVH 用整个快门时间内的包围盒并集，一个高速运动的物体会把所有祖先节点撑大；
+ * 这里每个节点存两端时刻的包围盒，遍历时按 ray.time() 插值。
+ * 假设物体在快门时间内线性运动（MovingSphere 就是这样），此时插值出的盒子一定包住该时刻的所有物体
+ */
+class MotionBVH : public Hitable {
+private:
+    static const int StackSize = 64;
+
+    double _time0, _time1;
+    AABB _box;
+    std::vector<MotionBVHNode> _nodes;
+    std::vector<Hitable *> _primitives;
+    int _depth = 0;
+
+    static float RoundDown(double x) {
+        float f = float(x);
+        return double(f) > x ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    static float RoundUp(double x) {
+        float f = float(x);
+        return double(f) < x ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+
+//    物体在某一时刻的包围盒
+    static AABB BoxAt(Hitable *hitable, double time) {
+        AABB box;
+        if (!hitable->boundingBox(time, time, box)) {
+            throw std::runtime_error("hitable no bound box");
+        }
+        return box;
+    }
+
+//    返回子树在 time0 / time1 的包围盒
+    void flatten(const BVHBuilder &builder, int index, int depth, AABB &box0, AABB &box1) {
+        const BVHBuilder::Node &node = builder.nodes()[index];
+        this->_depth = std::max(this->_depth, depth);
+        int current = int(this->_nodes.size());
+        this->_nodes.emplace_back();
+        MotionBVHNode flat;
+        memset(&flat, 0, sizeof(flat));
+        if (node.leaf()) {
+            flat.offset = uint32_t(this->_primitives.size());
+            flat.count = uint16_t(node.count);
+            for (int i = node.begin; i < node.begin + node.count; i++) {
+                Hitable *hitable = builder.primitives()[i].hitable;
+                AABB start = BoxAt(hitable, this->_time0), end = BoxAt(hitable, this->_time1);
+                box0 = i == node.begin ? start : AABB::Union(box0, start);
+                box1 = i == node.begin ? end : AABB::Union(box1, end);
+                this->_primitives.push_back(hitable);
+            }
+        } else {
+            AABB left0, left1, right0, right1;
+            this->flatten(builder, node.left, depth + 1, left0, left1);
+            flat.offset = uint32_t(this->_nodes.size());
+            this->flatten(builder, node.right, depth + 1, right0, right1);
+            flat.axis = uint8_t(node.axis);
+            box0 = AABB::Union(left0, right0);
+            box1 = AABB::Union(left1, right1);
+        }
+        for (int a = 0; a < 3; a++) {
+            flat.min0[a] = RoundDown(box0.min()[a]);
+            flat.max0[a] = RoundUp(box0.max()[a]);
+            flat.min1[a] = RoundDown(box1.min()[a]);
+            flat.max1[a] = RoundUp(box1.max()[a]);
+        }
+        this->_nodes[current] = flat;
+    }
+
+//    插值出 s 时刻的盒子再做板测试，NaN 的处理见 AABB::ClipSlab
+    static bool HitBox(const MotionBVHNode &node, Float s, const Vector3 &origin, const Vector3 &invDir,
+                       const int *sign, Float tMin, Float tMax) {
+        for (int a = 0; a < 3; a++) {
+            Float min = node.min0[a] + s * (node.min1[a] - node.min0[a]);
+            Float max = node.max0[a] + s * (node.max1[a] - node.max0[a]);
+            AABB::ClipSlab(sign[a] ? max : min, sign[a] ? min : max, origin[a], invDir[a], tMin, tMax);
+        }
+        return tMin < tMax;
+    }
+
+public:
+    /**
+     *
+     * @param time0, time1 快门时间，光线的时刻应当在这个范围内
+     */
+    MotionBVH(const std::vector<Hitable *> &list, double time0, double time1,
+              const BVHBuildOptions &options = BVHBuildOptions(), BVHBuildStats *stats = nullptr) :
+            _time0(time0), _time1(time1) {
+//        拓扑按整个快门时间的包围盒来建，限制树深保证遍历栈放得下
+        BVHBuilder builder(list, time0, time1, options.limitDepth(StackSize - 1));
+        this->_box = builder.nodes()[0].box;
+        this->_nodes.reserve(builder.nodes().size());
+        this->_primitives.reserve(list.size());
+        AABB box0, box1;
+        this->flatten(builder, 0, 0, box0, box1);
+        if (this->_depth >= StackSize) {
+            throw std::runtime_error("bvh too deep for MotionBVH traversal stack");
+        }
+        if (stats) {
+            *stats = builder.stats();
+        }
+    }
+
+    const std::vector<MotionBVHNode> &nodes() const {
+        return this->_nodes;
+    }
+
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
+        Float s = this->_time1 > this->_time0 ? (ray.time() - this->_time0) / (this->_time1 - this->_time0) : 0;
+        s = std::min(std::max(s, Float(0)), Float(1));
+        const Vector3 &origin = ray.origin();
+        const Vector3 &invDir = ray.invDirection();
+        const int *negative = ray.sign();
+        int stack[StackSize];
+        int top = 0;
+        int current = 0;
+        bool hit = false;
+        HitRecord temp;
+        while (true) {
+            const MotionBVHNode &node = this->_nodes[current];
+            BVH_STATS_NODE(1);
+            if (HitBox(node, s, origin, invDir, negative, tMin, tMax)) {
+                if (node.leaf()) {
+                    BVH_STATS_PRIMITIVES(node.count);
+                    for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                        if (this->_primitives[i]->hit(ray, tMin, tMax, temp)) {
+                            hit = true;
+                            tMax = temp.t;
+                            record = temp;
+                        }
+                    }
+                } else if (negative[node.axis]) {
+                    stack[top++] = current + 1;
+                    current = int(node.offset);
+                    continue;
+                } else {
+                    stack[top++] = int(node.offset);
+                    current = current + 1;
+                    continue;
+                }
+            }
+            if (top == 0) {
+                break;
+            }
+            current = stack[--top];
+        }
+        return hit;
+    }
+
+//    整个快门时间内的包围盒
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
+        box = this->_box;
+        return true;
+    }
+};
+
+#endif //MOTION_BVH_HPP
@@ -8,44 +8,45 @@
  */
 class ONB {
 private:
-    Vector3d _axis[3];
+    Vector3 _axis[3];
 public:
-    ONB() {}
+//    默认是世界坐标轴，没有设置过的 ONB（如镜面散射时 ScatterPDF 里的）也有确定的值
+    ONB() : _axis{Vector3{1, 0, 0}, Vector3{0, 1, 0}, Vector3{0, 0, 1}} {}
 
 //    以n为一个方向建立直角坐标系
-    ONB(const Vector3d &n) {
+    ONB(const Vector3 &n) {
         this->_axis[2] = n.normalized();
-        Vector3d a; // 选取一个与n不平行的a，这里选择坐标轴
+        Vector3 a;  // 选取一个与n不平行的a，这里选择坐标轴
         if (abs(this->w().x()) > 0.9) {
-            a = Vector3d{0, 1, 0};
+            a = Vector3{0, 1, 0};
         } else {
-            a = Vector3d{1, 0, 0};
+            a = Vector3{1, 0, 0};
         }
         this->_axis[1] = this->w().cross(a);
         this->_axis[0] = this->w().cross(this->v());
     }
 
-    inline Vector3d operator[](int i) const {
+    inline Vector3 operator[](int i) const {
         return this->_axis[i];
     }
 
-    Vector3d u() const {
+    Vector3 u() const {
         return this->_axis[0];
     }
 
-    Vector3d v() const {
+    Vector3 v() const {
         return this->_axis[1];
     }
 
-    Vector3d w() const {
+    Vector3 w() const {
         return this->_axis[2];
     }
 
-    Vector3d local(double a, double b, double c) const {
+    Vector3 local(Float a, Float b, Float c) const {
         return a * this->u() + b * this->v() + c * this->w();
     }
 
-    Vector3d local(Vector3d a) const{
+    Vector3 local(Vector3 a) const{
         return this->local(a.x(), a.y(), a.z());
     }
 };
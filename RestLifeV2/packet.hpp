@@ -0,0 +1,207 @@
+#ifndef PACKET_HPP
+#define PACKET_HPP
+
+#include <cstdint>
+#include "bvh.hpp"
+
+#if defined(__AVX__) || defined(__SSE2__)
+
+#include <immintrin.h>
+
+#endif
+
+/**
+ * 光线包：N 条相干光线（例如同一像素的 N 个样本）按 SoA 存放，一起遍历 BVH
+ * 起点和方向倒数按分量连续存放，可以直接装进 SSE/AVX 寄存器
+ */
+template<int N>
+struct RayPacket {
+    static_assert(N % 4 == 0 && N <= 32, "packet size must be 4, 8, 16 or 32");
+
+    alignas(32) double ox[N], oy[N], oz[N];
+    alignas(32) double invDx[N], invDy[N], invDz[N];
+    alignas(32) double tMax[N];
+    Ray rays[N];
+    int count = 0;
+
+    void set(int k, const Ray &ray, double tMax = MAXFLOAT) {
+        this->rays[k] = ray;
+        this->ox[k] = ray.origin().x();
+        this->oy[k] = ray.origin().y();
+        this->oz[k] = ray.origin().z();
+        this->invDx[k] = ray.invDirection().x();
+        this->invDy[k] = ray.invDirection().y();
+        this->invDz[k] = ray.invDirection().z();
+        this->tMax[k] = tMax;
+    }
+
+//    有效光线的掩码，第 k 位对应第 k 条光线
+    uint32_t valid() const {
+        return this->count >= 32 ? 0xFFFFFFFFu : (1u << this->count) - 1;
+    }
+
+//    所有光线方向的符号（Ray::sign，-0.0 算负）都一致时才算相干，否则一起遍历几乎没有收益
+    bool coherent() const {
+        for (int axis = 0; axis < 3; axis++) {
+            int negative = this->rays[0].sign()[axis];
+            for (int k = 1; k < this->count; k++) {
+                if (this->rays[k].sign()[axis] != negative) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+/**
+ * 光线包遍历 BVHNode
+ * 每个节点用一次 SIMD 板（slab）测试检查包里的所有光线，只要有一条命中就往下走；
+ * 包不相干或者节点下只剩很少的光线时退回单条光线遍历
+ */
+template<int N>
+class PacketTracer {
+private:
+    struct Entry {
+        const Hitable *node;
+        uint32_t mask;
+        bool leaf;      // 不是 BVHNode，由父节点记录的标志给出
+    };
+
+    static int PopCount(uint32_t mask) {
+        int count = 0;
+        for (; mask; mask &= mask - 1) {
+            count++;
+        }
+        return count;
+    }
+
+    /**
+     * 板测试，和 AABB::hit 一样按方向符号挑近端和远端平面，整个包的符号相同（见 coherent），挑一次就够了
+     * max(t, tNear) / min(t, tFar) 指令在 t 是 NaN 时返回第二个操作数，和 ClipSlab 的比较写法结果相同：
+     * 光线恰好在板平面上（0 * inf）时这一轴不起作用，单条光线和光线包的判断一致
+     */
+    static uint32_t HitBox(const AABB &box, const int *sign, const RayPacket<N> &packet, double tMin,
+                           uint32_t active) {
+        uint32_t mask = 0;
+        double near[3], far[3];
+        for (int axis = 0; axis < 3; axis++) {
+            near[axis] = sign[axis] ? box.max()[axis] : box.min()[axis];
+            far[axis] = sign[axis] ? box.min()[axis] : box.max()[axis];
+        }
+#if defined(__AVX__)
+        for (int k = 0; k < N; k += 4) {
+            __m256d tNear = _mm256_set1_pd(tMin);
+            __m256d tFar = _mm256_loadu_pd(packet.tMax + k);
+            __m256d o = _mm256_loadu_pd(packet.ox + k), inv = _mm256_loadu_pd(packet.invDx + k);
+            tNear = _mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(near[0]), o), inv), tNear);
+            tFar = _mm256_min_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(far[0]), o), inv), tFar);
+            o = _mm256_loadu_pd(packet.oy + k), inv = _mm256_loadu_pd(packet.invDy + k);
+            tNear = _mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(near[1]), o), inv), tNear);
+            tFar = _mm256_min_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(far[1]), o), inv), tFar);
+            o = _mm256_loadu_pd(packet.oz + k), inv = _mm256_loadu_pd(packet.invDz + k);
+            tNear = _mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(near[2]), o), inv), tNear);
+            tFar = _mm256_min_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(far[2]), o), inv), tFar);
+            mask |= uint32_t(_mm256_movemask_pd(_mm256_cmp_pd(tNear, tFar, _CMP_LT_OQ))) << k;
+        }
+#elif defined(__SSE2__)
+        for (int k = 0; k < N; k += 2) {
+            __m128d tNear = _mm_set1_pd(tMin);
+            __m128d tFar = _mm_loadu_pd(packet.tMax + k);
+            __m128d o = _mm_loadu_pd(packet.ox + k), inv = _mm_loadu_pd(packet.invDx + k);
+            tNear = _mm_max_pd(_mm_mul_pd(_mm_sub_pd(_mm_set1_pd(near[0]), o), inv), tNear);
+            tFar = _mm_min_pd(_mm_mul_pd(_mm_sub_pd(_mm_set1_pd(far[0]), o), inv), tFar);
+            o = _mm_loadu_pd(packet.oy + k), inv = _mm_loadu_pd(packet.invDy + k);
+            tNear = _mm_max_pd(_mm_mul_pd(_mm_sub_pd(_mm_set1_pd(near[1]), o), inv), tNear);
+            tFar = _mm_min_pd(_mm_mul_pd(_mm_sub_pd(_mm_set1_pd(far[1]), o), inv), tFar);
+            o = _mm_loadu_pd(packet.oz + k), inv = _mm_loadu_pd(packet.invDz + k);
+            tNear = _mm_max_pd(_mm_mul_pd(_mm_sub_pd(_mm_set1_pd(near[2]), o), inv), tNear);
+            tFar = _mm_min_pd(_mm_mul_pd(_mm_sub_pd(_mm_set1_pd(far[2]), o), inv), tFar);
+            mask |= uint32_t(_mm_movemask_pd(_mm_cmplt_pd(tNear, tFar))) << k;
+        }
+#else
+        for (int k = 0; k < N; k++) {
+            double tNear = tMin, tFar = packet.tMax[k];
+            const double o[3] = {packet.ox[k], packet.oy[k], packet.oz[k]};
+            const double inv[3] = {packet.invDx[k], packet.invDy[k], packet.invDz[k]};
+            for (int axis = 0; axis < 3; axis++) {
+                double t0 = (near[axis] - o[axis]) * inv[axis];
+                double t1 = (far[axis] - o[axis]) * inv[axis];
+                tNear = t0 > tNear ? t0 : tNear;
+                tFar = t1 < tFar ? t1 : tFar;
+            }
+            mask |= uint32_t(tNear < tFar) << k;
+        }
+#endif
+        return mask & active;
+    }
+
+//    单条光线求交，打中时缩短这条光线的 tMax
+    static bool HitSingle(const Hitable *node, RayPacket<N> &packet, int k, double tMin, HitRecord &record) {
+        HitRecord temp;
+        if (node->hit(packet.rays[k], tMin, packet.tMax[k], temp)) {
+            packet.tMax[k] = temp.t;
+            record = temp;
+            return true;
+        }
+        return false;
+    }
+
+public:
+    /**
+     * 对包里的有效光线求交，records[k] 是第 k 条光线最近的交点
+     * @param minActive 节点下命中的光线少于这个数时，这棵子树改用单条光线遍历
+     * @return 命中掩码
+     */
+    static uint32_t Hit(const Hitable *root, RayPacket<N> &packet, double tMin, HitRecord *records,
+                        int minActive = N / 4) {
+        uint32_t hits = 0;
+        uint32_t valid = packet.valid();
+        if (!packet.coherent()) {
+            for (int k = 0; k < packet.count; k++) {
+                hits |= uint32_t(HitSingle(root, packet, k, tMin, records[k])) << k;
+            }
+            return hits;
+        }
+
+        const int *sign = packet.rays[0].sign();
+        Entry stack[128];
+        int top = 0;
+//        只有根节点需要判断类型，之后子节点是不是 BVHNode 由父节点给出
+        stack[top++] = Entry{root, valid, dynamic_cast<const BVHNode *>(root) == nullptr};
+        while (top > 0) {
+            Entry entry = stack[--top];
+//            叶子（任意 Hitable）：每条命中父节点的光线分别求交
+            if (entry.leaf) {
+                for (int k = 0; k < N; k++) {
+                    if (entry.mask >> k & 1) {
+                        hits |= uint32_t(HitSingle(entry.node, packet, k, tMin, records[k])) << k;
+                    }
+                }
+                continue;
+            }
+            const BVHNode *node = static_cast<const BVHNode *>(entry.node);
+            BVH_STATS_NODE(PopCount(entry.mask));
+            uint32_t mask = HitBox(node->box(), sign, packet, tMin, entry.mask);
+            if (mask == 0) {
+                continue;
+            }
+            if (PopCount(mask) < minActive || top + 2 > 128) {
+                for (int k = 0; k < N; k++) {
+                    if (mask >> k & 1) {
+                        hits |= uint32_t(HitSingle(node, packet, k, tMin, records[k])) << k;
+                    }
+                }
+                continue;
+            }
+//            只有一个物体的节点左右是同一个
+            if (node->right() != node->left()) {
+                stack[top++] = Entry{node->right(), mask, node->rightLeaf()};
+            }
+            stack[top++] = Entry{node->left(), mask, node->leftLeaf()};
+        }
+        return hits;
+    }
+};
+
+#endif //PACKET_HPP
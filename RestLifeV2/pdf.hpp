@@ -1,6 +1,7 @@
 #ifndef PDF_HPP
 #define PDF_HPP
 
+#include <stdexcept>
 #include "common.hpp"
 #include "onb.hpp"
 #include "random.hpp"
@@ -10,10 +11,10 @@
 class PDF {
 public:
 //    计算生成的 pdf
-    virtual double value(const Vector3d &direction) const = 0;
+    virtual Float value(const Vector3 &direction) const = 0;
 
 //    概率生成
-    virtual Vector3d generate() const = 0;
+    virtual Vector3 generate() const = 0;
 };
 
 //以法线为z的坐标系下，一个半球的pdf
@@ -21,12 +22,12 @@ class CosinePDF : public PDF {
 private:
     ONB _uvw;
 public:
-    CosinePDF(const Vector3d &n) {
+    CosinePDF(const Vector3 &n) {
         this->_uvw = ONB(n);
     }
 
-    virtual double value(const Vector3d &direction) const {
-        double cosine = this->_uvw.w().dot(direction);
+    static Float Value(const ONB &uvw, const Vector3 &direction) {
+        Float cosine = uvw.w().dot(direction);
         if (cosine > 0) {
             return cosine / M_PI;
         } else {
@@ -34,49 +35,107 @@ public:
         }
     }
 
-    virtual Vector3d generate() const {
-        Vector3d direction;
+    static Vector3 Generate(const ONB &uvw) {
+        Vector3 direction;
         do {
-            direction = this->_uvw.local(randomCosineDirection());
-        } while (this->value(direction) < PDF_Epslion);
+            direction = uvw.local(randomCosineDirection());
+        } while (Value(uvw, direction) < PDF_Epslion);
         return direction;
     }
+
+    virtual Float value(const Vector3 &direction) const {
+        return Value(this->_uvw, direction);
+    }
+
+    virtual Vector3 generate() const {
+        return Generate(this->_uvw);
+    }
+};
+
+/**
+ * 材质散射光的 pdf，按值放在 ScatterRecord 里，每次弹射不再 new 一个 pdf
+ * 用类型标签区分分布，分布需要的数据（目前只有法线坐标系）也一起放在里面；新增分布时在 switch 里加一支
+ */
+class ScatterPDF : public PDF {
+public:
+    enum class Type {
+        None,       // 镜面散射不需要 pdf
+        Cosine
+    };
+
+private:
+    Type _type = Type::None;
+    ONB _uvw;
+
+public:
+    ScatterPDF() {}
+
+    static ScatterPDF Cosine(const Vector3 &n) {
+        ScatterPDF pdf;
+        pdf._type = Type::Cosine;
+        pdf._uvw = ONB(n);
+        return pdf;
+    }
+
+    Type type() const {
+        return this->_type;
+    }
+
+    virtual Float value(const Vector3 &direction) const {
+        switch (this->_type) {
+            case Type::Cosine:
+                return CosinePDF::Value(this->_uvw, direction);
+            case Type::None:
+                break;
+        }
+        return 0;
+    }
+
+    virtual Vector3 generate() const {
+        switch (this->_type) {
+            case Type::Cosine:
+                return CosinePDF::Generate(this->_uvw);
+            case Type::None:
+                break;
+        }
+        throw std::runtime_error("generate from an empty scatter pdf");
+    }
 };
 
 //可以传入Hitable光源
 class HitablePDF : public PDF {
 private:
     Hitable *_hitable;
-    Vector3d _o;
+    Vector3 _o;
 public:
-    HitablePDF(Hitable *hitable, const Vector3d &o) : _hitable(hitable), _o(o) {}
+    HitablePDF(Hitable *hitable, const Vector3 &o) : _hitable(hitable), _o(o) {}
 
-    virtual double value(const Vector3d &direction) const {
+    virtual Float value(const Vector3 &direction) const {
         return this->_hitable->pdfValue(this->_o, direction);
     }
 
-    virtual Vector3d generate() const {
+    virtual Vector3 generate() const {
         return this->_hitable->random(this->_o);
     }
 };
 
-//混合cos pdf和light pdf
+//混合cos pdf和light pdf，两个 pdf 都由调用者持有（通常在栈上）
 class MixturePDF : public PDF {
 private:
-    PDF *_pdf[2];
+    const PDF *_pdf[2];
 public:
-    MixturePDF(PDF *p0, PDF *p1) {
+    MixturePDF(const PDF *p0, const PDF *p1) {
         this->_pdf[0] = p0;
         this->_pdf[1] = p1;
     }
 
-    virtual double value(const Vector3d &direction) const {
+    virtual Float value(const Vector3 &direction) const {
         return 0.5 * this->_pdf[0]->value(direction) +
                0.5 * this->_pdf[1]->value(direction);
     }
 
-    virtual Vector3d generate() const {
-        if (Random::GenUniformRandom(0, 1) < 0.5) {
+    virtual Vector3 generate() const {
+        if (Random::GenUniform() < 0.5) {
             return this->_pdf[0]->generate();
         } else {
             return this->_pdf[1]->generate();
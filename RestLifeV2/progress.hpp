@@ -0,0 +1,143 @@
+#ifndef PROGRESS_HPP
+#define PROGRESS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+//每个线程自己数发出的光线，完成一个像素后再合并到 Progress，最内层循环里没有原子操作
+thread_local uint64_t ThreadRayCount = 0;
+
+/**
+ * 渲染进度与吞吐量
+ * 渲染线程用 add 累加原子计数，后台线程按固定频率刷新一行：进度条、百分比、samples/s、rays/s、剩余时间
+ */
+class Progress {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t _totalSamples;
+    std::chrono::milliseconds _interval;
+    std::atomic<uint64_t> _samples{0};
+    std::atomic<uint64_t> _rays{0};
+    std::atomic<uint64_t> _restored{0};     // 从检查点恢复的样本，只算进度不算速度
+    Clock::time_point _start;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _stop = false;
+    std::thread _reporter;
+
+    static std::string FormatRate(double rate) {
+        char buffer[32];
+        if (rate >= 1e9) {
+            snprintf(buffer, sizeof(buffer), "%.2fG", rate / 1e9);
+        } else if (rate >= 1e6) {
+            snprintf(buffer, sizeof(buffer), "%.2fM", rate / 1e6);
+        } else if (rate >= 1e3) {
+            snprintf(buffer, sizeof(buffer), "%.2fK", rate / 1e3);
+        } else {
+            snprintf(buffer, sizeof(buffer), "%.0f", rate);
+        }
+        return buffer;
+    }
+
+    static std::string FormatTime(double seconds) {
+        char buffer[32];
+        long s = long(seconds + 0.5);
+        snprintf(buffer, sizeof(buffer), "%ldh%02ldm%02lds", s / 3600, s / 60 % 60, s % 60);
+        return buffer;
+    }
+
+    void report(bool last) {
+        double elapsed = std::chrono::duration<double>(Clock::now() - this->_start).count();
+        uint64_t samples = this->_samples.load(std::memory_order_relaxed);
+        uint64_t rays = this->_rays.load(std::memory_order_relaxed);
+        uint64_t restored = this->_restored.load(std::memory_order_relaxed);
+        double progress = this->_totalSamples ? double(samples + restored) / this->_totalSamples : 1.0;
+        progress = progress > 1.0 ? 1.0 : progress;
+        double samplesPerSecond = elapsed > 0 ? samples / elapsed : 0;
+        double raysPerSecond = elapsed > 0 ? rays / elapsed : 0;
+
+        int barWidth = 50;
+        int pos = int(barWidth * progress);
+        std::string bar(barWidth, ' ');
+        for (int i = 0; i < barWidth; ++i) {
+            bar[i] = i < pos ? '=' : (i == pos ? '>' : ' ');
+        }
+        std::cout << "[" << bar << "] " << int(progress * 100.0) << " % "
+                  << FormatRate(samplesPerSecond) << " samples/s "
+                  << FormatRate(raysPerSecond) << " rays/s ";
+        if (last) {
+            std::cout << "total " << FormatTime(elapsed) << "\n";
+        } else {
+            double eta = samplesPerSecond > 0 ?
+                         (this->_totalSamples - std::min(this->_totalSamples, samples + restored)) / samplesPerSecond : 0;
+            std::cout << "ETA " << FormatTime(eta) << "   \r";
+        }
+//    \r：回车不换行
+        std::cout.flush();
+    }
+
+    void reporterLoop() {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        while (!this->_condition.wait_for(lock, this->_interval, [this] { return this->_stop; })) {
+            this->report(false);
+        }
+    }
+
+public:
+    /**
+     *
+     * @param totalSamples  预计的总样本数，用来算百分比和剩余时间
+     * @param intervalMs    刷新间隔
+     */
+    explicit Progress(uint64_t totalSamples, int intervalMs = 250) :
+            _totalSamples(totalSamples), _interval(intervalMs), _start(Clock::now()) {
+        this->_reporter = std::thread(&Progress::reporterLoop, this);
+    }
+
+    ~Progress() {
+        this->finish();
+    }
+
+    void add(uint64_t samples, uint64_t rays) {
+        this->_samples.fetch_add(samples, std::memory_order_relaxed);
+        this->_rays.fetch_add(rays, std::memory_order_relaxed);
+    }
+
+//    已经完成的样本（例如从检查点恢复），计入进度但不计入吞吐量
+    void restore(uint64_t samples) {
+        this->_restored.fetch_add(samples, std::memory_order_relaxed);
+    }
+
+    uint64_t samples() const {
+        return this->_samples.load(std::memory_order_relaxed);
+    }
+
+    uint64_t rays() const {
+        return this->_rays.load(std::memory_order_relaxed);
+    }
+
+//    停止刷新并打印最终统计
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            if (this->_stop) {
+                return;
+            }
+            this->_stop = true;
+        }
+        this->_condition.notify_one();
+        this->_reporter.join();
+        this->report(true);
+    }
+};
+
+#endif //PROGRESS_HPP
@@ -2,34 +2,89 @@
 #define RANDOM_HPP
 
 #include <random>
+#include <ctime>
+#include <cstdint>
+#include <limits>
 
+/**
+ * 基于计数器的随机数流（splitmix64）
+ * 第 n 个随机数只由 (key, n) 决定：key 由像素和样本编号得到，n 是这个样本里的第几维
+ * 因此每个样本都可以单独复现，与线程、调度顺序无关
+ */
 struct RandomConfig {
-    std::default_random_engine RandomEngine = std::default_random_engine(time(nullptr));
-    double RandomScale = 1000.0; // 使小数随机更加精确
-} RandomConfigInstance;
+    typedef uint64_t result_type;
+
+    uint64_t Key = uint64_t(time(nullptr));
+    uint64_t Counter = 0;
+
+    static constexpr uint64_t min() {
+        return 0;
+    }
+
+    static constexpr uint64_t max() {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+    uint64_t operator()() {
+        return Mix(this->Key + (++this->Counter) * 0x9E3779B97F4A7C15ull);
+    }
+
+    static uint64_t Mix(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+};
+
+//每个线程一个随机数流，多线程渲染时互不干扰
+thread_local RandomConfig RandomConfigInstance;
 
 class Random {
 public:
+//        splitmix64，把相邻的种子打散
+    static uint64_t Hash(uint64_t x) {
+        return RandomConfig::Mix(x + 0x9E3779B97F4A7C15ull);
+    }
+
+//        重置当前线程的随机数流，同一个种子得到同一个序列（与线程无关）
+    static void Seed(uint64_t seed) {
+        RandomConfigInstance.Key = Hash(seed);
+        RandomConfigInstance.Counter = 0;
+    }
+
+//        开始像素 pixel 的第 sample 个样本，之后取到的随机数依次是它的第 dimension, dimension + 1... 维
+    static void StartSample(uint64_t pixel, uint64_t sample, uint64_t dimension = 0) {
+        RandomConfigInstance.Key = Hash(Hash(pixel) ^ sample);
+        RandomConfigInstance.Counter = dimension;
+    }
+
+//        当前样本已经用掉的维数
+    static uint64_t Dimension() {
+        return RandomConfigInstance.Counter;
+    }
+
+//        [0, 1)，取高 53 位正好填满 double 的尾数
+    static double GenUniform() {
+        return (RandomConfigInstance() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
 //        double 下 p(end) = 0 因此并不关心
     static double GenUniformRandom(double start, double end) {
-        std::uniform_int_distribution<double> dis(start * RandomConfigInstance.RandomScale,
-                                                  end * RandomConfigInstance.RandomScale);
-        return dis(RandomConfigInstance.RandomEngine) / RandomConfigInstance.RandomScale;
+        return start + (end - start) * GenUniform();
     }
 
 //        end 不可取值
     static int GenUniformRandomi(int start, int end) {
-        std::uniform_int_distribution<int> dis(start, end - 1);
-        return dis(RandomConfigInstance.RandomEngine);
+        return start + int(GenUniform() * (end - start));
     }
 
     static double GenNormalRandom(double mean, double stddev) {
-        std::normal_distribution<double> dis(mean * RandomConfigInstance.RandomScale, stddev);
-        return dis(RandomConfigInstance.RandomEngine) / RandomConfigInstance.RandomScale;
+        std::normal_distribution<double> dis(mean, stddev);
+        return dis(RandomConfigInstance);
     }
 
     static bool GenBool() {
-        return GenUniformRandom(0.0, 1.0) > 0.5;
+        return GenUniform() > 0.5;
     }
 };
 
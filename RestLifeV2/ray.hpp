@@ -5,26 +5,75 @@
 
 class Ray {
 private:
-    Vector3d _A, _B;
-    double _time; // 照相机的快门开关有一定的时间
+    Vector3 _A, _B;
+    Float _time;  // 照相机的快门开关有一定的时间
+//    方向的倒数和符号在构造时算好，每次包围盒测试不用再做除法；分量为 0 时倒数是 ±inf
+    Vector3 _invB;
+    int _sign[3];
+
+    void cacheInverse() {
+        for (int i = 0; i < 3; i++) {
+            this->_invB[i] = 1 / this->_B[i];
+            this->_sign[i] = this->_invB[i] < 0.0;
+        }
+    }
+
 public:
     Ray() {}
 
-    Ray(const Vector3d &a, const Vector3d &b, double time = 0.0) : _A(a), _B(b.normalized()), _time(time) {}
+    Ray(const Vector3 &a, const Vector3 &b, Float time = 0.0) : _A(a), _B(b.normalized()), _time(time) {
+        this->cacheInverse();
+    }
+
+//    方向已经是单位向量（例如从另一条光线的 direction() 取出来的）时不再归一化，
+//    重新归一化可能改变最低位，拆开存放再拼回来的光线就和原来的不完全一样
+    static Ray FromUnitDirection(const Vector3 &a, const Vector3 &unit, Float time = 0.0) {
+        Ray ray;
+        ray._A = a;
+        ray._B = unit;
+        ray._time = time;
+        ray.cacheInverse();
+        return ray;
+    }
+
+    /**
+     * 把交点 p 沿几何法线 n 推开，推到哪一侧由 n 的符号决定
+     * 求交的舍入误差和坐标的大小成正比，推开的距离取 p 最大分量的 64 个 ulp 再加一点绝对量，
+     * float 和 double 构建用同一个式子；从推开的起点出发的光线 tMin 取 0，不再需要固定的 0.001
+     */
+    static Vector3 OffsetOrigin(const Vector3 &p, const Vector3 &n) {
+        const Float epsilon = 64 * std::numeric_limits<Float>::epsilon();
+        return p + epsilon * (1 + p.cwiseAbs().maxCoeff()) * n;
+    }
+
+//    从表面上的 p 点沿 direction 发出一条光线，起点推到 direction 所在的一侧
+    static Ray Spawn(const Vector3 &p, const Vector3 &n, const Vector3 &direction, Float time = 0.0) {
+        return Ray(OffsetOrigin(p, direction.dot(n) < 0 ? Vector3(-n) : n), direction, time);
+    }
 
-    Vector3d origin() const {
+    Vector3 origin() const {
         return this->_A;
     }
 
-    Vector3d direction() const {
+    Vector3 direction() const {
         return this->_B;
     }
 
-    double time() const {
+//    方向每个分量的倒数
+    const Vector3 &invDirection() const {
+        return this->_invB;
+    }
+
+//    方向分量为负时是 1（-0.0 的倒数是 -inf，也算负），板测试据此挑近端和远端平面
+    const int *sign() const {
+        return this->_sign;
+    }
+
+    Float time() const {
         return this->_time;
     }
 
-    Vector3d operator()(double t) const {
+    Vector3 operator()(Float t) const {
         return this->_A + t * this->_B;
     }
 };
@@ -0,0 +1,541 @@
+#ifndef RENDER_HPP
+#define RENDER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "camera.hpp"
+#include "utils.hpp"
+#include "image.hpp"
+#include "progress.hpp"
+#include "packet.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * 分块渲染器
+ * 把图像切成 tileSize x tileSize 的块交给线程池，每个样本的随机数只由 (像素, 样本编号, 维度) 决定，
+ * 因此输出与线程数、分块大小、调度顺序无关
+ *
+ * 自适应采样：每个像素在线统计亮度的均值和方差（Welford），
+ * 第一阶段最多用 ns 个样本，误差达标就提前停下；第二阶段把省下来的样本按误差比例分给还没收敛的像素
+ *
+ * 渐进渲染：每个阶段按 passSamples 个样本一遍一遍地渲染，定期把累积缓冲、每个像素的样本数存成检查点。
+ * 第 s 个样本的随机数只和 s 有关，所以样本数就是全部的随机数状态；
+ * 检查点原样保存累积值和 Welford 统计量（double），从检查点继续得到的图像和一次渲染完的逐字节相同
+ */
+class Renderer {
+private:
+    struct Tile {
+        int x0, y0, x1, y1;
+    };
+
+    struct PixelState {
+        Vector3 sum{0, 0, 0};
+        double mean = 0;        // 亮度均值
+        double m2 = 0;          // 亮度离差平方和
+        int n = 0;
+        int target = 0;         // 当前阶段要采到的样本数
+        bool done = false;      // 当前阶段已经收敛
+    };
+
+    /**
+     * 检查点文件格式，本机字节序，逐个字段读写，没有填充：
+     *  头：magic "RTCK"，int32 的版本、nx、ny、ns、adaptive、minSamples、maxSamples，double 的 relativeError，int32 的 stage
+     *  之后按像素顺序每个像素一条记录：double[3] 颜色和，int32 样本数；
+     *  自适应时再加 double[2] 亮度均值和离差平方和，int32 目标样本数，uint8 是否收敛
+     * 颜色和在 float 构建下也存成 double，转换是精确的；不开自适应时每个像素 28 字节，4000x4000 的图约 448MB
+     */
+    static const int32_t CheckpointVersion = 3;
+    static const int CheckpointChunkPixels = 1 << 16;     // 每次读写的像素数，不另外分配整张图的缓冲
+
+    int _nx, _ny, _ns;
+    int _tileSize;
+    Camera *_camera;
+    Hitable *_world;
+    Hitable *_light;
+    ThreadPool _pool;
+    std::function<Vector3(const Ray &)> _integrator;
+    int _packetSize = 0;
+    bool _customIntegrator = false;
+    bool _deNan = false;
+
+    bool _adaptive = false;
+    int _minSamples = 0;
+    int _maxSamples = 0;
+    double _relativeError = 0;
+    std::vector<int> _sampleCounts;
+
+    int _passSamples = 0;
+    std::string _checkpointPath;
+    int _checkpointSeconds = 0;
+
+//    95% 置信区间半宽与均值之比，暗像素按 1/256 算，避免纯黑处永远不收敛
+    double relativeError(const PixelState &state) const {
+        if (state.n < 2) {
+            return Infinity;
+        }
+        double variance = state.m2 / (state.n - 1);
+        return 1.96 * sqrt(variance / state.n) / std::max(state.mean, 1.0 / 256.0);
+    }
+
+    bool converged(const PixelState &state) const {
+        return state.n >= this->_minSamples && this->relativeError(state) <= this->_relativeError;
+    }
+
+//    累加一个样本，自适应时每 minSamples 个检查一次是否已经收敛
+    void addSample(PixelState &state, const Vector3 &col) const {
+        state.sum += col;
+        state.n++;
+        if (this->_adaptive) {
+            double luminance = 0.2126 * col.x() + 0.7152 * col.y() + 0.0722 * col.z();
+            double delta = luminance - state.mean;
+            state.mean += delta / state.n;
+            state.m2 += delta * (luminance - state.mean);
+            if (state.n % this->_minSamples == 0 && this->converged(state)) {
+                state.done = true;
+            }
+        }
+    }
+
+//    给像素 (i, j) 再采 count 个样本
+    void samplePixel(int i, int j, PixelState &state, int count) const {
+        switch (this->_packetSize) {
+            case 4:
+                return this->samplePixelPacket<4>(i, j, state, count);
+            case 8:
+                return this->samplePixelPacket<8>(i, j, state, count);
+            case 16:
+                return this->samplePixelPacket<16>(i, j, state, count);
+            default:
+                break;
+        }
+        int end = state.n + count;
+        while (state.n < end && !state.done) {
+            int s = state.n;
+            Random::StartSample(j * this->_nx + i, s);
+            double u = double(i + Random::GenUniform()) / double(this->_nx);
+            double v = double(j + Random::GenUniform()) / double(this->_ny);
+            Ray ray = this->_camera->getRay(u, v);
+            Vector3 col = this->_integrator(ray);
+            this->addSample(state, this->_deNan ? deNan(col) : col);
+        }
+    }
+
+//    同一个像素的 N 个样本的相机光线打成一个包求交，之后每个样本各自从第一个交点继续追踪
+//    一个包不跨过收敛检查点，所以结果和逐个样本完全一样
+    template<int N>
+    void samplePixelPacket(int i, int j, PixelState &state, int count) const {
+        int pixel = j * this->_nx + i;
+        int end = state.n + count;
+        RayPacket<N> packet;
+        HitRecord records[N];
+        uint64_t dimensions[N];
+        while (state.n < end && !state.done) {
+            int first = state.n;
+            int m = std::min(N, end - first);
+            if (this->_adaptive) {
+                m = std::min(m, this->_minSamples - first % this->_minSamples);
+            }
+            for (int k = 0; k < m; k++) {
+                Random::StartSample(pixel, first + k);
+                double u = double(i + Random::GenUniform()) / double(this->_nx);
+                double v = double(j + Random::GenUniform()) / double(this->_ny);
+                packet.set(k, this->_camera->getRay(u, v));
+                BVH_STATS_RAY(0);
+                dimensions[k] = Random::Dimension();
+            }
+            packet.count = m;
+//            ignore hit when t is near zero
+            uint32_t hits = PacketTracer<N>::Hit(this->_world, packet, 0, records);
+            ThreadRayCount += m;
+            for (int k = 0; k < m && !state.done; k++) {
+                Random::StartSample(pixel, first + k, dimensions[k]);
+                Vector3 col = PathColorFromHit(packet.rays[k], hits >> k & 1, records[k], this->_world, this->_light);
+                this->addSample(state, this->_deNan ? deNan(col) : col);
+            }
+        }
+    }
+
+    int checkpointRecordBytes() const {
+        return this->_adaptive ? 49 : 28;
+    }
+
+    void checkpointSettings(int32_t settings[7]) const {
+        settings[0] = CheckpointVersion;
+        settings[1] = this->_nx;
+        settings[2] = this->_ny;
+        settings[3] = this->_ns;
+        settings[4] = this->_adaptive;
+        settings[5] = this->_minSamples;
+        settings[6] = this->_maxSamples;
+    }
+
+    void packPixel(const PixelState &state, char *dst) const {
+        double sum[3] = {double(state.sum.x()), double(state.sum.y()), double(state.sum.z())};
+        int32_t n = state.n;
+        memcpy(dst, sum, 24);
+        memcpy(dst + 24, &n, 4);
+        if (this->_adaptive) {
+            double moments[2] = {state.mean, state.m2};
+            int32_t target = state.target;
+            uint8_t done = state.done;
+            memcpy(dst + 28, moments, 16);
+            memcpy(dst + 44, &target, 4);
+            memcpy(dst + 48, &done, 1);
+        }
+    }
+
+//    不开自适应时 target 保持调用前设置的 ns，done 保持 false
+    void unpackPixel(const char *src, PixelState &state) const {
+        double sum[3];
+        int32_t n;
+        memcpy(sum, src, 24);
+        memcpy(&n, src + 24, 4);
+        state.sum = Vector3(Float(sum[0]), Float(sum[1]), Float(sum[2]));
+        state.n = n;
+        if (this->_adaptive) {
+            double moments[2];
+            int32_t target;
+            uint8_t done;
+            memcpy(moments, src + 28, 16);
+            memcpy(&target, src + 44, 4);
+            memcpy(&done, src + 48, 1);
+            state.mean = moments[0];
+            state.m2 = moments[1];
+            state.target = target;
+            state.done = done != 0;
+        }
+    }
+
+//    先写临时文件再改名，写到一半被杀掉也不会破坏上一个检查点
+    void saveCheckpoint(int stage, const std::vector<PixelState> &states) const {
+        std::string temp = this->_checkpointPath + ".tmp";
+        std::ofstream fout(temp, std::ios::binary);
+        int32_t settings[7];
+        this->checkpointSettings(settings);
+        int32_t savedStage = stage;
+        fout.write("RTCK", 4);
+        fout.write(reinterpret_cast<const char *>(settings), sizeof(settings));
+        fout.write(reinterpret_cast<const char *>(&this->_relativeError), sizeof(double));
+        fout.write(reinterpret_cast<const char *>(&savedStage), sizeof(int32_t));
+        int recordBytes = this->checkpointRecordBytes();
+        std::vector<char> chunk(size_t(CheckpointChunkPixels) * recordBytes);
+        for (size_t begin = 0; begin < states.size(); begin += CheckpointChunkPixels) {
+            size_t end = std::min(states.size(), begin + CheckpointChunkPixels);
+            for (size_t k = begin; k < end; k++) {
+                this->packPixel(states[k], &chunk[(k - begin) * recordBytes]);
+            }
+            fout.write(chunk.data(), (end - begin) * recordBytes);
+        }
+        fout.close();
+        if (!fout || std::rename(temp.c_str(), this->_checkpointPath.c_str()) != 0) {
+            throw std::runtime_error("can not write checkpoint " + this->_checkpointPath);
+        }
+    }
+
+//    检查点不存在或者参数对不上时返回 false，头里的字段逐个比较
+    bool loadCheckpoint(int &stage, std::vector<PixelState> &states) const {
+        std::ifstream fin(this->_checkpointPath, std::ios::binary);
+        if (!fin) {
+            return false;
+        }
+        char magic[4];
+        int32_t settings[7], expected[7];
+        double relativeError;
+        int32_t savedStage;
+        fin.read(magic, 4);
+        fin.read(reinterpret_cast<char *>(settings), sizeof(settings));
+        fin.read(reinterpret_cast<char *>(&relativeError), sizeof(double));
+        fin.read(reinterpret_cast<char *>(&savedStage), sizeof(int32_t));
+        this->checkpointSettings(expected);
+        bool matched = fin && memcmp(magic, "RTCK", 4) == 0 && relativeError == this->_relativeError &&
+                       savedStage >= 0 && savedStage <= (this->_adaptive ? 1 : 0);
+        for (int k = 0; k < 7 && matched; k++) {
+            matched = settings[k] == expected[k];
+        }
+        if (!matched) {
+            std::cout << "ignore mismatched checkpoint " << this->_checkpointPath << "\n";
+            return false;
+        }
+        std::vector<PixelState> loaded(states);
+        int recordBytes = this->checkpointRecordBytes();
+        std::vector<char> chunk(size_t(CheckpointChunkPixels) * recordBytes);
+        for (size_t begin = 0; begin < loaded.size() && fin; begin += CheckpointChunkPixels) {
+            size_t end = std::min(loaded.size(), begin + CheckpointChunkPixels);
+            fin.read(chunk.data(), (end - begin) * recordBytes);
+            for (size_t k = begin; k < end && fin; k++) {
+                this->unpackPixel(&chunk[(k - begin) * recordBytes], loaded[k]);
+            }
+        }
+        if (!fin) {
+            std::cout << "ignore truncated checkpoint " << this->_checkpointPath << "\n";
+            return false;
+        }
+        stage = savedStage;
+        states = std::move(loaded);
+        return true;
+    }
+
+    std::vector<Tile> tiles() const {
+        std::vector<Tile> tiles;
+        for (int y = 0; y < this->_ny; y += this->_tileSize) {
+            for (int x = 0; x < this->_nx; x += this->_tileSize) {
+                tiles.push_back(Tile{x, y,
+                                     std::min(x + this->_tileSize, this->_nx),
+                                     std::min(y + this->_tileSize, this->_ny)});
+            }
+        }
+        return tiles;
+    }
+
+public:
+    Renderer(int nx, int ny, int ns, Camera *camera, Hitable *world, Hitable *light,
+             int threadCount = 0, int tileSize = 16) :
+            _nx(nx), _ny(ny), _ns(ns), _tileSize(tileSize),
+            _camera(camera), _world(world), _light(light), _pool(threadCount) {
+        this->_integrator = [world, light](const Ray &ray) {
+            return PathColor(ray, world, light);
+        };
+    }
+
+//    替换每个样本调用的积分器，例如 [&](const Ray &ray) { return Color(ray, world, light, 0); }
+//    打开了光线包时不能再换积分器
+    void setIntegrator(const std::function<Vector3(const Ray &)> &integrator) {
+        if (this->_packetSize != 0) {
+            throw std::runtime_error("custom integrator can not be used with ray packets");
+        }
+        this->_integrator = integrator;
+        this->_customIntegrator = true;
+    }
+
+    /**
+     * 相机光线按包求交（4、8 或 16 条），0 表示关闭
+     * 包求交之后固定用 PathColor 继续追踪，已经用 setIntegrator 换了积分器时不能打开
+     */
+    void setPacketSize(int packetSize) {
+        if (packetSize != 0 && packetSize != 4 && packetSize != 8 && packetSize != 16) {
+            throw std::runtime_error("packet size must be 0, 4, 8 or 16");
+        }
+        if (packetSize != 0 && this->_customIntegrator) {
+            throw std::runtime_error("ray packets can not be used with a custom integrator");
+        }
+        this->_packetSize = packetSize;
+    }
+
+//    把每个样本里的 NaN 换成 0 再累加，默认关闭，NaN 会照原样出现在图像里
+    void setDeNan(bool enabled) {
+        this->_deNan = enabled;
+    }
+
+    int threadCount() const {
+        return this->_pool.size();
+    }
+
+    /**
+     * 打开自适应采样，此时 ns 是平均每个像素的样本预算
+     * @param minSamples    每个像素至少的样本数，也是检查收敛的间隔
+     * @param maxSamples    噪声大的像素最多能用到的样本数
+     * @param relativeError 收敛阈值：95% 置信区间半宽 / 均值
+     */
+    void setAdaptive(int minSamples, int maxSamples, double relativeError) {
+        this->_adaptive = true;
+        this->_minSamples = std::max(2, minSamples);
+        this->_maxSamples = std::max(this->_ns, maxSamples);
+        this->_relativeError = relativeError;
+    }
+
+    /**
+     * 打开渐进渲染和检查点
+     * @param passSamples       每一遍每个像素采多少样本
+     * @param checkpointPath    检查点文件，存在时从它继续渲染，渲染完成后删除
+     * @param checkpointSeconds 至少隔多少秒存一次检查点
+     */
+    void setProgressive(int passSamples, const std::string &checkpointPath, int checkpointSeconds = 60) {
+        this->_passSamples = std::max(1, passSamples);
+        this->_checkpointPath = checkpointPath;
+        this->_checkpointSeconds = checkpointSeconds;
+    }
+
+//    每个像素实际用了多少样本（按 ppm 顺序）
+    const std::vector<int> &sampleCounts() const {
+        return this->_sampleCounts;
+    }
+
+    void setCamera(Camera *camera) {
+        this->_camera = camera;
+    }
+
+    /**
+     * 在一个进程里渲染一段动画，线程池和场景在帧之间复用
+     * @param update     渲染第 frame 帧之前调用，负责移动物体、更新加速结构（如 DynamicBVH::update），返回这一帧的相机
+     * @param pathFormat 每帧输出文件名的 printf 格式，如 "frame_%03d.ppm"
+     * 打开了检查点时每帧用自己的检查点文件（输出文件名加 ".checkpoint"），中断后重新运行，
+     * 前面的帧不会读到后面某一帧的检查点，中断的那一帧从它自己的检查点继续
+     */
+    void renderAnimation(int frameCount, const std::function<Camera *(int frame)> &update,
+                         const std::string &pathFormat, ImageFormat format = ImageFormat::PPM) {
+        std::string checkpointPath = this->_checkpointPath;
+        for (int frame = 0; frame < frameCount; frame++) {
+            this->_camera = update(frame);
+            char path[1024];
+            snprintf(path, sizeof(path), pathFormat.c_str(), frame);
+            if (!checkpointPath.empty()) {
+                this->_checkpointPath = std::string(path) + ".checkpoint";
+            }
+            ImageWriter writer(path, this->_nx, this->_ny, format);
+            this->render(&writer);
+            writer.close();
+        }
+        this->_checkpointPath = checkpointPath;
+    }
+
+//    样本数分布图，按最大样本数归一化到 [0, 1]，可以直接交给 ImageWriter
+    std::vector<Vector3> sampleMap() const {
+        int maxCount = 1;
+        for (int count:this->_sampleCounts) {
+            maxCount = std::max(maxCount, count);
+        }
+        std::vector<Vector3> map;
+        map.reserve(this->_sampleCounts.size());
+        for (int count:this->_sampleCounts) {
+            double c = double(count) / maxCount;
+            map.emplace_back(c, c, c);
+        }
+        return map;
+    }
+
+//    平均每个像素的样本数
+    double averageSamples() const {
+        double sum = 0;
+        for (int count:this->_sampleCounts) {
+            sum += count;
+        }
+        return this->_sampleCounts.empty() ? 0 : sum / this->_sampleCounts.size();
+    }
+
+//    返回按 ppm 顺序（从上到下、从左到右）排列的线性颜色，writer 不为空时每完成一块就交给它写出
+    std::vector<Vector3> render(ImageWriter *writer = nullptr) {
+        std::vector<Vector3> framebuffer(this->_nx * this->_ny, Vector3{0, 0, 0});
+        std::vector<PixelState> states(this->_nx * this->_ny);
+        std::vector<Tile> tiles = this->tiles();
+        int passSamples = this->_passSamples > 0 ? this->_passSamples : this->_ns;
+//        阶段 0：每个像素最多 ns 个样本；阶段 1：自适应时分配省下来的预算
+        int lastStage = this->_adaptive ? 1 : 0;
+        int stage = 0;
+        for (PixelState &state:states) {
+            state.target = this->_ns;
+        }
+
+        Progress progress(uint64_t(this->_nx) * this->_ny * this->_ns);
+        if (!this->_checkpointPath.empty() && this->loadCheckpoint(stage, states)) {
+            uint64_t restored = 0;
+            for (const PixelState &state:states) {
+                restored += state.n;
+            }
+            progress.restore(restored);
+            std::cout << "resume from " << this->_checkpointPath << "\n";
+        }
+        auto lastCheckpoint = std::chrono::steady_clock::now();
+
+        std::vector<char> tileFinished(tiles.size(), 0);
+        auto finishTile = [&](int index) {
+            const Tile &tile = tiles[index];
+            if (tileFinished[index]) {
+                return;
+            }
+            tileFinished[index] = 1;
+            for (int y = tile.y0; y < tile.y1; y++) {
+                for (int i = tile.x0; i < tile.x1; i++) {
+                    const PixelState &state = states[y * this->_nx + i];
+                    framebuffer[y * this->_nx + i] = state.sum / double(state.n);
+                }
+            }
+            if (writer) {
+                writer->submit(tile.x0, tile.y0, tile.x1, tile.y1,
+                               &framebuffer[tile.y0 * this->_nx + tile.x0], this->_nx);
+            }
+        };
+        auto unfinished = [&]() {
+            for (const PixelState &state:states) {
+                if (!state.done && state.n < state.target) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        while (true) {
+            while (unfinished()) {
+                this->_pool.parallelFor(int(tiles.size()), [&](int index) {
+                    const Tile &tile = tiles[index];
+                    bool tileDone = true;
+                    for (int y = tile.y0; y < tile.y1; y++) {
+//                        ppm 第一行是图像最上面一行
+                        int j = this->_ny - 1 - y;
+                        for (int i = tile.x0; i < tile.x1; i++) {
+                            PixelState &state = states[y * this->_nx + i];
+                            if (state.done || state.n >= state.target) {
+                                continue;
+                            }
+                            int before = state.n;
+                            uint64_t rays = ThreadRayCount;
+                            this->samplePixel(i, j, state, std::min(passSamples, state.target - state.n));
+                            progress.add(state.n - before, ThreadRayCount - rays);
+                            tileDone = tileDone && (state.done || state.n >= state.target);
+                        }
+                    }
+                    if (stage == lastStage && tileDone) {
+                        finishTile(index);
+                    }
+                });
+                if (!this->_checkpointPath.empty() &&
+                    std::chrono::steady_clock::now() - lastCheckpoint >=
+                    std::chrono::seconds(this->_checkpointSeconds)) {
+                    this->saveCheckpoint(stage, states);
+                    lastCheckpoint = std::chrono::steady_clock::now();
+                }
+            }
+            if (stage == lastStage) {
+                break;
+            }
+//            第二阶段：省下来的预算按相对误差比例分给没收敛的像素，分配只依赖第一阶段的结果，保证可复现
+            int64_t saved = 0;
+            double errorSum = 0;
+            std::vector<double> errors(states.size(), 0);
+            for (size_t k = 0; k < states.size(); k++) {
+                saved += this->_ns - states[k].n;
+                if (!states[k].done && states[k].n < this->_maxSamples) {
+                    errors[k] = std::min(this->relativeError(states[k]), 1e3);
+                    errorSum += errors[k];
+                }
+            }
+            for (size_t k = 0; k < states.size(); k++) {
+                int extra = errorSum > 0 ? int(saved * errors[k] / errorSum) : 0;
+                states[k].target = states[k].n + std::min(this->_maxSamples - states[k].n, extra);
+                states[k].done = false;
+            }
+            stage++;
+        }
+        for (int index = 0; index < int(tiles.size()); index++) {
+            finishTile(index);
+        }
+        progress.finish();
+        if (!this->_checkpointPath.empty()) {
+            std::remove(this->_checkpointPath.c_str());
+        }
+
+        this->_sampleCounts.resize(states.size());
+        for (size_t k = 0; k < states.size(); k++) {
+            this->_sampleCounts[k] = states[k].n;
+        }
+        return framebuffer;
+    }
+};
+
+#endif //RENDER_HPP
@@ -0,0 +1,131 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <ostream>
+#include <type_traits>
+#include "arena.hpp"
+#include "camera.hpp"
+#include "texture.hpp"
+#include "material.hpp"
+#include "bvh.hpp"
+#include "linear_bvh.hpp"
+#include "light_sampler.hpp"
+
+/**
+ * 拥有整个场景的对象：纹理、材质、几何体和加速结构分别放在各自的 arena 里，同一类对象在内存中紧挨着
+ * 渲染服务切换场景时析构 Scene 即可，所有对象一次释放
+ * 场景里的对象互相用裸指针引用，Scene 释放之后这些指针都失效
+ */
+class Scene {
+private:
+    Arena _textures;
+    Arena _materials;
+    Arena _primitives;
+    Arena _acceleration;    // BVHNode 的节点和叶子列表、LinearBVH、LightSampler
+    Hitable *_world = nullptr;
+    Hitable *_light = nullptr;
+    Camera *_camera = nullptr;
+
+    template<typename T>
+    Arena &arenaFor() {
+        if (std::is_base_of<Texture, T>::value) {
+            return this->_textures;
+        }
+        if (std::is_base_of<Material, T>::value) {
+            return this->_materials;
+        }
+        if (std::is_base_of<BVHNode, T>::value || std::is_base_of<LinearBVH, T>::value ||
+            std::is_base_of<LightSampler, T>::value) {
+            return this->_acceleration;
+        }
+        return this->_primitives;
+    }
+
+public:
+//    hugePages 为 true 时每块按 2MB 对齐分配并请求大页，几何体多的场景可以减少 TLB 缺失
+    explicit Scene(bool hugePages = false) :
+            _textures(64 << 10, hugePages), _materials(64 << 10, hugePages),
+            _primitives(1 << 20, hugePages), _acceleration(1 << 20, hugePages) {}
+
+    Scene(const Scene &) = delete;
+
+    Scene &operator=(const Scene &) = delete;
+
+    ~Scene() {
+        this->release();
+    }
+
+//    按类型放进对应的 arena
+    template<typename T, typename... Args>
+    T *create(Args &&... args) {
+        return this->arenaFor<T>().template create<T>(std::forward<Args>(args)...);
+    }
+
+//    Cube 之类自己还要创建子物体的 Hitable 通过它把子物体也放进场景
+    Arena *primitiveArena() {
+        return &this->_primitives;
+    }
+
+//    BVHNode 建树时内部节点和叶子列表也放进场景
+    BVHBuildOptions bvhOptions(BVHBuildOptions options = BVHBuildOptions()) {
+        options.arena = &this->_acceleration;
+        return options;
+    }
+
+    void set(Hitable *world, Hitable *light, Camera *camera) {
+        this->_world = world;
+        this->_light = light;
+        this->_camera = camera;
+    }
+
+//    从 world 中找出所有发光的物体，建多光源采样器代替原来的 light，返回新的 light
+    LightSampler *extractLights(double time0 = 0, double time1 = 1) {
+        LightSampler *sampler = this->create<LightSampler>(static_cast<const Hitable *>(this->_world), time0, time1);
+        this->_light = sampler;
+        return sampler;
+    }
+
+    Hitable *world() const {
+        return this->_world;
+    }
+
+//    重要性采样的对象（光源，或者光源和玻璃球）
+    Hitable *light() const {
+        return this->_light;
+    }
+
+    Camera *camera() const {
+        return this->_camera;
+    }
+
+//    先释放引用别的对象的一方：加速结构、几何体、材质，最后是纹理
+    void release() {
+        this->_acceleration.release();
+        this->_primitives.release();
+        this->_materials.release();
+        this->_textures.release();
+        this->set(nullptr, nullptr, nullptr);
+    }
+
+    size_t objectCount() const {
+        return this->_textures.objectCount() + this->_materials.objectCount() +
+               this->_primitives.objectCount() + this->_acceleration.objectCount();
+    }
+
+    size_t memoryBytes() const {
+        return this->_textures.reservedBytes() + this->_materials.reservedBytes() +
+               this->_primitives.reservedBytes() + this->_acceleration.reservedBytes();
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const Scene &scene) {
+        os << "textures: " << scene._textures.objectCount() << " (" << scene._textures.usedBytes() << " bytes)"
+           << " materials: " << scene._materials.objectCount() << " (" << scene._materials.usedBytes() << " bytes)"
+           << " primitives: " << scene._primitives.objectCount() << " (" << scene._primitives.usedBytes() << " bytes)"
+           << " acceleration: " << scene._acceleration.objectCount()
+           << " (" << scene._acceleration.usedBytes() << " bytes)"
+           << " reserved: " << scene.memoryBytes() / 1024 << " KB";
+        return os;
+    }
+};
+
+#endif //SCENE_HPP
@@ -0,0 +1,735 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "hitable.hpp"
+#include "material.hpp"
+#include "rect.hpp"
+#include "cube.hpp"
+#include "translate.hpp"
+#include "bvh.hpp"
+#include "linear_bvh.hpp"
+#include "instance.hpp"
+
+/**
+ * 场景快照：建好的场景（几何体、材质、纹理、扁平化的 BVH）存成一个不含指针的二进制文件，
+ * 下次运行直接 mmap 进来就能渲染，不用再建树；多个渲染进程通过页缓存共享同一份数据。
+ * 文件里所有引用都是数组下标，按本机字节序存放，只保证同一平台上读写
+ */
+enum class SnapshotTextureType : uint32_t {
+    Constant = 0
+};
+
+enum class SnapshotMaterialType : uint32_t {
+    Lambertian = 0,
+    Metal,
+    Dielectric,
+    DiffuseLight
+};
+
+enum class SnapshotPrimitiveType : uint32_t {
+    Sphere = 0,
+    MovingSphere,
+    XYRect,
+    XZRect,
+    YZRect,
+    Instance
+};
+
+struct SnapshotTexture {
+    uint32_t type;
+    uint32_t pad;
+    double color[3];
+};
+
+struct SnapshotMaterial {
+    uint32_t type;
+    uint32_t texture;       // Lambertian 的反射率、DiffuseLight 的发光纹理
+    double albedo[3];       // Metal 的反射率
+    double parameter;       // Metal 的模糊度、Dielectric 的折射率
+};
+
+/**
+ * 定长的物体记录，data 按类型解释：
+ * Sphere: 球心, 半径
+ * MovingSphere: 两个球心, 两个时刻, 半径
+ * XYRect / XZRect / YZRect: 两个轴的范围 a0, a1, b0, b1, 平面位置 k
+ * Instance: 不用 data，引用 bvh 和 transform
+ */
+struct SnapshotPrimitive {
+    uint32_t type;
+    uint32_t material;
+    uint32_t bvh;
+    uint32_t transform;
+    uint32_t normal;        // 矩形的 RectNormal
+    uint32_t pad;
+    double data[10];
+};
+
+//一棵 BVH 在节点数组和物体数组中的范围，节点里的下标都是整个文件范围内的绝对下标
+struct SnapshotBVH {
+    uint32_t nodeOffset, nodeCount;
+    uint32_t primitiveOffset, primitiveCount;
+    double min[3], max[3];
+};
+
+struct SnapshotTransform {
+    double transform[12];   // Matrix34 按列存放
+    double inverse[12];
+};
+
+//文件里的数据总是 double，float 构建读写时再转换，两种构建可以共用同一份快照
+typedef Eigen::Matrix<double, 3, 4> SnapshotMatrix;
+
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t root;          // 场景对应的 BVH
+    uint32_t lightIsList;   // 光源是不是 HitableList
+    uint32_t pad;
+    double time0, time1;
+    uint64_t size;          // 整个文件的字节数
+    SnapshotSection sections[7];
+};
+
+class SceneSnapshot;
+
+//快照里某一棵 BVH 的 Hitable 外壳，实例和场景根节点都通过它求交
+class SnapshotBVHView : public Hitable {
+private:
+    const SceneSnapshot *_snapshot;
+    uint32_t _index;
+public:
+    SnapshotBVHView(const SceneSnapshot *snapshot, uint32_t index) : _snapshot(snapshot), _index(index) {}
+
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const;
+
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const;
+};
+
+class SnapshotWriter {
+private:
+    static const uint32_t NoIndex = 0xffffffffu;
+
+    double _time0, _time1;
+    std::vector<SnapshotTexture> _textures;
+    std::vector<SnapshotMaterial> _materials;
+    std::vector<SnapshotPrimitive> _primitives;
+    std::vector<LinearBVHNode> _nodes;
+    std::vector<SnapshotBVH> _bvhs;
+    std::vector<SnapshotTransform> _transforms;
+    std::vector<uint32_t> _lights;
+    std::unordered_map<const Texture *, uint32_t> _textureIndex;
+    std::unordered_map<const Material *, uint32_t> _materialIndex;
+    std::unordered_map<const Hitable *, uint32_t> _bvhIndex;
+
+    uint32_t addTexture(const Texture *texture) {
+        auto found = this->_textureIndex.find(texture);
+        if (found != this->_textureIndex.end()) {
+            return found->second;
+        }
+        if (texture->type() != TextureType::Constant) {
+            throw std::runtime_error("unsupported texture in scene snapshot");
+        }
+        const ConstantTexture *constant = static_cast<const ConstantTexture *>(texture);
+        SnapshotTexture record;
+        memset(&record, 0, sizeof(record));
+        record.type = uint32_t(SnapshotTextureType::Constant);
+        for (int a = 0; a < 3; a++) {
+            record.color[a] = constant->color()[a];
+        }
+        this->_textures.push_back(record);
+        return this->_textureIndex[texture] = uint32_t(this->_textures.size() - 1);
+    }
+
+    uint32_t addMaterial(const Material *material) {
+        if (!material) {
+            return NoIndex;
+        }
+        auto found = this->_materialIndex.find(material);
+        if (found != this->_materialIndex.end()) {
+            return found->second;
+        }
+        SnapshotMaterial record;
+        memset(&record, 0, sizeof(record));
+        record.texture = NoIndex;
+        switch (material->type()) {
+            case MaterialType::Lambertian:
+                record.type = uint32_t(SnapshotMaterialType::Lambertian);
+                record.texture = this->addTexture(static_cast<const Lambertian *>(material)->albedo());
+                break;
+            case MaterialType::Metal: {
+                const Metal *metal = static_cast<const Metal *>(material);
+                record.type = uint32_t(SnapshotMaterialType::Metal);
+                for (int a = 0; a < 3; a++) {
+                    record.albedo[a] = metal->albedo()[a];
+                }
+                record.parameter = metal->fuzz();
+                break;
+            }
+            case MaterialType::Dielectric:
+                record.type = uint32_t(SnapshotMaterialType::Dielectric);
+                record.parameter = static_cast<const Dielectric *>(material)->refIdx();
+                break;
+            case MaterialType::DiffuseLight:
+                record.type = uint32_t(SnapshotMaterialType::DiffuseLight);
+                record.texture = this->addTexture(static_cast<const DiffuseLight *>(material)->emit());
+                break;
+            default:
+                throw std::runtime_error("unsupported material in scene snapshot");
+        }
+        this->_materials.push_back(record);
+        return this->_materialIndex[material] = uint32_t(this->_materials.size() - 1);
+    }
+
+    uint32_t addTransform(const Matrix34 &transform) {
+        SnapshotTransform record;
+        Eigen::Map<SnapshotMatrix>(record.transform) = transform.cast<double>();
+        Eigen::Map<SnapshotMatrix>(record.inverse) = InverseTransform(transform).cast<double>();
+        this->_transforms.push_back(record);
+        return uint32_t(this->_transforms.size() - 1);
+    }
+
+//    展开各种容器，得到一棵 BVH 的全部叶子物体
+    static void Gather(const Hitable *hitable, std::vector<Hitable *> &list) {
+        if (const BVHNode *bvh = dynamic_cast<const BVHNode *>(hitable)) {
+            Gather(bvh->left(), list);
+            if (bvh->right() != bvh->left()) {
+                Gather(bvh->right(), list);
+            }
+        } else if (const LinearBVH *linear = dynamic_cast<const LinearBVH *>(hitable)) {
+            for (Hitable *primitive : linear->primitives()) {
+                Gather(primitive, list);
+            }
+        } else if (const HitableList *hitableList = dynamic_cast<const HitableList *>(hitable)) {
+            for (Hitable *item : hitableList->list()) {
+                Gather(item, list);
+            }
+        } else if (const Cube *cube = dynamic_cast<const Cube *>(hitable)) {
+            Gather(cube->sides(), list);
+        } else {
+            list.push_back(const_cast<Hitable *>(hitable));
+        }
+    }
+
+    template<class Rect>
+    static void SetRect(SnapshotPrimitive &record, SnapshotPrimitiveType type, const Rect &rect,
+                        double a0, double a1, double b0, double b1) {
+        record.type = uint32_t(type);
+        record.normal = uint32_t(rect._fixedNormal);
+        double data[5] = {a0, a1, b0, b1, rect._k};
+        std::copy(data, data + 5, record.data);
+    }
+
+    SnapshotPrimitive addPrimitive(const Hitable *hitable) {
+        SnapshotPrimitive record;
+        memset(&record, 0, sizeof(record));
+        record.material = NoIndex;
+        record.bvh = NoIndex;
+        record.transform = NoIndex;
+        if (const Sphere *sphere = dynamic_cast<const Sphere *>(hitable)) {
+            record.type = uint32_t(SnapshotPrimitiveType::Sphere);
+            record.material = this->addMaterial(sphere->material());
+            double data[4] = {sphere->center().x(), sphere->center().y(), sphere->center().z(), sphere->radius()};
+            std::copy(data, data + 4, record.data);
+        } else if (const MovingSphere *moving = dynamic_cast<const MovingSphere *>(hitable)) {
+            record.type = uint32_t(SnapshotPrimitiveType::MovingSphere);
+            record.material = this->addMaterial(moving->material());
+            double data[9] = {moving->center0().x(), moving->center0().y(), moving->center0().z(),
+                              moving->center1().x(), moving->center1().y(), moving->center1().z(),
+                              moving->time0(), moving->time1(), moving->radius()};
+            std::copy(data, data + 9, record.data);
+        } else if (const XYRect *xy = dynamic_cast<const XYRect *>(hitable)) {
+            SetRect(record, SnapshotPrimitiveType::XYRect, *xy, xy->_x0, xy->_x1, xy->_y0, xy->_y1);
+            record.material = this->addMaterial(xy->_material);
+        } else if (const XZRect *xz = dynamic_cast<const XZRect *>(hitable)) {
+            SetRect(record, SnapshotPrimitiveType::XZRect, *xz, xz->_x0, xz->_x1, xz->_z0, xz->_z1);
+            record.material = this->addMaterial(xz->_material);
+        } else if (const YZRect *yz = dynamic_cast<const YZRect *>(hitable)) {
+            SetRect(record, SnapshotPrimitiveType::YZRect, *yz, yz->_y0, yz->_y1, yz->_z0, yz->_z1);
+            record.material = this->addMaterial(yz->_material);
+        } else {
+//            Translate / RotateY / Instance 的嵌套合成一个变换，里面的东西单独建一棵 BVH（同一个对象只建一次）
+            Matrix34 transform = IdentityTransform();
+            const Hitable *inner = hitable;
+            while (true) {
+                if (const Translate *translate = dynamic_cast<const Translate *>(inner)) {
+                    transform = ComposeTransform(transform, TranslateTransform(translate->offset()));
+                    inner = translate->hitable();
+                } else if (const RotateY *rotate = dynamic_cast<const RotateY *>(inner)) {
+                    Matrix34 rotation = IdentityTransform();
+                    rotation(0, 0) = rotate->cosTheta();
+                    rotation(0, 2) = rotate->sinTheta();
+                    rotation(2, 0) = -rotate->sinTheta();
+                    rotation(2, 2) = rotate->cosTheta();
+                    transform = ComposeTransform(transform, rotation);
+                    inner = rotate->hitable();
+                } else if (const Instance *instance = dynamic_cast<const Instance *>(inner)) {
+                    transform = ComposeTransform(transform, instance->transform());
+                    inner = instance->blas();
+                } else {
+                    break;
+                }
+            }
+            if (inner == hitable) {
+                throw std::runtime_error("unsupported hitable in scene snapshot");
+            }
+            record.type = uint32_t(SnapshotPrimitiveType::Instance);
+            record.bvh = this->addBVH(inner);
+            record.transform = this->addTransform(transform);
+        }
+        return record;
+    }
+
+    uint32_t addBVH(const Hitable *hitable) {
+        auto found = this->_bvhIndex.find(hitable);
+        if (found != this->_bvhIndex.end()) {
+            return found->second;
+        }
+        std::vector<Hitable *> list;
+        Gather(hitable, list);
+        if (list.empty()) {
+            throw std::runtime_error("empty hitable in scene snapshot");
+        }
+        LinearBVH bvh(list, this->_time0, this->_time1);
+//        先转换叶子物体，实例引用的 BVH 会在这里整棵写完，不会和本 BVH 的物体交错
+        std::vector<SnapshotPrimitive> primitives;
+        primitives.reserve(bvh.primitives().size());
+        for (Hitable *primitive : bvh.primitives()) {
+            primitives.push_back(this->addPrimitive(primitive));
+        }
+        SnapshotBVH record;
+        record.nodeOffset = uint32_t(this->_nodes.size());
+        record.nodeCount = uint32_t(bvh.nodes().size());
+        record.primitiveOffset = uint32_t(this->_primitives.size());
+        record.primitiveCount = uint32_t(primitives.size());
+        AABB box;
+        bvh.boundingBox(this->_time0, this->_time1, box);
+        for (int a = 0; a < 3; a++) {
+            record.min[a] = box.min()[a];
+            record.max[a] = box.max()[a];
+        }
+        for (LinearBVHNode node : bvh.nodes()) {
+            node.offset += node.leaf() ? record.primitiveOffset : record.nodeOffset;
+            this->_nodes.push_back(node);
+        }
+        this->_primitives.insert(this->_primitives.end(), primitives.begin(), primitives.end());
+        this->_bvhs.push_back(record);
+        return this->_bvhIndex[hitable] = uint32_t(this->_bvhs.size() - 1);
+    }
+
+    template<class T>
+    static void Append(std::vector<char> &blob, SnapshotSection &section, const std::vector<T> &items) {
+        blob.resize((blob.size() + 15) / 16 * 16, 0);
+        section.offset = blob.size();
+        section.count = items.size();
+        const char *begin = reinterpret_cast<const char *>(items.data());
+        blob.insert(blob.end(), begin, begin + items.size() * sizeof(T));
+    }
+
+public:
+    SnapshotWriter(double time0, double time1) : _time0(time0), _time1(time1) {}
+
+    /**
+     *
+     * @param world 场景，容器（BVHNode、LinearBVH、HitableList、Cube）会被展开后重新建一棵 SAH 树
+     * @param light 用来做重要性采样的物体，可以是 HitableList
+     */
+    void write(const std::string &path, const Hitable *world, const Hitable *light) {
+        SnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "RLSNAP\0\0", 8);
+        header.version = 1;
+        header.time0 = this->_time0;
+        header.time1 = this->_time1;
+        header.root = this->addBVH(world);
+//        光源单独存成不属于任何 BVH 的物体
+        std::vector<Hitable *> lights;
+        const HitableList *lightList = dynamic_cast<const HitableList *>(light);
+        header.lightIsList = lightList != nullptr;
+        if (lightList) {
+            lights = lightList->list();
+        } else if (light) {
+            lights.push_back(const_cast<Hitable *>(light));
+        }
+        for (Hitable *item : lights) {
+            SnapshotPrimitive record = this->addPrimitive(item);
+            this->_primitives.push_back(record);
+            this->_lights.push_back(uint32_t(this->_primitives.size() - 1));
+        }
+
+        std::vector<char> blob(sizeof(SnapshotHeader), 0);
+        Append(blob, header.sections[0], this->_textures);
+        Append(blob, header.sections[1], this->_materials);
+        Append(blob, header.sections[2], this->_primitives);
+        Append(blob, header.sections[3], this->_nodes);
+        Append(blob, header.sections[4], this->_bvhs);
+        Append(blob, header.sections[5], this->_transforms);
+        Append(blob, header.sections[6], this->_lights);
+        header.size = blob.size();
+        memcpy(blob.data(), &header, sizeof(header));
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file.write(blob.data(), std::streamsize(blob.size()))) {
+            throw std::runtime_error("failed to write scene snapshot " + path);
+        }
+    }
+};
+
+/**
+ * mmap 进来的场景快照
+ * 几何体和 BVH 直接在映射的内存上求交；材质、纹理和光源只有几个，打开时还原成普通对象
+ */
+class SceneSnapshot {
+private:
+    static const int StackSize = 64;
+    static const uint32_t NoIndex = 0xffffffffu;
+
+    const char *_data = nullptr;
+    size_t _size = 0;
+    const SnapshotHeader *_header = nullptr;
+    const SnapshotPrimitive *_primitives = nullptr;
+    const LinearBVHNode *_nodes = nullptr;
+    const SnapshotBVH *_bvhs = nullptr;
+    const SnapshotTransform *_transforms = nullptr;
+    std::vector<Texture *> _textures;
+    std::vector<Material *> _materials;
+    Hitable *_world = nullptr;
+    Hitable *_light = nullptr;
+
+    template<class T>
+    const T *section(int index, uint64_t &count) const {
+        const SnapshotSection &section = this->_header->sections[index];
+        if (section.offset % 8 != 0 || section.offset > this->_size ||
+            section.count > (this->_size - section.offset) / sizeof(T)) {
+            throw std::runtime_error("corrupt scene snapshot section");
+        }
+        count = section.count;
+        return reinterpret_cast<const T *>(this->_data + section.offset);
+    }
+
+    Material *material(uint32_t index) const {
+        return index == NoIndex ? nullptr : this->_materials[index];
+    }
+
+    static Vector3 Vector(const double *v) {
+        return Eigen::Map<const Eigen::Matrix<double, 3, 1>>(v).cast<Float>();
+    }
+
+    /**
+     * 物体的类型、材质和变换下标都要在范围内
+     * @param bvhLimit 实例引用的 BVH 下标必须小于它：写文件时被引用的 BVH 总是先写，这样不会出现循环引用
+     */
+    void validatePrimitive(const SnapshotPrimitive &record, uint32_t bvhLimit, uint64_t materialCount,
+                           uint64_t transformCount) const {
+        bool valid;
+        switch (SnapshotPrimitiveType(record.type)) {
+            case SnapshotPrimitiveType::Sphere:
+            case SnapshotPrimitiveType::MovingSphere:
+                valid = record.material == NoIndex || record.material < materialCount;
+                break;
+            case SnapshotPrimitiveType::XYRect:
+            case SnapshotPrimitiveType::XZRect:
+            case SnapshotPrimitiveType::YZRect:
+                valid = (record.material == NoIndex || record.material < materialCount) &&
+                        record.normal <= uint32_t(RectNormal::Auto);
+                break;
+            case SnapshotPrimitiveType::Instance:
+                valid = record.bvh < bvhLimit && record.transform < transformCount;
+                break;
+            default:
+                valid = false;
+        }
+        if (!valid) {
+            throw std::runtime_error("corrupt scene snapshot primitive");
+        }
+    }
+
+    /**
+     * 检查一棵 BVH：节点范围和物体范围在数组内，内部节点的两个子节点都在本树内、下标比自己大（不会成环），
+     * 叶子的物体在本树的物体范围内，树深不超过 hitBVH 的栈大小
+     */
+    void validateBVH(uint32_t index, uint64_t nodeCount, uint64_t primitiveCount, uint64_t materialCount,
+                     uint64_t transformCount) const {
+        const SnapshotBVH &bvh = this->_bvhs[index];
+        uint64_t nodeEnd = uint64_t(bvh.nodeOffset) + bvh.nodeCount;
+        uint64_t primitiveEnd = uint64_t(bvh.primitiveOffset) + bvh.primitiveCount;
+        if (bvh.nodeCount == 0 || nodeEnd > nodeCount || primitiveEnd > primitiveCount) {
+            throw std::runtime_error("corrupt scene snapshot bvh");
+        }
+//        子节点下标总比父节点大，按下标顺序一遍就能算出每个节点的深度
+        std::vector<int> depth(bvh.nodeCount, 0);
+        for (uint32_t i = 0; i < bvh.nodeCount; i++) {
+            const LinearBVHNode &node = this->_nodes[bvh.nodeOffset + i];
+            if (node.leaf()) {
+                if (node.offset < bvh.primitiveOffset || uint64_t(node.offset) + node.count > primitiveEnd) {
+                    throw std::runtime_error("corrupt scene snapshot bvh leaf");
+                }
+                continue;
+            }
+            uint64_t right = uint64_t(node.offset) - bvh.nodeOffset;
+            if (node.offset < bvh.nodeOffset || right <= i + 1 || right >= bvh.nodeCount || node.axis > 2 ||
+                depth[i] + 1 >= StackSize) {
+                throw std::runtime_error("corrupt scene snapshot bvh node");
+            }
+            depth[i + 1] = std::max(depth[i + 1], depth[i] + 1);
+            depth[right] = std::max(depth[right], depth[i] + 1);
+        }
+        for (uint64_t k = bvh.primitiveOffset; k < primitiveEnd; k++) {
+            this->validatePrimitive(this->_primitives[k], index, materialCount, transformCount);
+        }
+    }
+
+    void load() {
+        if (this->_size < sizeof(SnapshotHeader)) {
+            throw std::runtime_error("scene snapshot too small");
+        }
+        this->_header = reinterpret_cast<const SnapshotHeader *>(this->_data);
+        if (memcmp(this->_header->magic, "RLSNAP\0\0", 8) != 0 || this->_header->version != 1 ||
+            this->_header->size != this->_size) {
+            throw std::runtime_error("not a scene snapshot or version mismatch");
+        }
+        uint64_t textureCount, materialCount, primitiveCount, nodeCount, bvhCount, transformCount, lightCount;
+        const SnapshotTexture *textures = this->section<SnapshotTexture>(0, textureCount);
+        const SnapshotMaterial *materials = this->section<SnapshotMaterial>(1, materialCount);
+        this->_primitives = this->section<SnapshotPrimitive>(2, primitiveCount);
+        this->_nodes = this->section<LinearBVHNode>(3, nodeCount);
+        this->_bvhs = this->section<SnapshotBVH>(4, bvhCount);
+        this->_transforms = this->section<SnapshotTransform>(5, transformCount);
+        const uint32_t *lights = this->section<uint32_t>(6, lightCount);
+        if (this->_header->root >= bvhCount) {
+            throw std::runtime_error("corrupt scene snapshot root");
+        }
+//        求交时不再检查下标，打开时把每棵 BVH 的节点和物体都检查一遍
+        for (uint64_t k = 0; k < bvhCount; k++) {
+            this->validateBVH(uint32_t(k), nodeCount, primitiveCount, materialCount, transformCount);
+        }
+
+        for (uint64_t k = 0; k < textureCount; k++) {
+            this->_textures.push_back(new ConstantTexture(Vector(textures[k].color)));
+        }
+        for (uint64_t k = 0; k < materialCount; k++) {
+            const SnapshotMaterial &record = materials[k];
+            bool textured = record.type == uint32_t(SnapshotMaterialType::Lambertian) ||
+                            record.type == uint32_t(SnapshotMaterialType::DiffuseLight);
+            if (textured && record.texture >= textureCount) {
+                throw std::runtime_error("corrupt scene snapshot material");
+            }
+            switch (SnapshotMaterialType(record.type)) {
+                case SnapshotMaterialType::Lambertian:
+                    this->_materials.push_back(new Lambertian(this->_textures[record.texture]));
+                    break;
+                case SnapshotMaterialType::Metal:
+                    this->_materials.push_back(new Metal(Vector(record.albedo), record.parameter));
+                    break;
+                case SnapshotMaterialType::Dielectric:
+                    this->_materials.push_back(new Dielectric(record.parameter));
+                    break;
+                case SnapshotMaterialType::DiffuseLight:
+                    this->_materials.push_back(new DiffuseLight(this->_textures[record.texture]));
+                    break;
+                default:
+                    throw std::runtime_error("unknown material in scene snapshot");
+            }
+        }
+
+        this->_world = new SnapshotBVHView(this, this->_header->root);
+        std::vector<Hitable *> lightList;
+        for (uint64_t k = 0; k < lightCount; k++) {
+            if (lights[k] >= primitiveCount) {
+                throw std::runtime_error("corrupt scene snapshot light");
+            }
+            this->validatePrimitive(this->_primitives[lights[k]], uint32_t(bvhCount), materialCount,
+                                    transformCount);
+            lightList.push_back(this->createHitable(this->_primitives[lights[k]]));
+        }
+        if (this->_header->lightIsList) {
+            this->_light = new HitableList(lightList);
+        } else if (!lightList.empty()) {
+            this->_light = lightList[0];
+        }
+    }
+
+//    光源需要 pdfValue / random，还原成普通的 Hitable
+    Hitable *createHitable(const SnapshotPrimitive &record) const {
+        const double *d = record.data;
+        Material *material = this->material(record.material);
+        switch (SnapshotPrimitiveType(record.type)) {
+            case SnapshotPrimitiveType::Sphere:
+                return new Sphere(Vector(d), d[3], material);
+            case SnapshotPrimitiveType::MovingSphere:
+                return new MovingSphere(Vector(d), Vector(d + 3), d[6], d[7], d[8], material);
+            case SnapshotPrimitiveType::XYRect:
+                return new XYRect(d[0], d[1], d[2], d[3], d[4], material, RectNormal(record.normal));
+            case SnapshotPrimitiveType::XZRect:
+                return new XZRect(d[0], d[1], d[2], d[3], d[4], material, RectNormal(record.normal));
+            case SnapshotPrimitiveType::YZRect:
+                return new YZRect(d[0], d[1], d[2], d[3], d[4], material, RectNormal(record.normal));
+            case SnapshotPrimitiveType::Instance:
+                return new Instance(new SnapshotBVHView(this, record.bvh),
+                                    Eigen::Map<const SnapshotMatrix>(this->_transforms[record.transform].transform)
+                                            .cast<Float>());
+        }
+        throw std::runtime_error("unknown primitive in scene snapshot");
+    }
+
+//    直接用文件里的记录调用各物体的静态求交函数，和原来的物体用同一份求交代码
+    bool hitPrimitive(const SnapshotPrimitive &record, const Ray &ray, Float tMin, Float tMax,
+                      HitRecord &hitRecord) const {
+        const double *d = record.data;
+        Material *material = this->material(record.material);
+        switch (SnapshotPrimitiveType(record.type)) {
+            case SnapshotPrimitiveType::Sphere:
+                return Sphere::Hit(Vector(d), d[3], material, ray, tMin, tMax, hitRecord);
+            case SnapshotPrimitiveType::MovingSphere:
+                return MovingSphere::Hit(MovingSphere::Center(Vector(d), Vector(d + 3), d[6], d[7], ray.time()),
+                                         d[8], material, ray, tMin, tMax, hitRecord);
+            case SnapshotPrimitiveType::XYRect:
+                return XYRect::Hit(d[0], d[1], d[2], d[3], d[4], material, RectNormal(record.normal),
+                                   ray, tMin, tMax, hitRecord);
+            case SnapshotPrimitiveType::XZRect:
+                return XZRect::Hit(d[0], d[1], d[2], d[3], d[4], material, RectNormal(record.normal),
+                                   ray, tMin, tMax, hitRecord);
+            case SnapshotPrimitiveType::YZRect:
+                return YZRect::Hit(d[0], d[1], d[2], d[3], d[4], material, RectNormal(record.normal),
+                                   ray, tMin, tMax, hitRecord);
+            case SnapshotPrimitiveType::Instance: {
+                const SnapshotTransform &transform = this->_transforms[record.transform];
+                return Instance::Hit(SnapshotBVHView(this, record.bvh),
+                                     Eigen::Map<const SnapshotMatrix>(transform.transform).cast<Float>(),
+                                     Eigen::Map<const SnapshotMatrix>(transform.inverse).cast<Float>(),
+                                     ray, tMin, tMax, hitRecord);
+            }
+        }
+        return false;
+    }
+
+public:
+    /**
+     * 打开并映射快照文件，文件在对象销毁前不能被改写
+     */
+    explicit SceneSnapshot(const std::string &path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("failed to open scene snapshot " + path);
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+            close(fd);
+            throw std::runtime_error("failed to stat scene snapshot " + path);
+        }
+        this->_size = size_t(info.st_size);
+        void *data = mmap(nullptr, this->_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("failed to map scene snapshot " + path);
+        }
+        this->_data = static_cast<const char *>(data);
+        try {
+            this->load();
+        } catch (...) {
+            munmap(const_cast<char *>(this->_data), this->_size);
+            throw;
+        }
+    }
+
+    SceneSnapshot(const SceneSnapshot &) = delete;
+
+    SceneSnapshot &operator=(const SceneSnapshot &) = delete;
+
+//    和仓库里其它场景一样，材质、纹理和光源对象不释放，只解除映射
+    ~SceneSnapshot() {
+        munmap(const_cast<char *>(this->_data), this->_size);
+    }
+
+    static void Save(const std::string &path, const Hitable *world, const Hitable *light,
+                     double time0 = 0, double time1 = 1) {
+        SnapshotWriter(time0, time1).write(path, world, light);
+    }
+
+    Hitable *world() const {
+        return this->_world;
+    }
+
+    Hitable *light() const {
+        return this->_light;
+    }
+
+    size_t size() const {
+        return this->_size;
+    }
+
+    const SnapshotBVH &bvh(uint32_t index) const {
+        return this->_bvhs[index];
+    }
+
+    bool hitBVH(uint32_t index, const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
+        const SnapshotBVH &bvh = this->_bvhs[index];
+        const Vector3 &origin = ray.origin();
+        const Vector3 &invDir = ray.invDirection();
+        const int *negative = ray.sign();
+//        打开时已经检查过树深不超过 StackSize
+        uint32_t stack[StackSize];
+        int top = 0;
+        uint32_t current = bvh.nodeOffset;
+        bool hit = false;
+        HitRecord temp;
+        while (true) {
+            const LinearBVHNode &node = this->_nodes[current];
+            BVH_STATS_NODE(1);
+            if (LinearBVH::HitBox(node, origin, invDir, negative, tMin, tMax)) {
+                if (node.leaf()) {
+                    BVH_STATS_PRIMITIVES(node.count);
+                    for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                        if (this->hitPrimitive(this->_primitives[i], ray, tMin, tMax, temp)) {
+                            hit = true;
+                            tMax = temp.t;
+                            record = temp;
+                        }
+                    }
+                } else if (negative[node.axis]) {
+                    stack[top++] = current + 1;
+                    current = node.offset;
+                    continue;
+                } else {
+                    stack[top++] = node.offset;
+                    current = current + 1;
+                    continue;
+                }
+            }
+            if (top == 0) {
+                break;
+            }
+            current = stack[--top];
+        }
+        return hit;
+    }
+};
+
+inline bool SnapshotBVHView::hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
+    return this->_snapshot->hitBVH(this->_index, ray, tMin, tMax, record);
+}
+
+inline bool SnapshotBVHView::boundingBox(Float time0, Float time1, AABB &box) const {
+    const SnapshotBVH &bvh = this->_snapshot->bvh(this->_index);
+    box = AABB({bvh.min[0], bvh.min[1], bvh.min[2]}, {bvh.max[0], bvh.max[1], bvh.max[2]});
+    return true;
+}
+
+#endif //SNAPSHOT_HPP
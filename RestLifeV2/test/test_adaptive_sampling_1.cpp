@@ -0,0 +1,40 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    int nx = 400;
+    int ny = 400;
+    int ns = 100;
+    nx = 1000;
+    ny = 1000;
+    ns = 200;
+    ImageWriter writer("test_adaptive_sampling_1.ppm", nx, ny, ImageFormat::PPM);
+    Hitable *world;
+    Camera *camera;
+    Hitable *sampleHitable;
+//    以光源和玻璃球采样
+    CreateCornellBoxWithSpecularSphereSampleBoth(&world, &sampleHitable, &camera, double(nx) / double(ny));
+    Renderer renderer(nx, ny, ns, camera, world, sampleHitable);
+//    平均 ns 个样本，每个像素至少 16 个，玻璃球下的焦散最多可以用到 8 * ns 个
+    renderer.setAdaptive(16, 8 * ns, 0.05);
+    renderer.render(&writer);
+    writer.close();
+    ImageWriter::Write("test_adaptive_sampling_1_spp.ppm", renderer.sampleMap(), nx, ny, ImageFormat::PPM);
+    std::cout << "average spp: " << renderer.averageSamples() << "\n";
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+}
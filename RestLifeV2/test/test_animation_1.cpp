@@ -0,0 +1,94 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+#include "../dynamic_bvh.hpp"
+#include "trace_compare.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    int nx = 200;
+    int ny = 200;
+    int ns = 8;
+    int frameCount = 12;
+
+//    康奈尔盒子里漂着一群小球，每个球有自己的速度；一个盒子绕着中心转圈，一个移动的球左右摆动
+    Random::Seed(0);
+    std::vector<Hitable *> list;
+    Material *red = new Lambertian(new ConstantTexture({0.65, 0.05, 0.05}));
+    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
+    Material *green = new Lambertian(new ConstantTexture({0.12, 0.45, 0.15}));
+    Material *lightMaterial = new DiffuseLight(new ConstantTexture({15, 15, 15}));
+    list.push_back(new YZRect(0, 555, 0, 555, 555, green));
+    list.push_back(new YZRect(0, 555, 0, 555, 0, red));
+    Hitable *light = new XZRect(213, 343, 227, 332, 554, lightMaterial, RectNormal::FixedNegative);
+    list.push_back(light);
+    list.push_back(new XZRect(0, 555, 0, 555, 555, white));
+    list.push_back(new XZRect(0, 555, 0, 555, 0, white));
+    list.push_back(new XYRect(0, 555, 0, 555, 555, white));
+    std::vector<Sphere *> spheres;
+    std::vector<Vector3> origins, velocities;
+    for (int k = 0; k < 5000; k++) {
+        Vector3 origin{Random::GenUniformRandom(200, 355), Random::GenUniformRandom(200, 355),
+                       Random::GenUniformRandom(200, 355)};
+        Vector3 velocity{Random::GenUniformRandom(-8, 8), Random::GenUniformRandom(-8, 8),
+                         Random::GenUniformRandom(-8, 8)};
+        spheres.push_back(new Sphere(origin, 3, white));
+        origins.push_back(origin);
+        velocities.push_back(velocity);
+        list.push_back(spheres.back());
+    }
+    Translate *box = new Translate(new Cube({0, 0, 0}, {80, 80, 80}, white), {100, 0, 100});
+    list.push_back(box);
+    MovingSphere *moving = new MovingSphere({100, 400, 300}, {130, 400, 300}, 0, 1, 40, red);
+    list.push_back(moving);
+
+    DynamicBVH *world = new DynamicBVH(list, 0, 1);
+    Camera *camera = new Camera({278, 278, -800}, {278, 278, 0}, {0, 1, 0}, 40, double(nx) / double(ny), 0, 10, 0, 1);
+
+    double updateSeconds = 0, rebuildSeconds = 0;
+    int rebuilds = 0;
+    size_t mismatch = 0;
+    auto update = [&](int frame) {
+        for (size_t k = 0; k < spheres.size(); k++) {
+            spheres[k]->setCenter(origins[k] + frame * velocities[k]);
+        }
+        double angle = 2 * M_PI * frame / frameCount;
+        box->setOffset({238 + 150 * cos(angle), 0, 238 + 150 * sin(angle)});
+        double swing = 60 * sin(angle);
+        moving->setCenters({100 + swing, 400, 300}, {130 + swing, 400, 300});
+
+        BVHUpdateStats stats = world->update();
+        updateSeconds += stats.seconds;
+        rebuilds += stats.rebuilt;
+//        对照：每帧从头建树
+        BVHBuildStats buildStats;
+        LinearBVH fresh(list, 0, 1, BVHBuildOptions(), &buildStats);
+        rebuildSeconds += buildStats.buildSeconds;
+        size_t frameMismatch = Mismatch(Trace(nullptr, &fresh, camera, nx, ny),
+                                        Trace(nullptr, world, camera, nx, ny));
+        mismatch += frameMismatch;
+        std::cout << "frame " << frame << " " << stats << ", full build: " << buildStats.buildSeconds * 1000
+                  << " ms (sah cost " << buildStats.sahCost << "), mismatch: " << frameMismatch << "\n";
+        return camera;
+    };
+
+    Renderer renderer(nx, ny, ns, camera, world, light);
+    renderer.renderAnimation(frameCount, update, "test_animation_1_%02d.ppm");
+    std::cout << "update: " << updateSeconds * 1000 / frameCount << " ms/frame, " << rebuilds << " rebuilds; "
+              << "full build: " << rebuildSeconds * 1000 / frameCount << " ms/frame; mismatch: " << mismatch << "\n";
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+    return mismatch == 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+//打开遍历统计，打印每条光线访问的节点数
+#define BVH_STATS
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+//每个像素一条相机光线，统计求交速度和每条光线访问的节点数
+void Trace(const char *name, Hitable *world, Camera *camera, int nx, int ny) {
+    uint64_t visits = ThreadBVHNodeVisits;
+    int hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            Random::StartSample(j * nx + i, 0);
+            double u = double(i + Random::GenUniform()) / double(nx);
+            double v = double(j + Random::GenUniform()) / double(ny);
+            BVH_STATS_RAY(0);
+            HitRecord record;
+            hits += world->hit(camera->getRay(u, v), 0.001, MAXFLOAT, record);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double rays = double(nx) * ny;
+    std::cout << name << ": " << rays / seconds / 1e6 << " Mrays/s, "
+              << (ThreadBVHNodeVisits - visits) / rays << " nodes/ray, " << hits << " hits\n";
+}
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    int nx = 400;
+    int ny = 400;
+    int ns = 16;
+
+//    不同的箱数和叶子大小建 10000 个随机小球
+    Random::Seed(0);
+    std::vector<Hitable *> spheres;
+    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
+    for (int k = 0; k < 10000; k++) {
+        spheres.push_back(new Sphere({Random::GenUniformRandom(0, 555),
+                                      Random::GenUniformRandom(0, 555),
+                                      Random::GenUniformRandom(0, 555)}, 4, white));
+    }
+    Camera sphereCamera({278, 278, -800}, {278, 278, 0}, {0, 1, 0}, 40, double(nx) / double(ny), 0, 10, 0, 1);
+    for (int binCount : {4, 8, 16, 32}) {
+        for (int maxLeafSize : {1, 2, 4, 8}) {
+            BVHBuildOptions options;
+            options.binCount = binCount;
+            options.maxLeafSize = maxLeafSize;
+            BVHBuildStats stats;
+            Hitable *bvh = new BVHNode(spheres, 0, 1, options, &stats);
+            std::cout << "bins " << binCount << " leaf " << maxLeafSize << " ";
+            stats.report(std::cout);
+            Trace("  spheres", bvh, &sphereCamera, nx, ny);
+        }
+    }
+
+    Hitable *world;
+    Camera *camera;
+    Hitable *light;
+    CreateBoxesAndSpheres(&world, &light, &camera, double(nx) / double(ny));
+    Trace("boxes and spheres", world, camera, nx, ny);
+
+    ImageWriter writer("test_bvh_sah_1.ppm", nx, ny, ImageFormat::PPM);
+    Renderer renderer(nx, ny, ns, camera, world, light);
+    renderer.render(&writer);
+    writer.close();
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+}
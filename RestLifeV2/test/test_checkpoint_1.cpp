@@ -0,0 +1,119 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+std::string ReadFile(const std::string &path) {
+    std::ifstream fin(path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << fin.rdbuf();
+    return buffer.str();
+}
+
+bool Exists(const std::string &path) {
+    return std::ifstream(path).good();
+}
+
+Renderer *CreateRenderer(int nx, int ny, int ns, Camera *camera, Hitable *world, Hitable *light, bool adaptive) {
+    Renderer *renderer = new Renderer(nx, ny, ns, camera, world, light);
+    if (adaptive) {
+        renderer->setAdaptive(8, 4 * ns, 0.05);
+    }
+    return renderer;
+}
+
+/**
+ * 子进程从头渲染，每一遍之后都存检查点，采到总样本数一半时用 SIGKILL 杀掉自己（和被外部杀掉一样，不做任何清理）
+ * 父进程从留下的检查点继续渲染，图像和不中断渲染的结果逐字节比较
+ * 子进程在父进程创建线程池之前 fork
+ * @return 不同的像素数，检查点流程本身出错时返回 -1
+ */
+int CheckResume(const std::string &name, Camera *camera, Hitable *world, Hitable *light,
+                int nx, int ny, int ns, bool adaptive) {
+    int passSamples = 4;
+    std::string checkpoint = name + ".checkpoint";
+    std::string resumedPath = name + "_resumed.ppm";
+    std::string referencePath = name + "_reference.ppm";
+    std::remove(checkpoint.c_str());
+
+    pid_t child = fork();
+    if (child == 0) {
+        std::atomic<int64_t> samples(0);
+        int64_t killAt = int64_t(nx) * ny * ns / 2;
+        Renderer *renderer = CreateRenderer(nx, ny, ns, camera, world, light, adaptive);
+        renderer->setIntegrator([&](const Ray &ray) {
+            if (samples.fetch_add(1) == killAt) {
+                std::raise(SIGKILL);
+            }
+            return PathColor(ray, world, light);
+        });
+        renderer->setProgressive(passSamples, checkpoint, 0);
+        renderer->render();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGKILL || !Exists(checkpoint)) {
+        std::cout << name << ": render was not killed with a checkpoint left behind\n";
+        return -1;
+    }
+
+    ImageWriter resumedWriter(resumedPath.c_str(), nx, ny, ImageFormat::PPM);
+    Renderer *resumed = CreateRenderer(nx, ny, ns, camera, world, light, adaptive);
+    resumed->setProgressive(passSamples, checkpoint, 0);
+    std::vector<Vector3> resumedImage = resumed->render(&resumedWriter);
+    resumedWriter.close();
+    delete resumed;
+
+    ImageWriter referenceWriter(referencePath.c_str(), nx, ny, ImageFormat::PPM);
+    Renderer *reference = CreateRenderer(nx, ny, ns, camera, world, light, adaptive);
+    std::vector<Vector3> referenceImage = reference->render(&referenceWriter);
+    referenceWriter.close();
+    delete reference;
+
+    int differences = 0;
+    for (size_t k = 0; k < referenceImage.size(); k++) {
+        differences += memcmp(&resumedImage[k], &referenceImage[k], sizeof(Vector3)) != 0;
+    }
+    bool sameFile = ReadFile(resumedPath) == ReadFile(referencePath);
+    std::cout << name << ": " << differences << " differing pixels, ppm "
+              << (sameFile ? "identical" : "different") << "\n";
+    return sameFile ? differences : std::max(differences, 1);
+}
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    int nx = 100;
+    int ny = 100;
+    int ns = 32;
+    Hitable *world;
+    Hitable *light;
+    Camera *camera;
+    CreateCornellBoxWithSpecularSphereSampleBoth(&world, &light, &camera, double(nx) / double(ny));
+
+    int failures = 0;
+    for (bool adaptive : {false, true}) {
+        std::string name = adaptive ? "test_checkpoint_1_adaptive" : "test_checkpoint_1";
+        failures += CheckResume(name, camera, world, light, nx, ny, ns, adaptive) != 0;
+    }
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    return failures;
+}
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+#include "../linear_bvh.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+//同一份源码编译两次：test_float_build_1 是 double 构建，test_float_build_1_float 定义了 RESTLIFE_FLOAT
+const char *BuildName = sizeof(Float) == sizeof(float) ? "float" : "double";
+const char *OtherName = sizeof(Float) == sizeof(float) ? "double" : "float";
+
+//单线程逐像素跑路径追踪，统计光线吞吐量
+std::vector<Vector3> Render(const char *name, Hitable *world, Hitable *light, Camera *camera, int nx, int ny, int ns) {
+    std::vector<Vector3> framebuffer(size_t(nx) * ny, Vector3{0, 0, 0});
+    uint64_t rays = ThreadRayCount;
+    auto start = std::chrono::steady_clock::now();
+    for (int j = ny - 1; j >= 0; j--) {
+        for (int i = 0; i < nx; i++) {
+            Vector3 col{0, 0, 0};
+            for (int s = 0; s < ns; s++) {
+                Random::StartSample(j * nx + i, s);
+                double u = double(i + Random::GenUniform()) / double(nx);
+                double v = double(j + Random::GenUniform()) / double(ny);
+                col += deNan(PathColor(camera->getRay(u, v), world, light));
+            }
+            framebuffer[(ny - 1 - j) * nx + i] = col / Float(ns);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << " (" << BuildName << "): " << (ThreadRayCount - rays) / seconds / 1e6 << " Mrays/s, "
+              << double(nx) * ny * ns / seconds / 1e6 << " Msamples/s\n";
+    return framebuffer;
+}
+
+//读回 ImageWriter 写的 pfm，两个构建的行顺序一样，不用翻转
+bool ReadPFM(const std::string &path, int nx, int ny, std::vector<float> &pixels) {
+    std::ifstream fin(path, std::ios::binary);
+    std::string magic;
+    int width, height;
+    double scale;
+    if (!(fin >> magic >> width >> height >> scale) || magic != "PF" || width != nx || height != ny) {
+        return false;
+    }
+    fin.get();
+    pixels.resize(size_t(nx) * ny * 3);
+    return bool(fin.read(reinterpret_cast<char *>(pixels.data()), pixels.size() * sizeof(float)));
+}
+
+//和另一个构建的结果比较：均方根误差和平均亮度的相对差
+void Compare(const std::string &name, int nx, int ny) {
+    std::vector<float> mine, other;
+    std::string otherPath = "test_float_build_1_" + name + "_" + OtherName + ".pfm";
+    if (!ReadPFM("test_float_build_1_" + name + "_" + BuildName + ".pfm", nx, ny, mine) ||
+        !ReadPFM(otherPath, nx, ny, other)) {
+        std::cout << "  " << otherPath << " not found, run the " << OtherName << " build to compare\n";
+        return;
+    }
+    double squared = 0, sumMine = 0, sumOther = 0;
+    for (size_t k = 0; k < mine.size(); k++) {
+        squared += double(mine[k] - other[k]) * (mine[k] - other[k]);
+        sumMine += mine[k];
+        sumOther += other[k];
+    }
+    std::cout << "  vs " << OtherName << ": rmse " << std::sqrt(squared / mine.size())
+              << ", mean " << sumMine / mine.size() << " vs " << sumOther / other.size()
+              << " (" << 100 * (sumMine - sumOther) / sumOther << "%)\n";
+}
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    int nx = 200;
+    int ny = 200;
+    int ns = 32;
+    std::cout << "sizeof(Ray): " << sizeof(Ray) << ", sizeof(HitRecord): " << sizeof(HitRecord)
+              << ", sizeof(AABB): " << sizeof(AABB) << "\n";
+
+    Hitable *world;
+    Hitable *light;
+    Camera *camera;
+    CreateCornellBox(&world, &light, &camera, double(nx) / double(ny));
+    std::vector<Vector3> image = Render("cornell box", world, light, camera, nx, ny, ns);
+    ImageWriter::Write(std::string("test_float_build_1_cornell_box_") + BuildName + ".pfm", image, nx, ny,
+                       ImageFormat::PFM);
+    Compare("cornell_box", nx, ny);
+
+//    一万个球放进 LinearBVH，光线大部分时间在遍历
+    Random::Seed(0);
+    std::vector<Hitable *> list;
+    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
+    for (int k = 0; k < 10000; k++) {
+        list.push_back(new Sphere(Vector3(Random::GenUniformRandom(0, 555),
+                                          Random::GenUniformRandom(0, 555),
+                                          Random::GenUniformRandom(0, 555)), 5, white));
+    }
+    Hitable *lamp = new XZRect(113, 443, 127, 432, 554, new DiffuseLight(new ConstantTexture({7, 7, 7})),
+                               RectNormal::FixedNegative);
+    list.push_back(lamp);
+    LinearBVH spheres(list, 0, 1);
+    image = Render("spheres", &spheres, lamp, camera, nx, ny, ns / 4);
+    ImageWriter::Write(std::string("test_float_build_1_spheres_") + BuildName + ".pfm", image, nx, ny,
+                       ImageFormat::PFM);
+    Compare("spheres", nx, ny);
+
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+}
@@ -0,0 +1,105 @@
+//打开遍历统计，打印每条光线访问的节点数
+#define BVH_STATS
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+#include "../instance.hpp"
+#include "trace_compare.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+//实例的变换会带来一点舍入误差，按相对误差比较
+const double Tolerance = 1e-6;
+
+std::vector<Hitable *> Cluster(Material *material) {
+    std::vector<Hitable *> spheres;
+    for (int j = 0; j < 1000; j++) {
+        spheres.push_back(new Sphere({Random::GenUniformRandom(0, 165),
+                                      Random::GenUniformRandom(0, 165),
+                                      Random::GenUniformRandom(0, 165)}, 10, material));
+    }
+    return spheres;
+}
+
+//copies 份同样的球球盒子：每份都复制几何体各建一棵 BVH，和只建一个 BLAS 再放 copies 个实例对比
+void Scaling(int copies) {
+    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
+    Random::Seed(0);
+    std::vector<Hitable *> spheres = Cluster(white);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Hitable *> duplicated;
+    size_t duplicatedBytes = 0;
+    for (int k = 0; k < copies; k++) {
+        std::vector<Hitable *> copy;
+        for (Hitable *sphere : spheres) {
+            copy.push_back(new Sphere(*static_cast<Sphere *>(sphere)));
+        }
+        LinearBVH *bvh = new LinearBVH(copy, 0, 1);
+        duplicated.push_back(new Translate(bvh, {k * 200.0, 0, 0}));
+        duplicatedBytes += bvh->memoryBytes() + copy.size() * sizeof(Sphere) + sizeof(Translate);
+    }
+    LinearBVH duplicatedWorld(duplicated, 0, 1);
+    duplicatedBytes += duplicatedWorld.memoryBytes();
+    double duplicatedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    LinearBVH *blas = new LinearBVH(spheres, 0, 1);
+    std::vector<Hitable *> instances;
+    for (int k = 0; k < copies; k++) {
+        instances.push_back(new Instance(blas, TranslateTransform({k * 200.0, 0, 0})));
+    }
+    LinearBVH tlas(instances, 0, 1);
+    double instancedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t instancedBytes = blas->memoryBytes() + spheres.size() * sizeof(Sphere) +
+                            copies * sizeof(Instance) + tlas.memoryBytes();
+
+    std::cout << copies << " copies: duplicated " << duplicatedSeconds << " s, " << duplicatedBytes / 1024
+              << " KB; instanced " << instancedSeconds << " s, " << instancedBytes / 1024 << " KB\n";
+}
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    size_t mismatch = 0;
+    int nx = 400;
+    int ny = 400;
+    int ns = 16;
+
+    for (int copies : {1, 10, 100}) {
+        Scaling(copies);
+    }
+
+    Hitable *world, *instancedWorld;
+    Hitable *light, *instancedLight;
+    Camera *camera, *instancedCamera;
+    CreateCornellBox(&world, &light, &camera, double(nx) / double(ny));
+    CreateCornellBoxInstanced(&instancedWorld, &instancedLight, &instancedCamera, double(nx) / double(ny));
+    std::vector<double> expected = Trace("cornell box", world, camera, nx, ny);
+    mismatch += Compare(expected, Trace("cornell box instanced", instancedWorld, instancedCamera, nx, ny),
+                        Tolerance);
+
+    CreateBoxesAndSpheres(&world, &light, &camera, double(nx) / double(ny));
+    CreateBoxesAndSpheresInstanced(&instancedWorld, &instancedLight, &instancedCamera, double(nx) / double(ny));
+    expected = Trace("boxes and spheres", world, camera, nx, ny);
+    mismatch += Compare(expected, Trace("boxes and spheres instanced", instancedWorld, instancedCamera, nx, ny),
+                        Tolerance);
+
+    ImageWriter writer("test_instancing_1.ppm", nx, ny, ImageFormat::PPM);
+    Renderer renderer(nx, ny, ns, instancedCamera, instancedWorld, instancedLight);
+    renderer.render(&writer);
+    writer.close();
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+    return mismatch == 0 ? 0 : 1;
+}
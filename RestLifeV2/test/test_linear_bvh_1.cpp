@@ -0,0 +1,72 @@
+//打开遍历统计，打印每条光线访问的节点数
+#define BVH_STATS
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+#include "../linear_bvh.hpp"
+#include "trace_compare.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    size_t mismatch = 0;
+    int nx = 400;
+    int ny = 400;
+    int ns = 16;
+
+    Random::Seed(0);
+    std::vector<Hitable *> spheres;
+    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
+    for (int k = 0; k < 10000; k++) {
+        spheres.push_back(new Sphere({Random::GenUniformRandom(0, 555),
+                                      Random::GenUniformRandom(0, 555),
+                                      Random::GenUniformRandom(0, 555)}, 4, white));
+    }
+    Camera sphereCamera({278, 278, -800}, {278, 278, 0}, {0, 1, 0}, 40, double(nx) / double(ny), 0, 10, 0, 1);
+    BVHBuildStats stats;
+    BVHNode *tree = new BVHNode(spheres, 0, 1, BVHBuildOptions(), &stats);
+    LinearBVH *linear = new LinearBVH(spheres, 0, 1);
+    std::cout << stats << "\n";
+    std::cout << "linear bvh: " << linear->nodes().size() << " nodes, " << linear->memoryBytes() << " bytes\n";
+    std::vector<double> expected = Trace("spheres BVHNode", tree, &sphereCamera, nx, ny);
+    mismatch += Compare(expected, Trace("spheres LinearBVH", linear, &sphereCamera, nx, ny));
+
+    Hitable *world;
+    Camera *camera;
+    Hitable *light;
+    CreateBoxesAndSpheres(&world, &light, &camera, double(nx) / double(ny));
+    LinearBVH *flattened = new LinearBVH(static_cast<BVHNode *>(world), 0, 1);
+    expected = Trace("boxes and spheres BVHNode", world, camera, nx, ny);
+    mismatch += Compare(expected, Trace("boxes and spheres LinearBVH", flattened, camera, nx, ny));
+
+//    SAH 建出来的树比遍历栈深：建树时限制深度，从 BVHNode 扁平化时重新建树，都不应该抛异常
+    std::vector<Ray> deepRays;
+    std::vector<Hitable *> deep = DeepSpheres(250, white, deepRays);
+    BVHNode *deepTree = new BVHNode(deep, 0, 1);
+    HitableList deepList(deep);
+    expected = TraceRays(&deepList, deepRays);
+    std::cout << "deep spheres LinearBVH\n";
+    mismatch += Compare(expected, TraceRays(new LinearBVH(deep, 0, 1), deepRays));
+    std::cout << "deep spheres LinearBVH from BVHNode\n";
+    mismatch += Compare(expected, TraceRays(new LinearBVH(deepTree, 0, 1), deepRays));
+
+    ImageWriter writer("test_linear_bvh_1.ppm", nx, ny, ImageFormat::PPM);
+    Renderer renderer(nx, ny, ns, camera, flattened, light);
+    renderer.render(&writer);
+    writer.close();
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+    return mismatch == 0 ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+#include "../light_sampler.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//康奈尔盒子，顶上一个 8x8 的灯阵（四盏亮灯，其余很暗），地上六个彩色的小发光球，背墙和两侧墙上各一条灯带
+void CreateManyLights(Scene &scene, Float aspect) {
+    std::vector<Hitable *> list;
+    Material *red = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.65, 0.05, 0.05}));
+    Material *white = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.73, 0.73, 0.73}));
+    Material *green = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.12, 0.45, 0.15}));
+    list.push_back(scene.create<YZRect>(0, 555, 0, 555, 555, green));       // 左墙
+    list.push_back(scene.create<YZRect>(0, 555, 0, 555, 0, red));           // 右墙
+    list.push_back(scene.create<XZRect>(0, 555, 0, 555, 555, white));       // 顶板
+    list.push_back(scene.create<XZRect>(0, 555, 0, 555, 0, white));         // 地板
+    list.push_back(scene.create<XYRect>(0, 555, 0, 555, 555, white));       // 背墙
+    Material *dim = scene.create<DiffuseLight>(scene.create<ConstantTexture>(Vector3{1, 1, 1}));
+    Material *bright = scene.create<DiffuseLight>(scene.create<ConstantTexture>(Vector3{60, 60, 60}));
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            Float x0 = 40 + i * 60;
+            Float z0 = 40 + j * 60;
+            bool isBright = (i == 2 || i == 5) && (j == 2 || j == 5);
+            list.push_back(scene.create<XZRect>(x0, x0 + 30, z0, z0 + 30, 554, isBright ? bright : dim,
+                                                RectNormal::FixedNegative));
+        }
+    }
+    for (int k = 0; k < 6; k++) {
+        Vector3 color(k % 3 == 0 ? 8 : 1, k % 3 == 1 ? 8 : 1, k % 3 == 2 ? 8 : 1);
+        list.push_back(scene.create<Sphere>(Vector3(60 + k * 85, 15, 100), 15,
+                                            scene.create<DiffuseLight>(scene.create<ConstantTexture>(color))));
+    }
+//    墙上的灯带，离墙一点，法线朝向盒子里面
+    Material *strip = scene.create<DiffuseLight>(scene.create<ConstantTexture>(Vector3{4, 4, 4}));
+    list.push_back(scene.create<XYRect>(100, 455, 400, 420, 554, strip, RectNormal::FixedNegative));
+    list.push_back(scene.create<YZRect>(400, 420, 100, 455, 554, strip, RectNormal::FixedNegative));
+    list.push_back(scene.create<YZRect>(400, 420, 100, 455, 1, strip, RectNormal::FixedPositive));
+    list.push_back(scene.create<Translate>(
+            scene.create<RotateY>(
+                    scene.create<Cube>(
+                            Vector3{0, 0, 0}, Vector3{165, 330, 165}, white, scene.primitiveArena()
+                    ), 15
+            ), Vector3{265, 0, 295}
+    ));
+    Hitable *world = scene.create<BVHNode>(list, 0, 1, scene.bvhOptions());
+    Camera *camera = scene.create<Camera>(Vector3{278, 278, -800}, Vector3{278, 278, 0}, Vector3{0, 1, 0},
+                                          40.0, aspect, 0.0, 10.0, 0.0, 1.0);
+    scene.set(world, nullptr, camera);
+}
+
+/**
+ * 单线程按整遍（每个像素 1 个样本）渲染，直到用完 seconds 秒或者达到 maxPasses 遍
+ * 返回每个像素的平均值，passes 是实际渲染的遍数；firstSample 错开参考图和被比较图像的随机数流
+ */
+std::vector<Vector3> Render(Hitable *world, Hitable *light, Camera *camera, int nx, int ny, double seconds,
+                            int maxPasses, int &passes, int firstSample = 0) {
+    std::vector<Vector3> sum(size_t(nx) * ny, Vector3{0, 0, 0});
+    auto start = std::chrono::steady_clock::now();
+    for (passes = 0; passes < maxPasses && Seconds(start) < seconds; passes++) {
+        for (int j = 0; j < ny; j++) {
+            for (int i = 0; i < nx; i++) {
+                Random::StartSample(j * nx + i, firstSample + passes);
+                double u = double(i + Random::GenUniform()) / double(nx);
+                double v = double(j + Random::GenUniform()) / double(ny);
+                sum[j * nx + i] += deNan(MISColor(camera->getRay(u, v), world, light));
+            }
+        }
+    }
+    for (Vector3 &pixel : sum) {
+        pixel /= Float(passes);
+    }
+    return sum;
+}
+
+double MeanSquaredError(const std::vector<Vector3> &image, const std::vector<Vector3> &reference) {
+    double squared = 0;
+    for (size_t k = 0; k < image.size(); k++) {
+        squared += (image[k] - reference[k]).squaredNorm() / 3;
+    }
+    return squared / image.size();
+}
+
+//盒子里发光球上方的随机点，避开在球里面的情况
+Vector3 RandomPoint() {
+    return Vector3(Random::GenUniformRandom(1, 554), Random::GenUniformRandom(40, 553),
+                   Random::GenUniformRandom(1, 554));
+}
+
+/**
+ * 采样器给出的 pdf 应当等于逐个光源累加 概率 × pdf 的结果，
+ * 并且每个光源（包括三种矩形和球）自己采出来的方向在它上面的 pdf 都大于 0
+ * @return 是否通过
+ */
+bool CheckPDF(LightSampler *sampler, int count) {
+    Random::Seed(1);
+    const std::vector<Hitable *> &lights = sampler->lights();
+    double maxError = 0;
+    int zero = 0;
+    for (int n = 0; n < count; n++) {
+        Vector3 o = RandomPoint();
+        Vector3 direction = sampler->random(o).normalized();
+        double expected = 0;
+        for (int k = 0; k < int(lights.size()); k++) {
+            expected += sampler->probability(k) * lights[k]->pdfValue(o, direction);
+        }
+        if (expected > 0) {
+            maxError = std::max(maxError, std::abs(sampler->pdfValue(o, direction) - expected) / expected);
+        } else {
+            zero++;
+        }
+        Hitable *light = lights[n % lights.size()];
+        zero += !(light->pdfValue(o, light->random(o)) > 0);
+    }
+    std::cout << "pdf check: max relative error " << maxError << ", zero pdf samples " << zero << " over "
+              << count << " samples\n";
+    return maxError < 1e-4 && zero == 0;
+}
+
+//随机起点、随机方向上的 pdfValue 吞吐量
+void PDFThroughput(const char *name, Hitable *light, int count) {
+    Random::Seed(2);
+    double sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < count; n++) {
+        Vector3 o = RandomPoint();
+        sum += light->pdfValue(o, light->random(o));
+    }
+    std::cout << name << ": " << count / Seconds(start) / 1e6 << " M random+pdfValue/s (checksum " << sum << ")\n";
+}
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    int nx = 100;
+    int ny = 100;
+    int ns = 64;
+
+    Scene scene;
+    CreateManyLights(scene, double(nx) / double(ny));
+    Hitable *uniform = scene.create<HitableList>(LightSampler::Extract(scene.world()));
+    LightSampler *sampler = scene.extractLights();
+    std::cout << sampler->lights().size() << " lights, " << scene << "\n";
+    bool passed = CheckPDF(sampler, 100000);
+    PDFThroughput("uniform HitableList", uniform, 200000);
+    PDFThroughput("LightSampler", sampler, 200000);
+
+    int passes;
+    std::vector<Vector3> reference = Render(scene.world(), sampler, scene.camera(), nx, ny, 1e30, 512, passes,
+                                            1 << 20);
+    std::cout << "reference: " << passes << " spp\n";
+    for (double seconds : {1.0, 4.0}) {
+        for (const auto &light : std::vector<std::pair<const char *, Hitable *>>{{"uniform HitableList", uniform},
+                                                                                {"LightSampler",        sampler}}) {
+            std::vector<Vector3> image = Render(scene.world(), light.second, scene.camera(), nx, ny, seconds,
+                                                1 << 30, passes);
+            std::cout << "  " << light.first << " " << seconds << " s: " << passes << " spp, mse "
+                      << MeanSquaredError(image, reference) << "\n";
+        }
+    }
+
+    ImageWriter writer("test_many_lights_1.ppm", 400, 400, ImageFormat::PPM);
+    Renderer renderer(400, 400, ns, scene.camera(), scene.world(), sampler);
+    renderer.setIntegrator([&](const Ray &ray) { return MISColor(ray, scene.world(), sampler); });
+    renderer.render(&writer);
+    writer.close();
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+#include "../wavefront.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Hit {
+    Ray ray;
+    HitRecord record;
+};
+
+//相机光线的交点，材质类型在数组里是交错的
+std::vector<Hit> PrimaryHits(Hitable *world, Camera *camera, int nx, int ny) {
+    std::vector<Hit> hits;
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            Random::StartSample(j * nx + i, 0);
+            Hit hit{camera->getRay(double(i + Random::GenUniform()) / double(nx),
+                                   double(j + Random::GenUniform()) / double(ny)), HitRecord()};
+            if (world->hit(hit.ray, 0, Infinity, hit.record)) {
+                hits.push_back(hit);
+            }
+        }
+    }
+    return hits;
+}
+
+//逐个交点按标签分派，和按类型分组后每组只分派一次比较；每个交点用自己的随机数流，两种方式结果一样
+void ScatterThroughput(const char *name, const std::vector<Hit> &hits, int rounds) {
+    Vector3 single{0, 0, 0};
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t k = 0; k < hits.size(); k++) {
+            Random::StartSample(int(k), r);
+            ScatterRecord scatterRecord;
+            const HitRecord &record = hits[k].record;
+            single += record.material->emitted(hits[k].ray, record, record.u, record.v, record.p);
+            if (record.material->scatter(hits[k].ray, record, scatterRecord)) {
+                single += scatterRecord.attenuation;
+            }
+        }
+    }
+    double singleSeconds = Seconds(start);
+
+    std::vector<int> order(hits.size());
+    for (size_t k = 0; k < hits.size(); k++) {
+        order[k] = int(k);
+    }
+    Vector3 batched{0, 0, 0};
+    start = std::chrono::steady_clock::now();
+    Material::ShadeBatch(order, [&](int k) { return hits[k].record.material; },
+                         [&](auto tag, size_t begin, size_t end) {
+        for (int r = 0; r < rounds; r++) {
+            for (size_t a = begin; a < end; a++) {
+                int k = order[a];
+                Random::StartSample(k, r);
+                ScatterRecord scatterRecord;
+                const HitRecord &record = hits[k].record;
+                const Material *material = record.material;
+                batched += material->emittedAs<decltype(tag)::value>(hits[k].ray, record, record.u, record.v,
+                                                                     record.p);
+                if (material->scatterAs<decltype(tag)::value>(hits[k].ray, record, scatterRecord)) {
+                    batched += scatterRecord.attenuation;
+                }
+            }
+        }
+    });
+    double batchedSeconds = Seconds(start);
+    double count = double(hits.size()) * rounds;
+    std::cout << name << ": " << hits.size() << " hits, per hit " << count / singleSeconds / 1e6
+              << " Mscatters/s, batched " << count / batchedSeconds / 1e6 << " Mscatters/s, difference "
+              << (single - batched).norm() / single.norm() << "\n";
+}
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    int nx = 400;
+    int ny = 400;
+    int ns = 16;
+    std::cout << "sizeof(Material): " << sizeof(Material) << ", sizeof(Texture): " << sizeof(Texture) << "\n";
+
+    Hitable *world;
+    Hitable *light;
+    Camera *camera;
+    CreateBoxesAndSpheres(&world, &light, &camera, double(nx) / double(ny));
+    ScatterThroughput("boxes and spheres", PrimaryHits(world, camera, nx, ny), 8);
+    CreateCornellBoxWithSpecularSphereSampleBoth(&world, &light, &camera, double(nx) / double(ny));
+    ScatterThroughput("cornell box specular sphere", PrimaryHits(world, camera, nx, ny), 8);
+
+//    单线程，逐路径按标签分派的 PathColor 和按材质类型分组着色的波前渲染
+    auto render = std::chrono::steady_clock::now();
+    Vector3 sum{0, 0, 0};
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            for (int s = 0; s < ns; s++) {
+                Random::StartSample(j * nx + i, s);
+                double u = double(i + Random::GenUniform()) / double(nx);
+                double v = double(j + Random::GenUniform()) / double(ny);
+                sum += deNan(PathColor(camera->getRay(u, v), world, light));
+            }
+        }
+    }
+    double samples = double(nx) * ny * ns;
+    std::cout << "PathColor: " << samples / Seconds(render) / 1e6 << " Msamples/s, mean "
+              << sum.transpose() / samples << "\n";
+
+    render = std::chrono::steady_clock::now();
+    WavefrontRenderer renderer(nx, ny, ns, camera, world, light, 1);
+    ImageWriter writer("test_material_dispatch_1.ppm", nx, ny, ImageFormat::PPM);
+    std::vector<Vector3> image = renderer.render(&writer);
+    writer.close();
+    sum = Vector3{0, 0, 0};
+    for (const Vector3 &pixel : image) {
+        sum += pixel;
+    }
+    std::cout << "wavefront: " << samples / Seconds(render) / 1e6 << " Msamples/s, mean "
+              << sum.transpose() / double(image.size()) << "\n";
+    renderer.printStageTimes();
+
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+}
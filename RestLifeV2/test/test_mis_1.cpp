@@ -0,0 +1,124 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+typedef std::function<Vector3(const Ray &, Hitable *, Hitable *)> Integrator;
+
+/**
+ * 单线程按整遍（每个像素 1 个样本）渲染，直到用完 seconds 秒或者达到 maxPasses 遍
+ * 返回每个像素的平均值，passes 是实际渲染的遍数；firstSample 错开参考图和被比较图像的随机数流
+ */
+std::vector<Vector3> Render(const Integrator &integrator, Hitable *world, Hitable *light, Camera *camera,
+                            int nx, int ny, double seconds, int maxPasses, int &passes, int firstSample = 0) {
+    std::vector<Vector3> sum(size_t(nx) * ny, Vector3{0, 0, 0});
+    auto start = std::chrono::steady_clock::now();
+    for (passes = 0; passes < maxPasses; passes++) {
+        if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= seconds) {
+            break;
+        }
+        for (int j = 0; j < ny; j++) {
+            for (int i = 0; i < nx; i++) {
+                Random::StartSample(j * nx + i, firstSample + passes);
+                double u = double(i + Random::GenUniform()) / double(nx);
+                double v = double(j + Random::GenUniform()) / double(ny);
+                sum[j * nx + i] += deNan(integrator(camera->getRay(u, v), world, light));
+            }
+        }
+    }
+    for (Vector3 &pixel : sum) {
+        pixel /= Float(passes);
+    }
+    return sum;
+}
+
+double MeanSquaredError(const std::vector<Vector3> &image, const std::vector<Vector3> &reference) {
+    double squared = 0;
+    for (size_t k = 0; k < image.size(); k++) {
+        squared += (image[k] - reference[k]).squaredNorm() / 3;
+    }
+    return squared / image.size();
+}
+
+Vector3 Mean(const std::vector<Vector3> &image) {
+    Vector3 sum{0, 0, 0};
+    for (const Vector3 &pixel : image) {
+        sum += pixel;
+    }
+    return sum / Float(image.size());
+}
+
+/**
+ * 同样的渲染时间下比较各积分器和参考图之间的均方误差
+ * 参考图有两张：MISColor（power）和独立的 PathColor（混合 pdf），被测的积分器和两张参考图都比较，
+ * 一个积分器的偏差不会因为参考图也用了它而被抵消
+ */
+void EqualTime(const char *name, void (*builder)(Scene &, Float), int nx, int ny, int referencePasses,
+               double seconds) {
+    Scene scene;
+    builder(scene, double(nx) / double(ny));
+    Integrator path = [](const Ray &ray, Hitable *world, Hitable *light) {
+        return PathColor(ray, world, light);
+    };
+    Integrator mis = [](const Ray &ray, Hitable *world, Hitable *light) {
+        return MISColor(ray, world, light, MISHeuristic::Power);
+    };
+    int passes;
+    std::vector<Vector3> misReference = Render(mis, scene.world(), scene.light(), scene.camera(), nx, ny, 1e30,
+                                               referencePasses, passes, 1 << 20);
+    std::vector<Vector3> pathReference = Render(path, scene.world(), scene.light(), scene.camera(), nx, ny, 1e30,
+                                                referencePasses, passes, 1 << 21);
+    std::cout << name << ": references " << passes << " spp, mean MISColor " << Mean(misReference).transpose()
+              << ", PathColor " << Mean(pathReference).transpose() << ", mse between them "
+              << MeanSquaredError(misReference, pathReference) << "\n";
+
+    std::vector<std::pair<const char *, Integrator>> integrators = {
+            {"PathColor (mixture pdf)", path},
+            {"MISColor balance",        [](const Ray &ray, Hitable *world, Hitable *light) {
+                return MISColor(ray, world, light, MISHeuristic::Balance);
+            }},
+            {"MISColor power",          mis}
+    };
+    for (const auto &integrator : integrators) {
+        std::vector<Vector3> image = Render(integrator.second, scene.world(), scene.light(), scene.camera(),
+                                            nx, ny, seconds, 1 << 30, passes);
+        std::cout << "  " << integrator.first << ": " << passes << " spp, mse vs MISColor "
+                  << MeanSquaredError(image, misReference) << ", vs PathColor "
+                  << MeanSquaredError(image, pathReference) << ", mean " << Mean(image).transpose() << "\n";
+    }
+}
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    int nx = 100;
+    int ny = 100;
+    int ns = 64;
+
+    EqualTime("cornell box", CreateCornellBox, nx, ny, 512, 2.0);
+    EqualTime("cornell box specular face", CreateCornellBoxWithSpecularFace, nx, ny, 512, 2.0);
+    EqualTime("cornell box specular sphere", CreateCornellBoxWithSpecularSphereSampleBoth, nx, ny, 512, 2.0);
+
+    Hitable *world;
+    Hitable *light;
+    Camera *camera;
+    CreateCornellBox(&world, &light, &camera, 1.0);
+    ImageWriter writer("test_mis_1.ppm", 400, 400, ImageFormat::PPM);
+    Renderer renderer(400, 400, ns, camera, world, light);
+    renderer.setIntegrator([&](const Ray &ray) { return MISColor(ray, world, light); });
+    renderer.render(&writer);
+    writer.close();
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+}
@@ -0,0 +1,97 @@
+//打开遍历统计，打印每条光线访问的节点数
+#define BVH_STATS
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+#include "../linear_bvh.hpp"
+#include "../motion_bvh.hpp"
+#include "trace_compare.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+//NextWeek test_motion_blur 的随机场景，漫反射小球在快门时间内移动 speed * [0, 1) 的距离
+std::vector<Hitable *> RandomScene(double speed) {
+    Random::Seed(1);
+    std::vector<Hitable *> list;
+    list.push_back(new Sphere({0, -1000, 0}, 1000, new Lambertian(new ConstantTexture({0.5, 0.5, 0.5}))));
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            double chooseMaterial = Random::GenUniform();
+            Vector3 center{a + 0.9 * Random::GenUniform(), 0.2, b + 0.9 * Random::GenUniform()};
+            if ((center - Vector3{4, 0.2, 0}).norm() > 0.9) {
+                if (chooseMaterial < 0.8) {
+                    Vector3 velocity{Random::GenUniform() - 0.5, Random::GenUniform(), Random::GenUniform() - 0.5};
+                    list.push_back(new MovingSphere(center, center + speed * velocity, 0.0, 1.0, 0.2,
+                                                    new Lambertian(new ConstantTexture(
+                                                            {Random::GenUniform(), Random::GenUniform(),
+                                                             Random::GenUniform()}))));
+                } else if (chooseMaterial < 0.95) {
+                    list.push_back(new Sphere(center, 0.2, new Metal({0.7, 0.7, 0.7}, 0.1)));
+                } else {
+                    list.push_back(new Sphere(center, 0.2, new Dielectric(1.5)));
+                }
+            }
+        }
+    }
+    list.push_back(new Sphere({0, 1, 0}, 1.0, new Dielectric(1.5)));
+    list.push_back(new Sphere({-4, 1, 0}, 1.0, new Lambertian(new ConstantTexture({0.4, 0.2, 0.1}))));
+    list.push_back(new Sphere({4, 1, 0}, 1.0, new Metal({0.7, 0.6, 0.5}, 0.0)));
+    return list;
+}
+
+//每个像素 4 条不同时刻的相机光线，返回每条光线的交点距离（没打中为 -1）
+std::vector<double> TraceTimes(const char *name, Hitable *world, Camera *camera, int nx, int ny) {
+    std::vector<double> result;
+    uint64_t visits = ThreadBVHNodeVisits;
+    auto start = std::chrono::steady_clock::now();
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            for (int s = 0; s < 4; s++) {
+                Random::StartSample(j * nx + i, s);
+                double u = double(i + Random::GenUniform()) / double(nx);
+                double v = double(j + Random::GenUniform()) / double(ny);
+                BVH_STATS_RAY(0);
+                HitRecord record;
+                result.push_back(world->hit(camera->getRay(u, v), 0.001, MAXFLOAT, record) ? record.t : -1);
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double rays = double(result.size());
+    std::cout << "  " << name << ": " << rays / seconds / 1e6 << " Mrays/s, "
+              << (ThreadBVHNodeVisits - visits) / rays << " nodes/ray\n";
+    return result;
+}
+
+int main() {
+    int nx = 400;
+    int ny = 200;
+    size_t mismatch = 0;
+    Camera camera({13, 2, 3}, {0, 0, 0}, {0, 1, 0}, 20, double(nx) / double(ny), 0.0, 10.0, 0.0, 1.0);
+    for (double speed : {0.5, 2.0, 8.0}) {
+        std::vector<Hitable *> list = RandomScene(speed);
+        LinearBVH *linear = new LinearBVH(list, 0, 1);
+        MotionBVH *motion = new MotionBVH(list, 0, 1);
+        std::cout << "speed " << speed << ":\n";
+        std::vector<double> expected = TraceTimes("LinearBVH", linear, &camera, nx, ny);
+        mismatch += Compare(expected, TraceTimes("MotionBVH", motion, &camera, nx, ny));
+    }
+
+//    SAH 建出来的树比遍历栈深，建树时限制深度，不应该抛异常
+    std::vector<Ray> deepRays;
+    std::vector<Hitable *> deep = DeepSpheres(250, new Lambertian(new ConstantTexture({0.5, 0.5, 0.5})), deepRays);
+    HitableList deepList(deep);
+    std::cout << "deep spheres MotionBVH\n";
+    mismatch += Compare(TraceRays(&deepList, deepRays), TraceRays(new MotionBVH(deep, 0, 1), deepRays));
+    BVH_STATS_REPORT(std::cout);
+    return mismatch == 0 ? 0 : 1;
+}
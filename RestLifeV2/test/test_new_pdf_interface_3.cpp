@@ -1,10 +1,10 @@
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <chrono>
 #include "../camera.hpp"
 #include "../ray.hpp"
 #include "../utils.hpp"
+#include "../render.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 
@@ -23,39 +23,17 @@ int main() {
 //    nx = 4000;
 //    ny = 4000;
 //    ns = 200;
-    ofstream fout("test_new_pdf_interface_3.ppm");
-    fout << "P3" << endl << nx << " " << ny << endl << 255 << endl;
+    ImageWriter writer("test_new_pdf_interface_3.ppm", nx, ny, ImageFormat::PPM);
     Hitable *world;
     Camera *camera;
     Hitable *sampleHitable;
 //    以玻璃球采样
     CreateCornellBoxWithSpecularSphere(&world, &sampleHitable, &camera, double(nx) / double(ny));
-    for (int j = ny - 1; j >= 0; j--) {
-        for (int i = 0; i < nx; i++) {
-            Vector3d col{0, 0, 0};
-            for (int s = 0; s < ns; s++) {
-                double u = double(i + drand48()) / double(nx);
-                double v = double(j + drand48()) / double(ny);
-                Ray ray = camera->getRay(u, v);
-                col += Color(ray, world, sampleHitable, 0);
-            }
-            col /= double(ns);
-//            gamma correction
-            col = Vector3d{sqrt(col.x()), sqrt(col.y()), sqrt(col.z())};
-            int ir = int(255.99 * col.x());
-            int ig = int(255.99 * col.y());
-            int ib = int(255.99 * col.z());
-//            不能大于255
-            ir = ir > 255 ? 255 : ir;
-            ig = ig > 255 ? 255 : ig;
-            ib = ib > 255 ? 255 : ib;
-            fout << ir << " " << ig << " " << ib << endl;
-            UpdateProgress(double(ny - j) / ny);
-        }
-    }
-    fout.close();
-    UpdateProgress(1.0);
+    Renderer renderer(nx, ny, ns, camera, world, sampleHitable);
+    renderer.render(&writer);
+    writer.close();
     auto stop = std::chrono::system_clock::now();
     std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
               << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
 }
\ No newline at end of file
@@ -1,10 +1,10 @@
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <chrono>
 #include "../camera.hpp"
 #include "../ray.hpp"
 #include "../utils.hpp"
+#include "../render.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 
@@ -23,39 +23,21 @@ int main() {
     nx = 4000;
     ny = 4000;
     ns = 500;
-    ofstream fout("test_new_pdf_interface_5_4000_4000_500.ppm");
-    fout << "P3" << endl << nx << " " << ny << endl << 255 << endl;
+    ImageWriter writer("test_new_pdf_interface_5_4000_4000_500.ppm", nx, ny, ImageFormat::PPM);
     Hitable *world;
     Camera *camera;
     Hitable *sampleHitable;
 //    以光源和玻璃球采样
     CreateCornellBoxWithSpecularSphereSampleBoth(&world, &sampleHitable, &camera, double(nx) / double(ny));
-    for (int j = ny - 1; j >= 0; j--) {
-        for (int i = 0; i < nx; i++) {
-            Vector3d col{0, 0, 0};
-            for (int s = 0; s < ns; s++) {
-                double u = double(i + drand48()) / double(nx);
-                double v = double(j + drand48()) / double(ny);
-                Ray ray = camera->getRay(u, v);
-                col += deNan(Color(ray, world, sampleHitable, 0));
-            }
-            col /= double(ns);
-//            gamma correction
-            col = Vector3d{sqrt(col.x()), sqrt(col.y()), sqrt(col.z())};
-            int ir = int(255.99 * col.x());
-            int ig = int(255.99 * col.y());
-            int ib = int(255.99 * col.z());
-//            不能大于255
-            ir = ir > 255 ? 255 : ir;
-            ig = ig > 255 ? 255 : ig;
-            ib = ib > 255 ? 255 : ib;
-            fout << ir << " " << ig << " " << ib << endl;
-            UpdateProgress(double(ny - j) / ny);
-        }
-    }
-    fout.close();
-    UpdateProgress(1.0);
+    Renderer renderer(nx, ny, ns, camera, world, sampleHitable);
+//    玻璃球会产生 NaN 样本，和原来的循环一样累加前去掉
+    renderer.setDeNan(true);
+//    每遍 10 个样本，至少每 5 分钟存一次检查点，进程中断后重新运行即可继续
+    renderer.setProgressive(10, "test_new_pdf_interface_5_4000_4000_500.checkpoint", 300);
+    renderer.render(&writer);
+    writer.close();
     auto stop = std::chrono::system_clock::now();
     std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
               << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
 }
\ No newline at end of file
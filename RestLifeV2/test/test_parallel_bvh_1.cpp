@@ -0,0 +1,85 @@
+//打开遍历统计，打印每条光线访问的节点数
+#define BVH_STATS
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+#include "../linear_bvh.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+//每个像素一条相机光线，统计求交速度和每条光线访问的节点数
+void Trace(Hitable *world, Camera *camera, int nx, int ny) {
+    uint64_t visits = ThreadBVHNodeVisits;
+    auto start = std::chrono::steady_clock::now();
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            Random::StartSample(j * nx + i, 0);
+            double u = double(i + Random::GenUniform()) / double(nx);
+            double v = double(j + Random::GenUniform()) / double(ny);
+            BVH_STATS_RAY(0);
+            HitRecord record;
+            world->hit(camera->getRay(u, v), 0.001, MAXFLOAT, record);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double rays = double(nx) * ny;
+    std::cout << "  trace: " << rays / seconds / 1e6 << " Mrays/s, "
+              << (ThreadBVHNodeVisits - visits) / rays << " nodes/ray\n";
+}
+
+LinearBVH *Build(const char *name, const std::vector<Hitable *> &list, const BVHBuildOptions &options) {
+    BVHBuildStats stats;
+    LinearBVH *bvh = new LinearBVH(list, 0, 1, options, &stats);
+    std::cout << name << ": " << stats << "\n";
+    return bvh;
+}
+
+bool Same(const LinearBVH *a, const LinearBVH *b) {
+    return a->nodes().size() == b->nodes().size() && a->primitives() == b->primitives() &&
+           memcmp(a->nodes().data(), b->nodes().data(), a->nodes().size() * sizeof(LinearBVHNode)) == 0;
+}
+
+int main() {
+    int nx = 400;
+    int ny = 400;
+    int count = 300000;
+
+//    几十万个小球，建树时间占大头
+    Random::Seed(0);
+    std::vector<Hitable *> spheres;
+    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
+    for (int k = 0; k < count; k++) {
+        spheres.push_back(new Sphere({Random::GenUniformRandom(0, 555),
+                                      Random::GenUniformRandom(0, 555),
+                                      Random::GenUniformRandom(0, 555)}, 1, white));
+    }
+    Camera camera({278, 278, -800}, {278, 278, 0}, {0, 1, 0}, 40, double(nx) / double(ny), 0, 10, 0, 1);
+    ThreadPool pool;
+    std::cout << "threads: " << pool.size() << "\n";
+
+    BVHBuildOptions options;
+    LinearBVH *sah = Build("sah", spheres, options);
+    Trace(sah, &camera, nx, ny);
+    options.pool = &pool;
+    LinearBVH *parallelSah = Build("parallel sah", spheres, options);
+    std::cout << "  same tree as sah: " << (Same(sah, parallelSah) ? "yes" : "no") << "\n";
+
+    options = BVHBuildOptions();
+    options.method = BVHBuildMethod::Morton;
+    LinearBVH *morton = Build("morton", spheres, options);
+    Trace(morton, &camera, nx, ny);
+    options.pool = &pool;
+    LinearBVH *parallelMorton = Build("parallel morton", spheres, options);
+    std::cout << "  same tree as morton: " << (Same(morton, parallelMorton) ? "yes" : "no") << "\n";
+    BVH_STATS_REPORT(std::cout);
+}
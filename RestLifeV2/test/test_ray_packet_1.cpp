@@ -0,0 +1,141 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+#include "../packet.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+//康奈尔盒子的地板上再摆 40 * 40 个小球，让 BVH 深一些
+Hitable *CreateSphereField(Hitable *cornellBox) {
+    std::vector<Hitable *> list{cornellBox};
+    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
+    for (int a = 0; a < 40; a++) {
+        for (int b = 0; b < 40; b++) {
+            list.push_back(new Sphere(Vector3{10 + a * 13.5, 6, 10 + b * 13.5}, 6, white));
+        }
+    }
+    return new BVHNode(list, 0, 1);
+}
+
+//每个像素 N 条相机光线，单条求交和按包求交各跑一遍，检查结果一致并比较速度
+template<int N>
+size_t Benchmark(const char *name, Hitable *world, Camera *camera, int nx, int ny) {
+    std::vector<double> singleT, packetT;
+    singleT.reserve(size_t(nx) * ny * N);
+    packetT.reserve(size_t(nx) * ny * N);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            for (int s = 0; s < N; s++) {
+                Random::StartSample(j * nx + i, s);
+                double u = double(i + Random::GenUniform()) / double(nx);
+                double v = double(j + Random::GenUniform()) / double(ny);
+                HitRecord record;
+                singleT.push_back(world->hit(camera->getRay(u, v), 0.001, MAXFLOAT, record) ? record.t : -1);
+            }
+        }
+    }
+    double singleSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    RayPacket<N> packet;
+    HitRecord records[N];
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            for (int s = 0; s < N; s++) {
+                Random::StartSample(j * nx + i, s);
+                double u = double(i + Random::GenUniform()) / double(nx);
+                double v = double(j + Random::GenUniform()) / double(ny);
+                packet.set(s, camera->getRay(u, v));
+            }
+            packet.count = N;
+            uint32_t hits = PacketTracer<N>::Hit(world, packet, 0.001, records);
+            for (int s = 0; s < N; s++) {
+                packetT.push_back(hits >> s & 1 ? records[s].t : -1);
+            }
+        }
+    }
+    double packetSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t mismatch = 0;
+    for (size_t k = 0; k < singleT.size(); k++) {
+        mismatch += singleT[k] != packetT[k];
+    }
+    double rays = double(singleT.size());
+    std::cout << name << " packet " << N << ": single " << rays / singleSeconds / 1e6 << " Mrays/s, packet "
+              << rays / packetSeconds / 1e6 << " Mrays/s, speedup " << singleSeconds / packetSeconds
+              << ", mismatch " << mismatch << "\n";
+    return mismatch;
+}
+
+//光线恰好躺在包围盒的板平面上（起点 y = 0，方向 y 分量为 0），单条光线的板测试接受这种光线，光线包也要接受
+template<int N>
+size_t CheckOnPlane() {
+    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
+    std::vector<Hitable *> list{new XYRect(-1, 1, 0, 2, 5, white), new XYRect(-1, 1, 0, 2, 8, white)};
+    BVHNode world(list, 0, 1);
+    RayPacket<N> packet;
+    HitRecord records[N];
+    for (int k = 0; k < N; k++) {
+        packet.set(k, Ray(Vector3{-0.9 + 1.8 * k / N, 0, -10}, Vector3{0, 0, 1}));
+    }
+    packet.count = N;
+    uint32_t hits = PacketTracer<N>::Hit(&world, packet, 0.001, records);
+    size_t mismatch = 0;
+    for (int k = 0; k < N; k++) {
+        HitRecord record;
+        bool single = world.hit(packet.rays[k], 0.001, MAXFLOAT, record);
+        mismatch += single != bool(hits >> k & 1) || (single && record.t != records[k].t);
+    }
+    std::cout << "on plane packet " << N << ": mismatch " << mismatch << "\n";
+    return mismatch;
+}
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    int nx = 400;
+    int ny = 400;
+    int ns = 64;
+    Hitable *world;
+    Camera *camera;
+    Hitable *sampleHitable;
+    CreateCornellBoxWithSpecularSphereSampleBoth(&world, &sampleHitable, &camera, double(nx) / double(ny));
+    Hitable *field = CreateSphereField(world);
+
+    size_t mismatch = CheckOnPlane<4>() + CheckOnPlane<8>() + CheckOnPlane<16>();
+    mismatch += Benchmark<4>("cornell", world, camera, nx, ny);
+    mismatch += Benchmark<8>("cornell", world, camera, nx, ny);
+    mismatch += Benchmark<16>("cornell", world, camera, nx, ny);
+    mismatch += Benchmark<4>("spheres", field, camera, nx, ny);
+    mismatch += Benchmark<8>("spheres", field, camera, nx, ny);
+    mismatch += Benchmark<16>("spheres", field, camera, nx, ny);
+//    NextWeek test_all 的场景
+    Hitable *boxes;
+    Hitable *boxesLight;
+    Camera *boxesCamera;
+    CreateBoxesAndSpheres(&boxes, &boxesLight, &boxesCamera, double(nx) / double(ny));
+    mismatch += Benchmark<4>("test_all", boxes, boxesCamera, nx, ny);
+    mismatch += Benchmark<8>("test_all", boxes, boxesCamera, nx, ny);
+    mismatch += Benchmark<16>("test_all", boxes, boxesCamera, nx, ny);
+
+//    整张图用 8 条光线一包渲染，结果和不分包时完全一样
+    ImageWriter writer("test_ray_packet_1.ppm", nx, ny, ImageFormat::PPM);
+    Renderer renderer(nx, ny, ns, camera, field, sampleHitable);
+    renderer.setPacketSize(8);
+    renderer.render(&writer);
+    writer.close();
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+    return mismatch != 0;
+}
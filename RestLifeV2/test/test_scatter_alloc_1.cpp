@@ -0,0 +1,98 @@
+#include <iostream>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+//替换全局的 new/delete（包括数组版本，和默认的 new[] / delete[] 成对），统计堆分配的次数
+//渲染器的工作线程也会分配，所以计数是原子的
+std::atomic<uint64_t> AllocationCount(0);
+
+void *operator new(size_t size) {
+    AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    std::free(p);
+}
+
+//单线程逐像素跑积分器，返回每个样本平均的堆分配次数
+void Measure(const char *name, const std::function<Vector3(const Ray &)> &integrator, Camera *camera,
+             int nx, int ny, int ns) {
+    uint64_t allocations = AllocationCount;
+    auto start = std::chrono::steady_clock::now();
+    Vector3 sum{0, 0, 0};
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            for (int s = 0; s < ns; s++) {
+                Random::StartSample(j * nx + i, s);
+                double u = double(i + Random::GenUniform()) / double(nx);
+                double v = double(j + Random::GenUniform()) / double(ny);
+                sum += deNan(integrator(camera->getRay(u, v)));
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double samples = double(nx) * ny * ns;
+    std::cout << name << ": " << (AllocationCount - allocations) / samples << " allocations/sample, "
+              << samples / seconds / 1e6 << " Msamples/s, mean " << sum.transpose() / samples << "\n";
+}
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    int nx = 200;
+    int ny = 200;
+    int ns = 16;
+
+    Hitable *world;
+    Hitable *light;
+    Camera *camera;
+    CreateCornellBox(&world, &light, &camera, double(nx) / double(ny));
+    Measure("cornell box Color", [&](const Ray &ray) { return Color(ray, world, light, 0); }, camera, nx, ny, ns);
+    Measure("cornell box PathColor", [&](const Ray &ray) { return PathColor(ray, world, light); }, camera, nx, ny, ns);
+
+    CreateCornellBoxWithSpecularSphereSampleBoth(&world, &light, &camera, double(nx) / double(ny));
+    Measure("specular sphere PathColor", [&](const Ray &ray) { return PathColor(ray, world, light); },
+            camera, nx, ny, ns);
+
+    ImageWriter writer("test_scatter_alloc_1.ppm", nx, ny, ImageFormat::PPM);
+    Renderer renderer(nx, ny, ns, camera, world, light);
+    renderer.render(&writer);
+    writer.close();
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+}
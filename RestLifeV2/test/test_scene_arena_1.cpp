@@ -0,0 +1,130 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+#include "../scene.hpp"
+#include "trace_compare.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//一万个小球：逐个 new 的球中间夹着别的分配，模拟边加载边建场景时堆上的碎片；arena 里的球紧挨着放
+size_t SphereSoup(int nx, int ny, Camera *camera) {
+    const int count = 10000;
+    Random::Seed(0);
+    std::vector<Vector3> centers;
+    for (int k = 0; k < count; k++) {
+        centers.push_back(Vector3(Random::GenUniformRandom(0, 555),
+                                  Random::GenUniformRandom(0, 555),
+                                  Random::GenUniformRandom(0, 555)));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
+    std::vector<Hitable *> heap;
+    std::vector<std::vector<char> *> padding;
+    for (const Vector3 &center : centers) {
+        heap.push_back(new Sphere(center, 5, white));
+        padding.push_back(new std::vector<char>(Random::GenUniformRandom(16, 256)));
+    }
+    LinearBVH *heapWorld = new LinearBVH(heap, 0, 1);
+    double heapBuild = Seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    Scene scene;
+    Material *arenaWhite = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.73, 0.73, 0.73}));
+    std::vector<Hitable *> arena;
+    for (const Vector3 &center : centers) {
+        arena.push_back(scene.create<Sphere>(center, 5, arenaWhite));
+    }
+    Hitable *arenaWorld = scene.create<LinearBVH>(arena, 0, 1);
+    double arenaBuild = Seconds(start);
+    std::cout << "sphere soup build: new " << heapBuild << " s, arena " << arenaBuild << " s\n  " << scene << "\n";
+
+    std::vector<double> expected = Trace("sphere soup new", heapWorld, camera, nx, ny);
+    size_t mismatch = Compare(expected, Trace("sphere soup arena", arenaWorld, camera, nx, ny), 0);
+
+    start = std::chrono::steady_clock::now();
+    delete heapWorld;
+    for (Hitable *sphere : heap) {
+        delete static_cast<Sphere *>(sphere);
+    }
+    double heapRelease = Seconds(start);
+    start = std::chrono::steady_clock::now();
+    scene.release();
+    std::cout << "sphere soup release: delete " << heapRelease << " s, arena " << Seconds(start) << " s\n";
+    for (std::vector<char> *p : padding) {
+        delete p;
+    }
+    return mismatch;
+}
+
+//渲染服务反复切换场景：每轮建一个完整场景再整体释放，看 Scene 的建树和释放开销
+void Cycles(const char *name, void (*builder)(Scene &, Float), int cycles, bool hugePages) {
+    double build = 0, release = 0;
+    size_t objects = 0, bytes = 0;
+    for (int k = 0; k < cycles; k++) {
+        auto start = std::chrono::steady_clock::now();
+        Scene *scene = new Scene(hugePages);
+        builder(*scene, 1.0);
+        build += Seconds(start);
+        objects = scene->objectCount();
+        bytes = scene->memoryBytes();
+        start = std::chrono::steady_clock::now();
+        delete scene;
+        release += Seconds(start);
+    }
+    std::cout << name << (hugePages ? " (huge pages)" : "") << ": " << objects << " objects, " << bytes / 1024
+              << " KB, build " << build / cycles * 1e3 << " ms, release " << release / cycles * 1e3 << " ms\n";
+}
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    size_t mismatch = 0;
+    int nx = 400;
+    int ny = 400;
+    int ns = 16;
+
+    Scene cornell;
+    CreateCornellBox(cornell, double(nx) / double(ny));
+    std::cout << "cornell box: " << cornell << "\n";
+    mismatch += SphereSoup(nx, ny, cornell.camera());
+
+    for (bool hugePages : {false, true}) {
+        Cycles("cornell box", CreateCornellBox, 100, hugePages);
+        Cycles("boxes and spheres", CreateBoxesAndSpheres, 10, hugePages);
+        Cycles("boxes and spheres instanced", CreateBoxesAndSpheresInstanced, 10, hugePages);
+    }
+
+//    旧接口（不释放）和 Scene 建出来的场景应当完全一样
+    Hitable *world;
+    Hitable *light;
+    Camera *camera;
+    CreateBoxesAndSpheres(&world, &light, &camera, double(nx) / double(ny));
+    std::vector<double> expected = Trace("boxes and spheres", world, camera, nx, ny);
+    Scene scene(true);
+    CreateBoxesAndSpheres(scene, double(nx) / double(ny));
+    std::cout << "  " << scene << "\n";
+    mismatch += Compare(expected, Trace("boxes and spheres scene (huge pages)", scene.world(), scene.camera(),
+                                        nx, ny), 0);
+
+    ImageWriter writer("test_scene_arena_1.ppm", nx, ny, ImageFormat::PPM);
+    Renderer renderer(nx, ny, ns, scene.camera(), scene.world(), scene.light());
+    renderer.render(&writer);
+    writer.close();
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+    return mismatch == 0 ? 0 : 1;
+}
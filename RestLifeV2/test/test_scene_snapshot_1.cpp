@@ -0,0 +1,73 @@
+//打开遍历统计，打印每条光线访问的节点数
+#define BVH_STATS
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+#include "../snapshot.hpp"
+#include "trace_compare.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+//快照里的变换和 SAH 树都是重建的，交点距离会有一点舍入误差，按相对误差比较
+const double Tolerance = 1e-6;
+
+typedef void (*SceneBuilder)(Hitable **scene, Hitable **light, Camera **camera, Float aspect);
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//建场景、存快照、再映射回来，对比建场景和打开快照的时间以及求交结果
+SceneSnapshot *RoundTrip(const char *name, SceneBuilder builder, Camera **camera, int nx, int ny,
+                         size_t &mismatch) {
+    Hitable *world, *light;
+    auto start = std::chrono::steady_clock::now();
+    builder(&world, &light, camera, double(nx) / double(ny));
+    double buildSeconds = Seconds(start);
+    std::string path = std::string(name) + ".snapshot";
+    start = std::chrono::steady_clock::now();
+    SceneSnapshot::Save(path, world, light);
+    double saveSeconds = Seconds(start);
+    start = std::chrono::steady_clock::now();
+    SceneSnapshot *snapshot = new SceneSnapshot(path);
+    double loadSeconds = Seconds(start);
+    std::cout << name << ": build " << buildSeconds * 1e3 << " ms, save " << saveSeconds * 1e3 << " ms, load "
+              << loadSeconds * 1e3 << " ms, " << snapshot->size() / 1024 << " KB\n";
+    std::vector<double> expected = Trace("  built", world, *camera, nx, ny);
+    mismatch += Compare(expected, Trace("  snapshot", snapshot->world(), *camera, nx, ny), Tolerance);
+    return snapshot;
+}
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    size_t mismatch = 0;
+    int nx = 400;
+    int ny = 400;
+    int ns = 16;
+
+    Camera *camera;
+    RoundTrip("cornell_box", CreateCornellBox, &camera, nx, ny, mismatch);
+    RoundTrip("boxes_and_spheres", CreateBoxesAndSpheres, &camera, nx, ny, mismatch);
+    RoundTrip("boxes_and_spheres_instanced", CreateBoxesAndSpheresInstanced, &camera, nx, ny, mismatch);
+    SceneSnapshot *snapshot = RoundTrip("specular_sphere_sample_both", CreateCornellBoxWithSpecularSphereSampleBoth,
+                                        &camera, nx, ny, mismatch);
+
+    ImageWriter writer("test_scene_snapshot_1.ppm", nx, ny, ImageFormat::PPM);
+    Renderer renderer(nx, ny, ns, camera, snapshot->world(), snapshot->light());
+    renderer.render(&writer);
+    writer.close();
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+    return mismatch == 0 ? 0 : 1;
+}
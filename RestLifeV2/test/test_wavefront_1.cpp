@@ -0,0 +1,65 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../wavefront.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+//逐像素按位比较两张图（两边的 NaN 也要一样），返回不同的像素数
+size_t Difference(const std::vector<Vector3> &expected, const std::vector<Vector3> &actual) {
+    if (expected.size() != actual.size()) {
+        return std::max(expected.size(), actual.size());
+    }
+    size_t different = 0;
+    for (size_t k = 0; k < expected.size(); k++) {
+        different += std::memcmp(expected[k].data(), actual[k].data(), sizeof(Float) * 3) != 0;
+    }
+    return different;
+}
+
+//同一个场景分别用 Renderer 和 WavefrontRenderer 渲染，输出应当完全一样
+size_t CompareRenderers(const char *name, Hitable *world, Hitable *light, Camera *camera, int nx, int ny, int ns,
+                        bool removeNan) {
+    Renderer tile(nx, ny, ns, camera, world, light);
+    tile.setDeNan(removeNan);
+    std::vector<Vector3> expected = tile.render();
+    WavefrontRenderer wavefront(nx, ny, ns, camera, world, light);
+    wavefront.setDeNan(removeNan);
+    size_t different = Difference(expected, wavefront.render());
+    std::cout << name << (removeNan ? " (deNan)" : "") << ": " << different << " pixels differ from Renderer\n";
+    return different;
+}
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    int nx = 400;
+    int ny = 400;
+    int ns = 100;
+    Hitable *world;
+    Camera *camera;
+    Hitable *sampleHitable;
+//    以光源和玻璃球采样，玻璃球会产生 NaN 样本
+    CreateCornellBoxWithSpecularSphereSampleBoth(&world, &sampleHitable, &camera, double(nx) / double(ny));
+    size_t different = CompareRenderers("specular sphere", world, sampleHitable, camera, 100, 100, 16, false);
+    different += CompareRenderers("specular sphere", world, sampleHitable, camera, 100, 100, 16, true);
+
+    ImageWriter writer("test_wavefront_1.ppm", nx, ny, ImageFormat::PPM);
+    WavefrontRenderer renderer(nx, ny, ns, camera, world, sampleHitable);
+    renderer.setDeNan(true);
+    renderer.render(&writer);
+    writer.close();
+    renderer.printStageTimes();
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+    return different == 0 ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+//打开遍历统计，打印每条光线访问的节点数
+#define BVH_STATS
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "../camera.hpp"
+#include "../ray.hpp"
+#include "../utils.hpp"
+#include "../render.hpp"
+#include "../wide_bvh.hpp"
+#include "trace_compare.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+
+using namespace std;
+
+int main() {
+    auto start = std::chrono::system_clock::now();
+    size_t mismatch = 0;
+    int nx = 400;
+    int ny = 400;
+    int ns = 16;
+
+    Random::Seed(0);
+    std::vector<Hitable *> spheres;
+    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
+    for (int k = 0; k < 10000; k++) {
+        spheres.push_back(new Sphere({Random::GenUniformRandom(0, 555),
+                                      Random::GenUniformRandom(0, 555),
+                                      Random::GenUniformRandom(0, 555)}, 4, white));
+    }
+    Camera sphereCamera({278, 278, -800}, {278, 278, 0}, {0, 1, 0}, 40, double(nx) / double(ny), 0, 10, 0, 1);
+    LinearBVH *linear = new LinearBVH(spheres, 0, 1);
+    BVH4 *wide = new BVH4(*linear);
+    std::cout << "spheres LinearBVH: " << linear->nodes().size() << " nodes, " << linear->memoryBytes() << " bytes\n";
+    std::cout << "spheres BVH4: " << wide->nodes().size() << " nodes, " << wide->memoryBytes() << " bytes\n";
+    std::vector<double> expected = Trace("spheres LinearBVH", linear, &sphereCamera, nx, ny);
+    mismatch += Compare(expected, Trace("spheres BVH4", wide, &sphereCamera, nx, ny));
+//    相机离场景很远：用矩形，交点只有一次除法，和逐个物体求交的结果可以直接比较
+//    （这么远时 Sphere::hit 自己会因为相消误差在球外报出交点，打中哪个球取决于测了哪些盒子）
+    std::vector<Hitable *> rects;
+    for (int k = 0; k < 10000; k++) {
+        double x = Random::GenUniformRandom(0, 555), y = Random::GenUniformRandom(0, 555);
+        rects.push_back(new XYRect(x, x + 8, y, y + 8, Random::GenUniformRandom(0, 555), white));
+    }
+    Camera farCamera({278, 278, -1e8}, {278, 278, 0}, {0, 1, 0}, 0.0004, 1, 0, 10, 0, 1);
+    HitableList rectList(rects);
+    expected = Trace("rects far camera HitableList", &rectList, &farCamera, 100, 100);
+    mismatch += Compare(expected, Trace("rects far camera BVH4", new BVH4(LinearBVH(rects, 0, 1)), &farCamera,
+                                        100, 100));
+
+//    场景离世界原点很远：盒子按相对根盒子中心的坐标存，外扩和每条光线访问的节点数不随偏移变大
+    std::vector<Hitable *> offsetSpheres;
+    for (Hitable *sphere : spheres) {
+        Sphere *s = static_cast<Sphere *>(sphere);
+        offsetSpheres.push_back(new Sphere(s->center() + Vector3{1e7, 0, 0}, s->radius(), white));
+    }
+    Camera offsetCamera({1e7 + 278, 278, -800}, {1e7 + 278, 278, 0}, {0, 1, 0}, 40, double(nx) / double(ny),
+                        0, 10, 0, 1);
+    LinearBVH *offsetLinear = new LinearBVH(offsetSpheres, 0, 1);
+    expected = Trace("offset spheres LinearBVH", offsetLinear, &offsetCamera, nx, ny);
+    mismatch += Compare(expected, Trace("offset spheres BVH4", new BVH4(*offsetLinear), &offsetCamera, nx, ny));
+
+    Hitable *world;
+    Camera *camera;
+    Hitable *light;
+    CreateBoxesAndSpheres(&world, &light, &camera, double(nx) / double(ny));
+    LinearBVH *flattened = new LinearBVH(static_cast<BVHNode *>(world), 0, 1);
+    BVH4 *worldWide = new BVH4(*flattened);
+    std::cout << "boxes and spheres LinearBVH: " << flattened->nodes().size() << " nodes, "
+              << flattened->memoryBytes() << " bytes\n";
+    std::cout << "boxes and spheres BVH4: " << worldWide->nodes().size() << " nodes, "
+              << worldWide->memoryBytes() << " bytes\n";
+    expected = Trace("boxes and spheres LinearBVH", flattened, camera, nx, ny);
+    mismatch += Compare(expected, Trace("boxes and spheres BVH4", worldWide, camera, nx, ny));
+
+    ImageWriter writer("test_wide_bvh_1.ppm", nx, ny, ImageFormat::PPM);
+    Renderer renderer(nx, ny, ns, camera, worldWide, light);
+    renderer.render(&writer);
+    writer.close();
+    auto stop = std::chrono::system_clock::now();
+    std::cout << "cost: " << std::chrono::duration_cast<std::chrono::seconds>(stop - start).count()
+              << " seconds\n";
+    BVH_STATS_REPORT(std::cout);
+    return mismatch == 0 ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+#ifndef TRACE_COMPARE_HPP
+#define TRACE_COMPARE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "../camera.hpp"
+#include "../hitable.hpp"
+#include "../random.hpp"
+#include "../bvh_stats.hpp"
+
+/**
+ * 比较两种加速结构求交结果的驱动程序共用的函数
+ * 每个像素一条相机光线，返回每条光线的交点距离（没打中为 -1）
+ * name 不为空时打印吞吐量和每条光线访问的节点数（只在定义了 BVH_STATS 时计数）
+ */
+std::vector<double> Trace(const char *name, Hitable *world, Camera *camera, int nx, int ny) {
+    std::vector<double> result;
+    result.reserve(size_t(nx) * ny);
+    uint64_t visits = ThreadBVHNodeVisits;
+    auto start = std::chrono::steady_clock::now();
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            Random::StartSample(j * nx + i, 0);
+            double u = double(i + Random::GenUniform()) / double(nx);
+            double v = double(j + Random::GenUniform()) / double(ny);
+            BVH_STATS_RAY(0);
+            HitRecord record;
+            result.push_back(world->hit(camera->getRay(u, v), 0.001, Infinity, record) ? record.t : -1);
+        }
+    }
+    if (name) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double rays = double(nx) * ny;
+        std::cout << name << ": " << rays / seconds / 1e6 << " Mrays/s, "
+                  << (ThreadBVHNodeVisits - visits) / rays << " nodes/ray\n";
+    }
+    return result;
+}
+
+//对给定的光线逐条求交，返回交点距离（没打中为 -1）
+std::vector<double> TraceRays(Hitable *world, const std::vector<Ray> &rays) {
+    std::vector<double> result;
+    for (const Ray &ray : rays) {
+        HitRecord record;
+        result.push_back(world->hit(ray, 0.001, Infinity, record) ? record.t : -1);
+    }
+    return result;
+}
+
+/**
+ * 球心在 x = 3^i 的 count 个单位球，SAH 会建出一条和物体数差不多深的链，检查用固定大小遍历栈的 BVH 也能建树
+ * rays 返回沿 z 轴穿过每个球心的光线
+ */
+std::vector<Hitable *> DeepSpheres(int count, Material *material, std::vector<Ray> &rays) {
+    std::vector<Hitable *> spheres;
+    double x = 1;
+    for (int i = 0; i < count; i++, x *= 3) {
+        spheres.push_back(new Sphere({x, 0, 0}, 1, material));
+        rays.push_back(Ray({x, 0, -10}, {0, 0, 1}));
+    }
+    return spheres;
+}
+
+//交点距离差超过 tolerance × max(1, |expected|) 的光线数，tolerance 为 0 时要求完全相同
+size_t Mismatch(const std::vector<double> &expected, const std::vector<double> &actual, double tolerance = 1e-9) {
+    if (expected.size() != actual.size()) {
+        return std::max(expected.size(), actual.size());
+    }
+    size_t mismatch = 0;
+    for (size_t k = 0; k < expected.size(); k++) {
+        mismatch += std::abs(expected[k] - actual[k]) > tolerance * std::max(1.0, std::abs(expected[k]));
+    }
+    return mismatch;
+}
+
+//打印并返回不一致的光线数，驱动程序累加后作为退出码的依据
+size_t Compare(const std::vector<double> &expected, const std::vector<double> &actual, double tolerance = 1e-9) {
+    size_t mismatch = Mismatch(expected, actual, tolerance);
+    std::cout << "  mismatch: " << mismatch << "\n";
+    return mismatch;
+}
+
+#endif //TRACE_COMPARE_HPP
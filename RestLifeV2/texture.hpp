@@ -1,8 +1,28 @@
 #ifndef TEXTURE_HPP
 #define TEXTURE_HPP
 
+#include <cstdint>
+
+enum class TextureType : uint8_t {
+    Constant
+};
+
+/**
+ * 纹理：类型标签加参数，value 用 switch 分派，没有虚函数
+ * 子类只负责设置标签和参数，不能添加成员，所有纹理大小相同
+ */
 class Texture {
+protected:
+    TextureType _type = TextureType::Constant;
+    Vector3 _color{0, 0, 0};
+
+    Texture() = default;
+
 public:
+    TextureType type() const {
+        return this->_type;
+    }
+
     /**
      *
      * @param u 纹理坐标
@@ -10,18 +30,24 @@ public:
      * @param p 点坐标
      * @return
      */
-    virtual Vector3d value(double u, double v, const Vector3d &p) const = 0;
+    Vector3 value(Float u, Float v, const Vector3 &p) const {
+        switch (this->_type) {
+            case TextureType::Constant:
+                return this->_color;
+        }
+        return this->_color;
+    }
 };
 
 class ConstantTexture : public Texture {
-private:
-    Vector3d _color;
 public:
     ConstantTexture() {}
 
-    ConstantTexture(const Vector3d &color) : _color(color) {}
+    ConstantTexture(const Vector3 &color) {
+        this->_color = color;
+    }
 
-    virtual Vector3d value(double u, double v, const Vector3d &p) const {
+    const Vector3 &color() const {
         return this->_color;
     }
 };
@@ -0,0 +1,177 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * 工作窃取线程池
+ * 每个线程有自己的任务队列：从自己的队头取任务，自己的做完了就从别的线程的队尾偷
+ * parallelFor 可以在任务里嵌套调用，等待的线程会顺便执行队列里的任务
+ */
+class ThreadPool {
+private:
+    struct Task {
+        const std::function<void(int)> *body;
+        int index;
+        std::atomic<int> *pending;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> _threads;
+    std::vector<std::unique_ptr<WorkQueue>> _queues;
+    std::mutex _sleepMutex;
+    std::condition_variable _sleepCondition;
+    std::mutex _doneMutex;
+    std::condition_variable _doneCondition;
+    int _queued = 0;        // 队列中尚未被取走的任务数，受 _sleepMutex 保护
+    bool _stop = false;
+
+//    当前线程在哪个线程池中的编号，不是工作线程时为 -1
+    static int &WorkerIndex(const ThreadPool *pool) {
+        thread_local const ThreadPool *owner = nullptr;
+        thread_local int index = -1;
+        if (owner != pool) {
+            owner = pool;
+            index = -1;
+        }
+        return index;
+    }
+
+    bool pop(int self, Task &task) {
+        int n = int(this->_queues.size());
+        if (self >= 0) {
+            WorkQueue &queue = *this->_queues[self];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty()) {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+                this->taken();
+                return true;
+            }
+        }
+        for (int k = 1; k <= n; k++) {
+            int victim = (self + k + n) % n;
+            if (victim == self) {
+                continue;
+            }
+            WorkQueue &queue = *this->_queues[victim];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty()) {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+                this->taken();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void taken() {
+        std::lock_guard<std::mutex> lock(this->_sleepMutex);
+        this->_queued--;
+    }
+
+    void execute(const Task &task) {
+        (*task.body)(task.index);
+        if (task.pending->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(this->_doneMutex);
+            this->_doneCondition.notify_all();
+        }
+    }
+
+    void workerLoop(int self) {
+        WorkerIndex(this) = self;
+        while (true) {
+            Task task;
+            if (this->pop(self, task)) {
+                this->execute(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(this->_sleepMutex);
+            this->_sleepCondition.wait(lock, [this] { return this->_stop || this->_queued > 0; });
+            if (this->_stop && this->_queued == 0) {
+                return;
+            }
+        }
+    }
+
+public:
+    /**
+     *
+     * @param threadCount 工作线程数，0 表示使用全部硬件线程
+     */
+    explicit ThreadPool(int threadCount = 0) {
+        if (threadCount <= 0) {
+            threadCount = std::max(1, int(std::thread::hardware_concurrency()));
+        }
+        for (int i = 0; i < threadCount; i++) {
+            this->_queues.emplace_back(new WorkQueue());
+        }
+        for (int i = 0; i < threadCount; i++) {
+            this->_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(this->_sleepMutex);
+            this->_stop = true;
+        }
+        this->_sleepCondition.notify_all();
+        for (std::thread &thread:this->_threads) {
+            thread.join();
+        }
+    }
+
+    int size() const {
+        return int(this->_threads.size());
+    }
+
+//    执行 body(0) ... body(count - 1)，全部完成后返回
+    void parallelFor(int count, const std::function<void(int)> &body) {
+        if (count <= 0) {
+            return;
+        }
+        std::atomic<int> pending(count);
+        int self = WorkerIndex(this);
+        int n = int(this->_queues.size());
+        for (int i = 0; i < count; i++) {
+//            外部线程把任务轮流分给各个线程，嵌套调用时放进自己的队列等别人来偷
+            WorkQueue &queue = *this->_queues[self >= 0 ? self : i % n];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(Task{&body, i, &pending});
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->_sleepMutex);
+            this->_queued += count;
+        }
+        this->_sleepCondition.notify_all();
+
+        while (pending.load(std::memory_order_acquire) > 0) {
+            Task task;
+            if (this->pop(self, task)) {
+                this->execute(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(this->_doneMutex);
+            this->_doneCondition.wait_for(lock, std::chrono::milliseconds(1), [&pending] {
+                return pending.load(std::memory_order_acquire) == 0;
+            });
+        }
+    }
+};
+
+#endif //THREAD_POOL_HPP
@@ -6,11 +6,23 @@
 class Translate : public Hitable {
 private:
     Hitable *_hitable;
-    Vector3d _offset;
+    Vector3 _offset;
 public:
-    Translate(Hitable *hitable, const Vector3d &offset) : _hitable(hitable), _offset(offset) {}
+    Translate(Hitable *hitable, const Vector3 &offset) : _hitable(hitable), _offset(offset) {}
 
-    virtual bool hit(const Ray &ray, double tMin, double tMax, HitRecord &record) const {
+    Hitable *hitable() const {
+        return this->_hitable;
+    }
+
+    const Vector3 &offset() const {
+        return this->_offset;
+    }
+
+    void setOffset(const Vector3 &offset) {
+        this->_offset = offset;
+    }
+
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
         Ray translateRay(ray.origin() - this->_offset, ray.direction(), ray.time());
         if (!this->_hitable->hit(translateRay, tMin, tMax, record)) {
             return false;
@@ -19,7 +31,7 @@ public:
         return true;
     };
 
-    virtual bool boundingBox(double time0, double time1, AABB &box) const {
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
         if (!this->_hitable->boundingBox(time0, time1, box)) {
             return false;
         }
@@ -30,20 +42,32 @@ public:
 
 class RotateY : public Hitable {
 private:
-    double _sinTheta;
-    double _cosTheta;
+    Float _sinTheta;
+    Float _cosTheta;
     Hitable *_hitable;
 public:
-    RotateY(Hitable *hitable, double angle) : _hitable(hitable) {
+    RotateY(Hitable *hitable, Float angle) : _hitable(hitable) {
         auto radians = degrees_to_radians(angle);
         this->_sinTheta = sin(radians);
         this->_cosTheta = cos(radians);
     }
 
+    Hitable *hitable() const {
+        return this->_hitable;
+    }
+
+    Float sinTheta() const {
+        return this->_sinTheta;
+    }
+
+    Float cosTheta() const {
+        return this->_cosTheta;
+    }
+
 
-    virtual bool hit(const Ray &ray, double tMin, double tMax, HitRecord &record) const {
-        Vector3d rotatedOrigin = ray.origin();
-        Vector3d rotatedDirection = ray.direction();
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
+        Vector3 rotatedOrigin = ray.origin();
+        Vector3 rotatedDirection = ray.direction();
 
         rotatedOrigin[0] = this->_cosTheta * ray.origin()[0] - this->_sinTheta * ray.origin()[2];
         rotatedOrigin[2] = this->_sinTheta * ray.origin()[0] + this->_cosTheta * ray.origin()[2];
@@ -57,8 +81,8 @@ public:
             return false;
         }
 
-        Vector3d rawP = record.p;
-        Vector3d rawNormal = record.normal;
+        Vector3 rawP = record.p;
+        Vector3 rawNormal = record.normal;
 
         rawP[0] = this->_cosTheta * record.p[0] + this->_sinTheta * record.p[2];
         rawP[2] = -this->_sinTheta * record.p[0] + this->_cosTheta * record.p[2];
@@ -72,12 +96,12 @@ public:
         return true;
     };
 
-    virtual bool boundingBox(double time0, double time1, AABB &box) const {
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
         if (!this->_hitable->boundingBox(time0, time1, box)) {
             return false;
         }
-        Vector3d min(Infinity, Infinity, Infinity);
-        Vector3d max(-Infinity, -Infinity, -Infinity);
+        Vector3 min(Infinity, Infinity, Infinity);
+        Vector3 max(-Infinity, -Infinity, -Infinity);
 
         for (int i = 0; i < 2; i++) {
             for (int j = 0; j < 2; j++) {
@@ -89,7 +113,7 @@ public:
                     auto newX = this->_cosTheta * x + this->_sinTheta * z;
                     auto newZ = -this->_sinTheta * x + this->_cosTheta * z;
 
-                    Vector3d tester(newX, y, newZ);
+                    Vector3 tester(newX, y, newZ);
 
                     for (int c = 0; c < 3; c++) {
                         min[c] = std::min(min[c], tester[c]);
@@ -4,186 +4,378 @@
 #include <vector>
 #include "hitable.hpp"
 #include "bvh.hpp"
+#include "linear_bvh.hpp"
+#include "instance.hpp"
 #include "material.hpp"
 #include "rect.hpp"
 #include "cube.hpp"
 #include "translate.hpp"
 #include "pdf.hpp"
+#include "progress.hpp"
+#include "scene.hpp"
 
-void CreateCornellBox(Hitable **scene, Hitable **light, Camera **camera, double aspect) {
+void CreateCornellBox(Scene &scene, Float aspect) {
 //    build scene
     std::vector<Hitable *> list;
-    Material *red = new Lambertian(new ConstantTexture({0.65, 0.05, 0.05}));
-    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
-    Material *green = new Lambertian(new ConstantTexture({0.12, 0.45, 0.15}));
-    Material *lightMaterial = new DiffuseLight(new ConstantTexture({15, 15, 15}));
-    list.push_back(new YZRect(0, 555, 0, 555, 555, green));         // 左墙
-    list.push_back(new YZRect(0, 555, 0, 555, 0, red));             // 右墙
+    Material *red = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.65, 0.05, 0.05}));
+    Material *white = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.73, 0.73, 0.73}));
+    Material *green = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.12, 0.45, 0.15}));
+    Material *lightMaterial = scene.create<DiffuseLight>(scene.create<ConstantTexture>(Vector3{15, 15, 15}));
+    list.push_back(scene.create<YZRect>(0, 555, 0, 555, 555, green));       // 左墙
+    list.push_back(scene.create<YZRect>(0, 555, 0, 555, 0, red));           // 右墙
 //    build light
-    *light = new XZRect(213, 343, 227, 332, 554, lightMaterial, RectNormal::FixedNegative);
-    list.push_back(*light);     // 顶灯
-    list.push_back(new XZRect(0, 555, 0, 555, 555, white));         // 顶板
-    list.push_back(new XZRect(0, 555, 0, 555, 0, white));           // 地板
-    list.push_back(new XYRect(0, 555, 0, 555, 555, white));         // 背墙
-    list.push_back(new Translate(
-            new RotateY(
-                    new Cube(
-                            {0, 0, 0}, {165, 165, 165}, white
+    Hitable *light = scene.create<XZRect>(213, 343, 227, 332, 554, lightMaterial, RectNormal::FixedNegative);
+    list.push_back(light);      // 顶灯
+    list.push_back(scene.create<XZRect>(0, 555, 0, 555, 555, white));       // 顶板
+    list.push_back(scene.create<XZRect>(0, 555, 0, 555, 0, white));         // 地板
+    list.push_back(scene.create<XYRect>(0, 555, 0, 555, 555, white));       // 背墙
+    list.push_back(scene.create<Translate>(
+            scene.create<RotateY>(
+                    scene.create<Cube>(
+                            Vector3{0, 0, 0}, Vector3{165, 165, 165}, white, scene.primitiveArena()
                     ), -18
-            ), {130, 0, 65}
+            ), Vector3{130, 0, 65}
     ));
-    list.push_back(new Translate(
-            new RotateY(
-                    new Cube(
-                            {0, 0, 0}, {165, 330, 165}, white
+    list.push_back(scene.create<Translate>(
+            scene.create<RotateY>(
+                    scene.create<Cube>(
+                            Vector3{0, 0, 0}, Vector3{165, 330, 165}, white, scene.primitiveArena()
                     ), 15
-            ), {265, 0, 295}
+            ), Vector3{265, 0, 295}
     ));
-    *scene = new BVHNode(list, 0, 1);
+    Hitable *world = scene.create<BVHNode>(list, 0, 1, scene.bvhOptions());
 
 //    build camera
-    Vector3d lookFrom{278, 278, -800};
-    Vector3d lookAt{278, 278, 0};
-    double distToFocus = 10.0;
-    double aperture = 0.0;
-    double vfov = 40.0;
-    *camera = new Camera(lookFrom, lookAt, {0, 1, 0}, vfov, aspect, aperture, distToFocus, 0.0, 1.0);
+    Vector3 lookFrom{278, 278, -800};
+    Vector3 lookAt{278, 278, 0};
+    Float distToFocus = 10.0;
+    Float aperture = 0.0;
+    Float vfov = 40.0;
+    Camera *camera = scene.create<Camera>(lookFrom, lookAt, Vector3{0, 1, 0}, vfov, aspect, aperture, distToFocus,
+                                          0.0, 1.0);
+    scene.set(world, light, camera);
 }
 
-void CreateCornellBoxWithSpecularFace(Hitable **scene, Hitable **light, Camera **camera, double aspect) {
+//和 CreateCornellBox 同一个场景，两个盒子是同一个单位立方体 BLAS 的实例
+void CreateCornellBoxInstanced(Scene &scene, Float aspect) {
+    std::vector<Hitable *> list;
+    Material *red = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.65, 0.05, 0.05}));
+    Material *white = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.73, 0.73, 0.73}));
+    Material *green = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.12, 0.45, 0.15}));
+    Material *lightMaterial = scene.create<DiffuseLight>(scene.create<ConstantTexture>(Vector3{15, 15, 15}));
+    list.push_back(scene.create<YZRect>(0, 555, 0, 555, 555, green));       // 左墙
+    list.push_back(scene.create<YZRect>(0, 555, 0, 555, 0, red));           // 右墙
+    Hitable *light = scene.create<XZRect>(213, 343, 227, 332, 554, lightMaterial, RectNormal::FixedNegative);
+    list.push_back(light);      // 顶灯
+    list.push_back(scene.create<XZRect>(0, 555, 0, 555, 555, white));       // 顶板
+    list.push_back(scene.create<XZRect>(0, 555, 0, 555, 0, white));         // 地板
+    list.push_back(scene.create<XYRect>(0, 555, 0, 555, 555, white));       // 背墙
+    Hitable *cube = scene.create<LinearBVH>(Cube::Sides({0, 0, 0}, {1, 1, 1}, white, scene.primitiveArena()), 0, 1);
+    list.push_back(scene.create<Instance>(cube, ComposeTransform(
+            ComposeTransform(TranslateTransform({130, 0, 65}), RotateYTransform(-18)),
+            ScaleTransform({165, 165, 165}))));
+    list.push_back(scene.create<Instance>(cube, ComposeTransform(
+            ComposeTransform(TranslateTransform({265, 0, 295}), RotateYTransform(15)),
+            ScaleTransform({165, 330, 165}))));
+    Hitable *world = scene.create<LinearBVH>(list, 0, 1);
+
+    Camera *camera = scene.create<Camera>(Vector3{278, 278, -800}, Vector3{278, 278, 0}, Vector3{0, 1, 0},
+                                          40.0, aspect, 0.0, 10.0, 0.0, 1.0);
+    scene.set(world, light, camera);
+}
+
+void CreateCornellBoxWithSpecularFace(Scene &scene, Float aspect) {
 //    build scene
     std::vector<Hitable *> list;
-    Material *red = new Lambertian(new ConstantTexture({0.65, 0.05, 0.05}));
-    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
-    Material *green = new Lambertian(new ConstantTexture({0.12, 0.45, 0.15}));
-    Material *lightMaterial = new DiffuseLight(new ConstantTexture({15, 15, 15}));
-    list.push_back(new YZRect(0, 555, 0, 555, 555, green));         // 左墙
-    list.push_back(new YZRect(0, 555, 0, 555, 0, red));             // 右墙
+    Material *red = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.65, 0.05, 0.05}));
+    Material *white = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.73, 0.73, 0.73}));
+    Material *green = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.12, 0.45, 0.15}));
+    Material *lightMaterial = scene.create<DiffuseLight>(scene.create<ConstantTexture>(Vector3{15, 15, 15}));
+    list.push_back(scene.create<YZRect>(0, 555, 0, 555, 555, green));       // 左墙
+    list.push_back(scene.create<YZRect>(0, 555, 0, 555, 0, red));           // 右墙
 //    build light
-    *light = new XZRect(213, 343, 227, 332, 554, lightMaterial, RectNormal::FixedNegative);
-    list.push_back(*light);     // 顶灯
-    list.push_back(new XZRect(0, 555, 0, 555, 555, white));         // 顶板
-    list.push_back(new XZRect(0, 555, 0, 555, 0, white));           // 地板
-    list.push_back(new XYRect(0, 555, 0, 555, 555, white));         // 背墙
-    list.push_back(new Translate(
-            new RotateY(
-                    new Cube(
-                            {0, 0, 0}, {165, 165, 165}, white
+    Hitable *light = scene.create<XZRect>(213, 343, 227, 332, 554, lightMaterial, RectNormal::FixedNegative);
+    list.push_back(light);      // 顶灯
+    list.push_back(scene.create<XZRect>(0, 555, 0, 555, 555, white));       // 顶板
+    list.push_back(scene.create<XZRect>(0, 555, 0, 555, 0, white));         // 地板
+    list.push_back(scene.create<XYRect>(0, 555, 0, 555, 555, white));       // 背墙
+    list.push_back(scene.create<Translate>(
+            scene.create<RotateY>(
+                    scene.create<Cube>(
+                            Vector3{0, 0, 0}, Vector3{165, 165, 165}, white, scene.primitiveArena()
                     ), -18
-            ), {130, 0, 65}
+            ), Vector3{130, 0, 65}
     ));
-    Material *aluminum = new Metal(Vector3d{0.8, 0.85, 0.88}, 0.0);
-    list.push_back(new Translate(
-            new RotateY(
-                    new Cube(
-                            {0, 0, 0}, {165, 330, 165}, aluminum
+    Material *aluminum = scene.create<Metal>(Vector3{0.8, 0.85, 0.88}, 0.0);
+    list.push_back(scene.create<Translate>(
+            scene.create<RotateY>(
+                    scene.create<Cube>(
+                            Vector3{0, 0, 0}, Vector3{165, 330, 165}, aluminum, scene.primitiveArena()
                     ), 15
-            ), {265, 0, 295}
+            ), Vector3{265, 0, 295}
     ));
-    *scene = new BVHNode(list, 0, 1);
+    Hitable *world = scene.create<BVHNode>(list, 0, 1, scene.bvhOptions());
 
 //    build camera
-    Vector3d lookFrom{278, 278, -800};
-    Vector3d lookAt{278, 278, 0};
-    double distToFocus = 10.0;
-    double aperture = 0.0;
-    double vfov = 40.0;
-    *camera = new Camera(lookFrom, lookAt, {0, 1, 0}, vfov, aspect, aperture, distToFocus, 0.0, 1.0);
+    Vector3 lookFrom{278, 278, -800};
+    Vector3 lookAt{278, 278, 0};
+    Float distToFocus = 10.0;
+    Float aperture = 0.0;
+    Float vfov = 40.0;
+    Camera *camera = scene.create<Camera>(lookFrom, lookAt, Vector3{0, 1, 0}, vfov, aspect, aperture, distToFocus,
+                                          0.0, 1.0);
+    scene.set(world, light, camera);
 }
 
-void CreateCornellBoxWithSpecularSphere(Hitable **scene, Hitable **sampleHitable, Camera **camera, double aspect) {
+void CreateCornellBoxWithSpecularSphere(Scene &scene, Float aspect) {
 //    build scene
     std::vector<Hitable *> list;
-    Material *red = new Lambertian(new ConstantTexture({0.65, 0.05, 0.05}));
-    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
-    Material *green = new Lambertian(new ConstantTexture({0.12, 0.45, 0.15}));
-    Material *lightMaterial = new DiffuseLight(new ConstantTexture({15, 15, 15}));
-    list.push_back(new YZRect(0, 555, 0, 555, 555, green));         // 左墙
-    list.push_back(new YZRect(0, 555, 0, 555, 0, red));             // 右墙
-    list.push_back(new XZRect(213, 343, 227, 332, 554, lightMaterial, RectNormal::FixedNegative));     // 顶灯
-    list.push_back(new XZRect(0, 555, 0, 555, 555, white));         // 顶板
-    list.push_back(new XZRect(0, 555, 0, 555, 0, white));           // 地板
-    list.push_back(new XYRect(0, 555, 0, 555, 555, white));         // 背墙
-    Material *glass = new Dielectric(1.5);
-    *sampleHitable = new Sphere(Vector3d{190, 90, 190}, 90, glass);
+    Material *red = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.65, 0.05, 0.05}));
+    Material *white = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.73, 0.73, 0.73}));
+    Material *green = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.12, 0.45, 0.15}));
+    Material *lightMaterial = scene.create<DiffuseLight>(scene.create<ConstantTexture>(Vector3{15, 15, 15}));
+    list.push_back(scene.create<YZRect>(0, 555, 0, 555, 555, green));       // 左墙
+    list.push_back(scene.create<YZRect>(0, 555, 0, 555, 0, red));           // 右墙
+    list.push_back(scene.create<XZRect>(213, 343, 227, 332, 554, lightMaterial, RectNormal::FixedNegative)); // 顶灯
+    list.push_back(scene.create<XZRect>(0, 555, 0, 555, 555, white));       // 顶板
+    list.push_back(scene.create<XZRect>(0, 555, 0, 555, 0, white));         // 地板
+    list.push_back(scene.create<XYRect>(0, 555, 0, 555, 555, white));       // 背墙
+    Material *glass = scene.create<Dielectric>(1.5);
+    Hitable *sampleHitable = scene.create<Sphere>(Vector3{190, 90, 190}, 90, glass);
 //    build sampleHitable
-    list.push_back(*sampleHitable);
-    list.push_back(new Translate(
-            new RotateY(
-                    new Cube(
-                            {0, 0, 0}, {165, 330, 165}, white
+    list.push_back(sampleHitable);
+    list.push_back(scene.create<Translate>(
+            scene.create<RotateY>(
+                    scene.create<Cube>(
+                            Vector3{0, 0, 0}, Vector3{165, 330, 165}, white, scene.primitiveArena()
                     ), 15
-            ), {265, 0, 295}
+            ), Vector3{265, 0, 295}
     ));
-    *scene = new BVHNode(list, 0, 1);
+    Hitable *world = scene.create<BVHNode>(list, 0, 1, scene.bvhOptions());
 
 //    build camera
-    Vector3d lookFrom{278, 278, -800};
-    Vector3d lookAt{278, 278, 0};
-    double distToFocus = 10.0;
-    double aperture = 0.0;
-    double vfov = 40.0;
-    *camera = new Camera(lookFrom, lookAt, {0, 1, 0}, vfov, aspect, aperture, distToFocus, 0.0, 1.0);
+    Vector3 lookFrom{278, 278, -800};
+    Vector3 lookAt{278, 278, 0};
+    Float distToFocus = 10.0;
+    Float aperture = 0.0;
+    Float vfov = 40.0;
+    Camera *camera = scene.create<Camera>(lookFrom, lookAt, Vector3{0, 1, 0}, vfov, aspect, aperture, distToFocus,
+                                          0.0, 1.0);
+    scene.set(world, sampleHitable, camera);
 }
 
-void
-CreateCornellBoxWithSpecularSphereSampleBoth(Hitable **scene, Hitable **sampleHitable, Camera **camera, double aspect) {
+void CreateCornellBoxWithSpecularSphereSampleBoth(Scene &scene, Float aspect) {
 //    build scene
     std::vector<Hitable *> list;
-    Material *red = new Lambertian(new ConstantTexture({0.65, 0.05, 0.05}));
-    Material *white = new Lambertian(new ConstantTexture({0.73, 0.73, 0.73}));
-    Material *green = new Lambertian(new ConstantTexture({0.12, 0.45, 0.15}));
-    Material *lightMaterial = new DiffuseLight(new ConstantTexture({15, 15, 15}));
-    list.push_back(new YZRect(0, 555, 0, 555, 555, green));         // 左墙
-    list.push_back(new YZRect(0, 555, 0, 555, 0, red));             // 右墙
-    Hitable *light = new XZRect(213, 343, 227, 332, 554, lightMaterial, RectNormal::FixedNegative);
-    list.push_back(light);     // 顶灯
-    list.push_back(new XZRect(0, 555, 0, 555, 555, white));         // 顶板
-    list.push_back(new XZRect(0, 555, 0, 555, 0, white));           // 地板
-    list.push_back(new XYRect(0, 555, 0, 555, 555, white));         // 背墙
-    Material *glass = new Dielectric(1.5);
-    Hitable *glassSphere = new Sphere(Vector3d{190, 90, 190}, 90, glass);
+    Material *red = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.65, 0.05, 0.05}));
+    Material *white = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.73, 0.73, 0.73}));
+    Material *green = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.12, 0.45, 0.15}));
+    Material *lightMaterial = scene.create<DiffuseLight>(scene.create<ConstantTexture>(Vector3{15, 15, 15}));
+    list.push_back(scene.create<YZRect>(0, 555, 0, 555, 555, green));       // 左墙
+    list.push_back(scene.create<YZRect>(0, 555, 0, 555, 0, red));           // 右墙
+    Hitable *light = scene.create<XZRect>(213, 343, 227, 332, 554, lightMaterial, RectNormal::FixedNegative);
+    list.push_back(light);      // 顶灯
+    list.push_back(scene.create<XZRect>(0, 555, 0, 555, 555, white));       // 顶板
+    list.push_back(scene.create<XZRect>(0, 555, 0, 555, 0, white));         // 地板
+    list.push_back(scene.create<XYRect>(0, 555, 0, 555, 555, white));       // 背墙
+    Material *glass = scene.create<Dielectric>(1.5);
+    Hitable *glassSphere = scene.create<Sphere>(Vector3{190, 90, 190}, 90, glass);
     list.push_back(glassSphere);
 //    build sampleHitable
-    *sampleHitable = new HitableList({light, glassSphere});
-    list.push_back(new Translate(
-            new RotateY(
-                    new Cube(
-                            {0, 0, 0}, {165, 330, 165}, white
+    Hitable *sampleHitable = scene.create<HitableList>(std::vector<Hitable *>{light, glassSphere});
+    list.push_back(scene.create<Translate>(
+            scene.create<RotateY>(
+                    scene.create<Cube>(
+                            Vector3{0, 0, 0}, Vector3{165, 330, 165}, white, scene.primitiveArena()
                     ), 15
-            ), {265, 0, 295}
+            ), Vector3{265, 0, 295}
     ));
-    *scene = new BVHNode(list, 0, 1);
+    Hitable *world = scene.create<BVHNode>(list, 0, 1, scene.bvhOptions());
+
+//    build camera
+    Vector3 lookFrom{278, 278, -800};
+    Vector3 lookAt{278, 278, 0};
+    Float distToFocus = 10.0;
+    Float aperture = 0.0;
+    Float vfov = 40.0;
+    Camera *camera = scene.create<Camera>(lookFrom, lookAt, Vector3{0, 1, 0}, vfov, aspect, aperture, distToFocus,
+                                          0.0, 1.0);
+    scene.set(world, sampleHitable, camera);
+}
+
+//NextWeek test_all 的几何部分：400 个高低不一的地面方块、1000 个小球组成的盒子和一个移动的球，用来测试 BVH
+void CreateBoxesAndSpheres(Scene &scene, Float aspect) {
+//    地面高度和小球位置用固定的种子，每次建出同一个场景
+    Random::Seed(2020);
+    std::vector<Hitable *> list;
+    Material *lightMaterial = scene.create<DiffuseLight>(scene.create<ConstantTexture>(Vector3{7, 7, 7}));
+    Hitable *light = scene.create<XZRect>(123, 423, 147, 412, 554, lightMaterial, RectNormal::FixedNegative);
+    list.push_back(light);
+//    地面
+    Material *ground = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.48, 0.83, 0.53}));
+    const int boxesPerSide = 20;
+    for (int i = 0; i < boxesPerSide; i++) {
+        for (int j = 0; j < boxesPerSide; j++) {
+            Float w = 100.0;
+            Float x0 = -1000.0 + i * w;
+            Float z0 = -1000.0 + j * w;
+            Float y1 = Random::GenUniformRandom(1, 101);
+            list.push_back(scene.create<Cube>(Vector3{x0, 0, z0}, Vector3{x0 + w, y1, z0 + w}, ground,
+                                              scene.primitiveArena()));
+        }
+    }
+//    移动的球
+    Vector3 center{400, 400, 200};
+    list.push_back(scene.create<MovingSphere>(
+            center, center + Vector3{30, 0, 0}, 0, 1, 50,
+            scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.7, 0.3, 0.1}))));
+    list.push_back(scene.create<Sphere>(Vector3{260, 150, 45}, 50, scene.create<Dielectric>(1.5)));
+    list.push_back(scene.create<Sphere>(Vector3{0, 150, 145}, 50, scene.create<Metal>(Vector3{0.8, 0.8, 0.9}, 10.0)));
+//    球球组成的盒子
+    std::vector<Hitable *> spheres;
+    Material *white = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.73, 0.73, 0.73}));
+    for (int j = 0; j < 1000; j++) {
+        spheres.push_back(scene.create<Sphere>(Vector3(Random::GenUniformRandom(0, 165),
+                                                       Random::GenUniformRandom(0, 165),
+                                                       Random::GenUniformRandom(0, 165)), 10, white));
+    }
+    list.push_back(scene.create<Translate>(
+            scene.create<RotateY>(scene.create<BVHNode>(spheres, 0, 1, scene.bvhOptions()), 15),
+            Vector3{-100, 270, 395}));
+    Hitable *world = scene.create<BVHNode>(list, 0, 1, scene.bvhOptions());
 
 //    build camera
-    Vector3d lookFrom{278, 278, -800};
-    Vector3d lookAt{278, 278, 0};
-    double distToFocus = 10.0;
-    double aperture = 0.0;
-    double vfov = 40.0;
-    *camera = new Camera(lookFrom, lookAt, {0, 1, 0}, vfov, aspect, aperture, distToFocus, 0.0, 1.0);
+    Vector3 lookFrom{478, 278, -600};
+    Vector3 lookAt{278, 278, 0};
+    Float distToFocus = 10.0;
+    Float aperture = 0.0;
+    Float vfov = 40.0;
+    Camera *camera = scene.create<Camera>(lookFrom, lookAt, Vector3{0, 1, 0}, vfov, aspect, aperture, distToFocus,
+                                          0.0, 1.0);
+    scene.set(world, light, camera);
+}
+
+//和 CreateBoxesAndSpheres 同一个场景：400 个地面盒子共享一个单位立方体 BLAS，球球盒子的 BLAS 通过实例旋转平移
+void CreateBoxesAndSpheresInstanced(Scene &scene, Float aspect) {
+    Random::Seed(2020);
+    std::vector<Hitable *> list;
+    Material *lightMaterial = scene.create<DiffuseLight>(scene.create<ConstantTexture>(Vector3{7, 7, 7}));
+    Hitable *light = scene.create<XZRect>(123, 423, 147, 412, 554, lightMaterial, RectNormal::FixedNegative);
+    list.push_back(light);
+    Material *ground = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.48, 0.83, 0.53}));
+    Hitable *cube = scene.create<LinearBVH>(Cube::Sides({0, 0, 0}, {1, 1, 1}, ground, scene.primitiveArena()), 0, 1);
+    const int boxesPerSide = 20;
+    for (int i = 0; i < boxesPerSide; i++) {
+        for (int j = 0; j < boxesPerSide; j++) {
+            Float w = 100.0;
+            Float x0 = -1000.0 + i * w;
+            Float z0 = -1000.0 + j * w;
+            Float y1 = Random::GenUniformRandom(1, 101);
+            list.push_back(scene.create<Instance>(cube, ComposeTransform(TranslateTransform({x0, 0, z0}),
+                                                                         ScaleTransform({w, y1, w}))));
+        }
+    }
+    Vector3 center{400, 400, 200};
+    list.push_back(scene.create<MovingSphere>(
+            center, center + Vector3{30, 0, 0}, 0, 1, 50,
+            scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.7, 0.3, 0.1}))));
+    list.push_back(scene.create<Sphere>(Vector3{260, 150, 45}, 50, scene.create<Dielectric>(1.5)));
+    list.push_back(scene.create<Sphere>(Vector3{0, 150, 145}, 50, scene.create<Metal>(Vector3{0.8, 0.8, 0.9}, 10.0)));
+    std::vector<Hitable *> spheres;
+    Material *white = scene.create<Lambertian>(scene.create<ConstantTexture>(Vector3{0.73, 0.73, 0.73}));
+    for (int j = 0; j < 1000; j++) {
+        spheres.push_back(scene.create<Sphere>(Vector3(Random::GenUniformRandom(0, 165),
+                                                       Random::GenUniformRandom(0, 165),
+                                                       Random::GenUniformRandom(0, 165)), 10, white));
+    }
+    list.push_back(scene.create<Instance>(
+            scene.create<LinearBVH>(spheres, 0, 1),
+            ComposeTransform(TranslateTransform({-100, 270, 395}), RotateYTransform(15))));
+    Hitable *world = scene.create<LinearBVH>(list, 0, 1);
+
+    Camera *camera = scene.create<Camera>(Vector3{478, 278, -600}, Vector3{278, 278, 0}, Vector3{0, 1, 0},
+                                          40.0, aspect, 0.0, 10.0, 0.0, 1.0);
+    scene.set(world, light, camera);
+}
+
+/**
+ * 旧接口：建一个不释放的 Scene，把其中的物体交给调用者，和原来到处 new 的行为一样
+ * 需要释放场景的调用者（例如渲染服务）应当直接用 Scene 版本
+ */
+void CreateScene(void (*builder)(Scene &, Float), Hitable **world, Hitable **light, Camera **camera, Float aspect) {
+    Scene *scene = new Scene();
+    builder(*scene, aspect);
+    *world = scene->world();
+    *light = scene->light();
+    *camera = scene->camera();
+}
+
+void CreateCornellBox(Hitable **scene, Hitable **light, Camera **camera, Float aspect) {
+    CreateScene(CreateCornellBox, scene, light, camera, aspect);
+}
+
+void CreateCornellBoxInstanced(Hitable **scene, Hitable **light, Camera **camera, Float aspect) {
+    CreateScene(CreateCornellBoxInstanced, scene, light, camera, aspect);
+}
+
+void CreateCornellBoxWithSpecularFace(Hitable **scene, Hitable **light, Camera **camera, Float aspect) {
+    CreateScene(CreateCornellBoxWithSpecularFace, scene, light, camera, aspect);
+}
+
+void CreateCornellBoxWithSpecularSphere(Hitable **scene, Hitable **sampleHitable, Camera **camera, Float aspect) {
+    CreateScene(CreateCornellBoxWithSpecularSphere, scene, sampleHitable, camera, aspect);
+}
+
+void
+CreateCornellBoxWithSpecularSphereSampleBoth(Hitable **scene, Hitable **sampleHitable, Camera **camera, Float aspect) {
+    CreateScene(CreateCornellBoxWithSpecularSphereSampleBoth, scene, sampleHitable, camera, aspect);
+}
+
+void CreateBoxesAndSpheres(Hitable **scene, Hitable **light, Camera **camera, Float aspect) {
+    CreateScene(CreateBoxesAndSpheres, scene, light, camera, aspect);
+}
+
+void CreateBoxesAndSpheresInstanced(Hitable **scene, Hitable **light, Camera **camera, Float aspect) {
+    CreateScene(CreateBoxesAndSpheresInstanced, scene, light, camera, aspect);
+}
+
+/**
+ * 按混合 pdf 采样散射方向，pdf 太小的方向重新采样
+ * 最多试 MaxMixtureAttempts 次（pdf 是 NaN 之类的退化情况下不会一直循环），都不行时返回 false，由调用方结束路径
+ */
+const int MaxMixtureAttempts = 16;
+
+bool SampleMixture(const MixturePDF &pdf, const HitRecord &hitRecord, Float time, Ray &scattered, Float &pdfValue) {
+    for (int attempt = 0; attempt < MaxMixtureAttempts; attempt++) {
+        scattered = Ray::Spawn(hitRecord.p, hitRecord.normal, pdf.generate(), time);
+        pdfValue = pdf.value(scattered.direction());
+        if (pdfValue >= PDF_Epslion) {
+            return true;
+        }
+    }
+    return false;
 }
 
-Vector3d Color(const Ray &ray, Hitable *world, Hitable *light, int depth) {
+Vector3 Color(const Ray &ray, Hitable *world, Hitable *light, int depth) {
+    ThreadRayCount++;
+    BVH_STATS_RAY(depth);
     HitRecord hitRecord;
-//    ignore hit when t is near zero
-    if (world->hit(ray, 0.001, MAXFLOAT, hitRecord)) {
+//    散射光线的起点已经推离表面，tMin 取 0
+    if (world->hit(ray, 0, MAXFLOAT, hitRecord)) {
         ScatterRecord scatterRecord;
-        Vector3d emit = hitRecord.material->emitted(ray, hitRecord, hitRecord.u, hitRecord.v, hitRecord.p);
+        Vector3 emit = hitRecord.material->emitted(ray, hitRecord, hitRecord.u, hitRecord.v, hitRecord.p);
         if (depth < 50 && hitRecord.material->scatter(ray, hitRecord, scatterRecord)) {
             if (scatterRecord.isSpecular) {
                 return scatterRecord.attenuation.array() *
                        Color(scatterRecord.specularRay, world, light, depth + 1).array();
             }
             HitablePDF lightPDF(light, hitRecord.p);
-            MixturePDF mixturePdf(&lightPDF, scatterRecord.pdf);
+            MixturePDF mixturePdf(&lightPDF, &scatterRecord.pdf);
             Ray scattered;
-            double pdfValue;
-            do {
-                scattered = Ray(hitRecord.p, mixturePdf.generate(), ray.time());
-                pdfValue = mixturePdf.value(scattered.direction());
-            } while (pdfValue < PDF_Epslion);
-            delete scatterRecord.pdf;
+            Float pdfValue;
+            if (!SampleMixture(mixturePdf, hitRecord, ray.time(), scattered, pdfValue)) {
+                return emit;
+            }
             return emit.array() +
                    scatterRecord.attenuation.array() *
                    hitRecord.material->scatterPDF(ray, hitRecord, scattered) *
@@ -197,4 +389,186 @@ Vector3d Color(const Ray &ray, Hitable *world, Hitable *light, int depth) {
     }
 }
 
+/**
+ * 路径在一个交点上的一步：累加自发光，采样下一条光线并更新通量（throughput），最后做俄罗斯轮盘赌
+ * 从第 minDepth 次弹射开始以 p = min(1, 通量最大分量) 的概率继续，继续时通量除以 p，保持无偏
+ * Type 必须是交点材质的类型，按材质类型分组批量着色时整组用同一个实例
+ * @return false 表示路径结束
+ */
+template<MaterialType Type>
+bool PathStep(Ray &ray, const HitRecord &hitRecord, Hitable *light, int depth, int minDepth, int maxDepth,
+              Vector3 &throughput, Vector3 &radiance) {
+    const Material *material = hitRecord.material;
+    ScatterRecord scatterRecord;
+    Vector3 emit = material->emittedAs<Type>(ray, hitRecord, hitRecord.u, hitRecord.v, hitRecord.p);
+    if (depth >= maxDepth || !material->scatterAs<Type>(ray, hitRecord, scatterRecord)) {
+        radiance += (throughput.array() * emit.array()).matrix();
+        return false;
+    }
+    if (scatterRecord.isSpecular) {
+        throughput = throughput.array() * scatterRecord.attenuation.array();
+        ray = scatterRecord.specularRay;
+    } else {
+        radiance += (throughput.array() * emit.array()).matrix();
+        HitablePDF lightPDF(light, hitRecord.p);
+        MixturePDF mixturePdf(&lightPDF, &scatterRecord.pdf);
+        Ray scattered;
+        Float pdfValue;
+        if (!SampleMixture(mixturePdf, hitRecord, ray.time(), scattered, pdfValue)) {
+            return false;
+        }
+        throughput = throughput.array() * scatterRecord.attenuation.array() *
+                     material->scatterPDFAs<Type>(ray, hitRecord, scattered) / pdfValue;
+        ray = scattered;
+    }
+//    俄罗斯轮盘赌
+    if (depth + 1 >= minDepth) {
+        Float p = std::min(Float(1), throughput.maxCoeff());
+        if (Random::GenUniform() >= p) {
+            return false;
+        }
+        throughput /= p;
+    }
+    return true;
+}
+
+//单个交点：按材质类型分派到对应的 PathStep
+bool PathStep(Ray &ray, const HitRecord &hitRecord, Hitable *light, int depth, int minDepth, int maxDepth,
+              Vector3 &throughput, Vector3 &radiance) {
+    bool alive = false;
+    Material::Dispatch(hitRecord.material->type(), [&](auto tag) {
+        alive = PathStep<decltype(tag)::value>(ray, hitRecord, light, depth, minDepth, maxDepth, throughput, radiance);
+    });
+    return alive;
+}
+
+/**
+ * 迭代版的 Color：在循环里累乘路径的通量，栈的使用量与深度无关
+ * 相机光线的交点已经求好（例如光线包求交）时从这里继续，found 为 false 表示相机光线没有打中任何物体
+ * minDepth > maxDepth 时不做轮盘赌，结果与 Color 的期望相同
+ */
+Vector3 PathColorFromHit(const Ray &cameraRay, bool found, const HitRecord &primaryHit,
+                         Hitable *world, Hitable *light, int minDepth = 3, int maxDepth = 50) {
+    Vector3 radiance{0, 0, 0};
+    Vector3 throughput{1, 1, 1};
+    Ray ray = cameraRay;
+    HitRecord hitRecord = primaryHit;
+    for (int depth = 0;; depth++) {
+        if (depth > 0) {
+            ThreadRayCount++;
+            BVH_STATS_RAY(depth);
+//            散射光线的起点已经推离表面，tMin 取 0
+            found = world->hit(ray, 0, MAXFLOAT, hitRecord);
+        }
+        if (!found || !PathStep(ray, hitRecord, light, depth, minDepth, maxDepth, throughput, radiance)) {
+            break;
+        }
+    }
+    return radiance;
+}
+
+Vector3 PathColor(const Ray &cameraRay, Hitable *world, Hitable *light, int minDepth = 3, int maxDepth = 50) {
+    ThreadRayCount++;
+    BVH_STATS_RAY(0);
+    HitRecord hitRecord;
+    bool found = world->hit(cameraRay, 0, MAXFLOAT, hitRecord);
+    return PathColorFromHit(cameraRay, found, hitRecord, world, light, minDepth, maxDepth);
+}
+
+//多重重要性采样的权重函数，两种策略各采一个样本
+enum class MISHeuristic {
+    Balance, Power
+};
+
+//pdf 是产生这个方向的策略的概率密度，otherPDF 是另一种策略采到同一方向的概率密度
+Float MISWeight(MISHeuristic heuristic, Float pdf, Float otherPDF) {
+    if (heuristic == MISHeuristic::Power) {
+        pdf *= pdf;
+        otherPDF *= otherPDF;
+    }
+    return pdf + otherPDF > 0 ? pdf / (pdf + otherPDF) : 0;
+}
+
+/**
+ * 多重重要性采样（MIS）的路径追踪：每个漫反射交点采一个光源方向（用阴影光线求交）和一个 BSDF 方向
+ *  光源样本打中发光物体时按光源策略的权重累加
+ *  BSDF 方向继续追踪，下一个交点的自发光按 BSDF 策略的权重累加；相机光线和镜面反射之后的光线打中光源时权重为 1
+ * 两个策略的 pdf 都按立体角计算，光源的 pdf 由 light->pdfValue 给出，光源集合里不发光的物体（例如玻璃球）只是浪费一条阴影光线
+ * 和 MixturePDF 不同，采样不到的方向直接结束路径，没有拒绝采样的循环
+ * 俄罗斯轮盘赌和 minDepth / maxDepth 的含义同 PathColor
+ */
+Vector3 MISColor(const Ray &cameraRay, Hitable *world, Hitable *light,
+                 MISHeuristic heuristic = MISHeuristic::Power, int minDepth = 3, int maxDepth = 50) {
+    Vector3 radiance{0, 0, 0};
+    Vector3 throughput{1, 1, 1};
+    Ray ray = cameraRay;
+    bool specular = true;       // ray 不是从漫反射交点按 BSDF 采样出来的
+    Float bsdfPDF = 0;          // 上一个漫反射交点采到 ray 的概率密度
+    Vector3 origin{0, 0, 0};    // 上一个漫反射交点
+    for (int depth = 0;; depth++) {
+        ThreadRayCount++;
+        BVH_STATS_RAY(depth);
+        HitRecord hitRecord;
+//        散射光线的起点已经推离表面，tMin 取 0
+        if (!world->hit(ray, 0, MAXFLOAT, hitRecord)) {
+            break;
+        }
+        const Material *material = hitRecord.material;
+        Vector3 emit = material->emitted(ray, hitRecord, hitRecord.u, hitRecord.v, hitRecord.p);
+        if (!emit.isZero()) {
+            Float weight = specular || !light ?
+                           1 : MISWeight(heuristic, bsdfPDF, light->pdfValue(origin, ray.direction()));
+            radiance += weight * (throughput.array() * emit.array()).matrix();
+        }
+        ScatterRecord scatterRecord;
+        if (depth >= maxDepth || !material->scatter(ray, hitRecord, scatterRecord)) {
+            break;
+        }
+        if (scatterRecord.isSpecular) {
+            throughput = throughput.array() * scatterRecord.attenuation.array();
+            ray = scatterRecord.specularRay;
+            specular = true;
+        } else {
+//            光源采样：背向表面的方向 BSDF 为 0，不用追踪
+            if (light) {
+                Ray shadow = Ray::Spawn(hitRecord.p, hitRecord.normal, light->random(hitRecord.p), ray.time());
+                Float lightPDF = light->pdfValue(hitRecord.p, shadow.direction());
+                Float bsdf = material->scatterPDF(ray, hitRecord, shadow);
+                if (lightPDF > 0 && bsdf > 0) {
+                    ThreadRayCount++;
+                    BVH_STATS_RAY(depth + 1);
+                    HitRecord lightRecord;
+                    if (world->hit(shadow, 0, MAXFLOAT, lightRecord)) {
+                        Vector3 lightEmit = lightRecord.material->emitted(shadow, lightRecord, lightRecord.u,
+                                                                          lightRecord.v, lightRecord.p);
+                        Float weight = MISWeight(heuristic, lightPDF, scatterRecord.pdf.value(shadow.direction()));
+                        radiance += (throughput.array() * scatterRecord.attenuation.array() *
+                                     lightEmit.array()).matrix() * (bsdf * weight / lightPDF);
+                    }
+                }
+            }
+//            BSDF 采样：继续追踪的方向
+            Ray scattered = Ray::Spawn(hitRecord.p, hitRecord.normal, scatterRecord.pdf.generate(), ray.time());
+            bsdfPDF = scatterRecord.pdf.value(scattered.direction());
+            Float bsdf = material->scatterPDF(ray, hitRecord, scattered);
+            if (bsdfPDF <= 0 || bsdf <= 0) {
+                break;
+            }
+            throughput = throughput.array() * scatterRecord.attenuation.array() * (bsdf / bsdfPDF);
+            origin = hitRecord.p;
+            specular = false;
+            ray = scattered;
+        }
+//        俄罗斯轮盘赌
+        if (depth + 1 >= minDepth) {
+            Float p = std::min(Float(1), throughput.maxCoeff());
+            if (Random::GenUniform() >= p) {
+                break;
+            }
+            throughput /= p;
+        }
+    }
+    return radiance;
+}
+
 #endif //UTILS_HPP
@@ -0,0 +1,250 @@
+#ifndef WAVEFRONT_HPP
+#define WAVEFRONT_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "render.hpp"
+
+/**
+ * 波前（wavefront）路径追踪
+ * 一次把一大批路径放在 SoA 队列里，按阶段批量处理：
+ *  generate：生成相机光线
+ *  intersect：所有活着的路径一起求交，只跑 BVH 遍历
+ *  shade：按材质类型分组（Material::ShadeBatch），每组调用对应类型的 PathStep，同一种材质的 BSDF 代码连续执行
+ *  accumulate：按样本顺序把结束路径的辐射度累加到像素
+ * 光源采样是混合 pdf 的一部分，采到的光源方向在下一次 intersect 中和普通光线一起求交，因此没有单独的阴影阶段
+ */
+class WavefrontRenderer {
+private:
+    struct PathQueue {
+        std::vector<Float> ox, oy, oz;      // 光线起点
+        std::vector<Float> dx, dy, dz;      // 光线方向
+        std::vector<Float> time;
+        std::vector<Float> tx, ty, tz;      // 通量
+        std::vector<Float> rx, ry, rz;      // 已累积的辐射度
+        std::vector<int> pixel;             // 随机数用的像素编号
+        std::vector<int> sample;
+        std::vector<int> depth;
+        std::vector<uint64_t> dimension;    // 随机数流用到了第几维
+        std::vector<HitRecord> hit;
+
+        void resize(size_t n) {
+            for (std::vector<Float> *v : {&ox, &oy, &oz, &dx, &dy, &dz, &time, &tx, &ty, &tz, &rx, &ry, &rz}) {
+                v->resize(n);
+            }
+            this->pixel.resize(n);
+            this->sample.resize(n);
+            this->depth.resize(n);
+            this->dimension.resize(n);
+            this->hit.resize(n);
+        }
+
+        Ray ray(int k) const {
+            return Ray::FromUnitDirection({this->ox[k], this->oy[k], this->oz[k]},
+                                          {this->dx[k], this->dy[k], this->dz[k]}, this->time[k]);
+        }
+
+        void setRay(int k, const Ray &ray) {
+            this->ox[k] = ray.origin().x();
+            this->oy[k] = ray.origin().y();
+            this->oz[k] = ray.origin().z();
+            this->dx[k] = ray.direction().x();
+            this->dy[k] = ray.direction().y();
+            this->dz[k] = ray.direction().z();
+            this->time[k] = ray.time();
+        }
+    };
+
+    enum Stage {
+        Generate, Intersect, Shade, Accumulate, StageCount
+    };
+
+    int _nx, _ny, _ns;
+    int _batchSize;
+    int _minDepth = 3;
+    int _maxDepth = 50;
+    bool _deNan = false;
+    Camera *_camera;
+    Hitable *_world;
+    Hitable *_light;
+    ThreadPool _pool;
+    PathQueue _queue;
+    double _stageSeconds[StageCount] = {0, 0, 0, 0};
+
+//    把 [0, count) 切成小块交给线程池
+    template<typename Body>
+    void parallelRange(int count, const Body &body) {
+        const int grain = 1024;
+        int chunks = (count + grain - 1) / grain;
+        this->_pool.parallelFor(chunks, [&](int chunk) {
+            int end = std::min(count, (chunk + 1) * grain);
+            for (int k = chunk * grain; k < end; k++) {
+                body(k);
+            }
+        });
+    }
+
+    template<typename Body>
+    void timed(Stage stage, const Body &body) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        this->_stageSeconds[stage] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+public:
+    /**
+     *
+     * @param batchSize 一批同时在队列中的路径数
+     */
+    WavefrontRenderer(int nx, int ny, int ns, Camera *camera, Hitable *world, Hitable *light,
+                      int threadCount = 0, int batchSize = 1 << 16) :
+            _nx(nx), _ny(ny), _ns(ns), _batchSize(batchSize),
+            _camera(camera), _world(world), _light(light), _pool(threadCount) {}
+
+//    俄罗斯轮盘赌的起始深度和最大深度，含义同 PathColor
+    void setDepth(int minDepth, int maxDepth) {
+        this->_minDepth = minDepth;
+        this->_maxDepth = maxDepth;
+    }
+
+//    同 Renderer::setDeNan，默认关闭，两个渲染器的默认输出一致
+    void setDeNan(bool enabled) {
+        this->_deNan = enabled;
+    }
+
+    void printStageTimes() const {
+        const char *names[StageCount] = {"generate", "intersect", "shade", "accumulate"};
+        double total = 0;
+        for (double seconds:this->_stageSeconds) {
+            total += seconds;
+        }
+        for (int stage = 0; stage < StageCount; stage++) {
+            std::cout << names[stage] << ": " << this->_stageSeconds[stage] << " seconds ("
+                      << int(100.0 * this->_stageSeconds[stage] / std::max(total, 1e-9)) << " %)\n";
+        }
+    }
+
+//    返回按 ppm 顺序排列的线性颜色，writer 不为空时每完成若干整行就交给它写出
+    std::vector<Vector3> render(ImageWriter *writer = nullptr) {
+        int64_t pixelCount = int64_t(this->_nx) * this->_ny;
+        int64_t total = pixelCount * this->_ns;
+        std::vector<Vector3> framebuffer(pixelCount, Vector3{0, 0, 0});
+        PathQueue &queue = this->_queue;
+        queue.resize(this->_batchSize);
+        std::vector<int> active, next;
+        std::vector<char> alive(this->_batchSize);
+        int rowsWritten = 0;
+
+        Progress progress(total);
+        for (int64_t base = 0; base < total; base += this->_batchSize) {
+            int count = int(std::min<int64_t>(this->_batchSize, total - base));
+            uint64_t rays = 0;
+
+//            第 g 条路径是像素 g / ns 的第 g % ns 个样本
+            this->timed(Generate, [&] {
+                this->parallelRange(count, [&](int k) {
+                    int64_t g = base + k;
+                    int y = int(g / this->_ns / this->_nx);
+                    int i = int(g / this->_ns % this->_nx);
+                    int j = this->_ny - 1 - y;
+                    queue.pixel[k] = j * this->_nx + i;
+                    queue.sample[k] = int(g % this->_ns);
+                    Random::StartSample(queue.pixel[k], queue.sample[k]);
+                    double u = double(i + Random::GenUniform()) / double(this->_nx);
+                    double v = double(j + Random::GenUniform()) / double(this->_ny);
+                    queue.setRay(k, this->_camera->getRay(u, v));
+                    queue.dimension[k] = Random::Dimension();
+                    queue.tx[k] = queue.ty[k] = queue.tz[k] = 1;
+                    queue.rx[k] = queue.ry[k] = queue.rz[k] = 0;
+                    queue.depth[k] = 0;
+                });
+                active.resize(count);
+                for (int k = 0; k < count; k++) {
+                    active[k] = k;
+                }
+            });
+
+            while (!active.empty()) {
+                int n = int(active.size());
+                rays += n;
+                this->timed(Intersect, [&] {
+                    this->parallelRange(n, [&](int a) {
+                        int k = active[a];
+                        BVH_STATS_RAY(queue.depth[k]);
+//                        散射光线的起点已经推离表面，tMin 取 0
+                        alive[k] = this->_world->hit(queue.ray(k), 0, MAXFLOAT, queue.hit[k]);
+                    });
+//                    没打中的路径直接结束
+                    active.erase(std::remove_if(active.begin(), active.end(), [&](int k) { return !alive[k]; }),
+                                 active.end());
+                });
+
+                this->timed(Shade, [&] {
+                    Material::ShadeBatch(active, [&](int k) { return queue.hit[k].material; },
+                                         [&](auto tag, size_t begin, size_t end) {
+                        this->parallelRange(int(end - begin), [&](int a) {
+                            int k = active[begin + a];
+                            Random::StartSample(queue.pixel[k], queue.sample[k], queue.dimension[k]);
+                            Ray ray = queue.ray(k);
+                            Vector3 throughput{queue.tx[k], queue.ty[k], queue.tz[k]};
+                            Vector3 radiance{queue.rx[k], queue.ry[k], queue.rz[k]};
+                            alive[k] = PathStep<decltype(tag)::value>(ray, queue.hit[k], this->_light, queue.depth[k],
+                                                                      this->_minDepth, this->_maxDepth,
+                                                                      throughput, radiance);
+                            queue.setRay(k, ray);
+                            queue.tx[k] = throughput.x();
+                            queue.ty[k] = throughput.y();
+                            queue.tz[k] = throughput.z();
+                            queue.rx[k] = radiance.x();
+                            queue.ry[k] = radiance.y();
+                            queue.rz[k] = radiance.z();
+                            queue.dimension[k] = Random::Dimension();
+                            queue.depth[k]++;
+                        });
+                    });
+                    next.clear();
+                    for (int k:active) {
+                        if (alive[k]) {
+                            next.push_back(k);
+                        }
+                    }
+                    std::swap(active, next);
+                });
+            }
+
+//            按像素分块，每个像素内按样本顺序累加，结果与线程数无关
+            this->timed(Accumulate, [&] {
+                int64_t firstPixel = base / this->_ns;
+                int64_t lastPixel = (base + count - 1) / this->_ns;
+                this->parallelRange(int(lastPixel - firstPixel + 1), [&](int p) {
+                    int64_t pixel = firstPixel + p;
+                    int64_t begin = std::max(base, pixel * this->_ns);
+                    int64_t end = std::min(base + count, (pixel + 1) * this->_ns);
+                    for (int64_t g = begin; g < end; g++) {
+                        int k = int(g - base);
+                        Vector3 col{queue.rx[k], queue.ry[k], queue.rz[k]};
+                        framebuffer[pixel] += this->_deNan ? deNan(col) : col;
+                    }
+                    if (end == (pixel + 1) * this->_ns) {
+                        framebuffer[pixel] /= double(this->_ns);
+                    }
+                });
+            });
+
+            int rowsDone = int((base + count) / this->_ns / this->_nx);
+            if (writer && rowsDone > rowsWritten) {
+                writer->submit(0, rowsWritten, this->_nx, rowsDone,
+                               &framebuffer[int64_t(rowsWritten) * this->_nx], this->_nx);
+            }
+            rowsWritten = rowsDone;
+            progress.add(count, rays);
+        }
+        progress.finish();
+        return framebuffer;
+    }
+};
+
+#endif //WAVEFRONT_HPP
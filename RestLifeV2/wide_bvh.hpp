@@ -0,0 +1,252 @@
+#ifndef WIDE_BVH_HPP
+#define WIDE_BVH_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include "linear_bvh.hpp"
+
+#if defined(__SSE2__)
+
+#include <immintrin.h>
+
+#endif
+
+/**
+ * 四叉 BVH 节点，128 字节（两条缓存行）
+ * 四个子节点的包围盒按 SoA 存放：bounds[0..2] 是 min x/y/z，bounds[3..5] 是 max x/y/z，一条 SSE 指令测四个盒子
+ */
+struct BVH4Node {
+    float bounds[6][4];
+    uint32_t child[4];      // 最高位为 1 表示叶子，低 31 位是第一个物体的下标；否则是子节点下标
+    uint16_t count[4];      // 叶子中的物体数
+    uint32_t size;          // 有效的子节点数，2 到 4
+    uint32_t pad;
+};
+
+static_assert(sizeof(BVH4Node) == 128, "BVH4Node should be 128 bytes");
+
+/**
+ * 四叉 BVH，由二叉树折叠而来：反复把面积最大的内部子节点换成它的两个子节点，直到凑满四个
+ * 遍历时一次测四个子盒子，按进入距离从近到远访问，栈里记下进入距离，弹出时已经比最近交点远的直接跳过
+ */
+class BVH4 : public Hitable {
+private:
+    static const uint32_t LeafFlag = 0x80000000u;
+    static const int StackSize = 256;
+    static const int PaddingExponent = -18;     // 盒子外扩 = 坐标量级 × 2^-18，约 32 个 float ulp
+
+    struct Entry {
+        uint32_t child;
+        uint32_t count;     // 叶子中的物体数
+        float tNear;
+    };
+
+    AABB _box;
+    std::vector<BVH4Node> _nodes;
+    std::vector<Hitable *> _primitives;
+    uint32_t _root = 0;
+    uint32_t _rootCount = 0;
+    Vector3 _center{0, 0, 0};   // 节点盒子和光线起点都以根盒子的中心为原点，用 double 减完再转 float
+    float _padding = 0;
+
+    static float RoundDown(double x) {
+        float f = float(x);
+        return double(f) > x ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    static float RoundUp(double x) {
+        float f = float(x);
+        return double(f) < x ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+
+    static double Area(const LinearBVHNode &node) {
+        double x = node.max[0] - node.min[0], y = node.max[1] - node.min[1], z = node.max[2] - node.min[2];
+        return 2.0 * (x * y + y * z + z * x);
+    }
+
+//    把 LinearBVH 的第 index 个节点变成一个子节点编码，叶子直接引用 LinearBVH 的物体范围
+    uint32_t collapse(const LinearBVH &source, uint32_t index) {
+        const LinearBVHNode &node = source.nodes()[index];
+        if (node.leaf()) {
+            return LeafFlag | node.offset;
+        }
+        std::vector<uint32_t> children{index + 1, node.offset};
+        while (children.size() < 4) {
+            int widest = -1;
+            for (int k = 0; k < int(children.size()); k++) {
+                const LinearBVHNode &child = source.nodes()[children[k]];
+                if (!child.leaf() && (widest < 0 || Area(child) > Area(source.nodes()[children[widest]]))) {
+                    widest = k;
+                }
+            }
+            if (widest < 0) {
+                break;
+            }
+            uint32_t expanded = children[widest];
+            children[widest] = expanded + 1;
+            children.insert(children.begin() + widest + 1, source.nodes()[expanded].offset);
+        }
+
+        uint32_t current = uint32_t(this->_nodes.size());
+        this->_nodes.emplace_back();
+        BVH4Node wide;
+        for (int k = 0; k < 4; k++) {
+//            空位的盒子取反，永远不会被打中；size 之外的位也会被掩掉
+            bool used = k < int(children.size());
+            const LinearBVHNode *child = used ? &source.nodes()[children[k]] : nullptr;
+            for (int a = 0; a < 3; a++) {
+                wide.bounds[a][k] = used ? RoundDown(child->min[a] - this->_center[a]) - this->_padding
+                                         : std::numeric_limits<float>::infinity();
+                wide.bounds[a + 3][k] = used ? RoundUp(child->max[a] - this->_center[a]) + this->_padding
+                                             : -std::numeric_limits<float>::infinity();
+            }
+            wide.count[k] = used && child->leaf() ? child->count : 0;
+        }
+        std::fill(wide.child, wide.child + 4, 0);
+        wide.size = uint32_t(children.size());
+        wide.pad = 0;
+        for (int k = 0; k < int(children.size()); k++) {
+            wide.child[k] = this->collapse(source, children[k]);
+        }
+        this->_nodes[current] = wide;
+        return current;
+    }
+
+    void build(const LinearBVH &source) {
+        if (source.nodes().size() > LeafFlag) {
+            throw std::runtime_error("too many nodes for BVH4");
+        }
+        source.boundingBox(0, 1, this->_box);
+//        相对坐标的量级只和场景大小有关，和场景离原点多远、光线从多远处射来无关；
+//        光线起点相对中心的坐标转成 float 时的舍入误差，按这个量级把盒子往外扩几十个 ulp 覆盖；
+//        起点在很远处时误差也大，但那个轴上的距离同样大，相对误差由遍历时的 farScale 覆盖
+        this->_center = this->_box.center();
+        double magnitude = (this->_box.max() - this->_box.min()).maxCoeff() / 2;
+        this->_padding = float(std::ldexp(magnitude, PaddingExponent));
+        this->_primitives = source.primitives();
+        this->_nodes.reserve(source.nodes().size() / 2 + 1);
+        this->_root = this->collapse(source, 0);
+        if (this->_root & LeafFlag) {
+            this->_rootCount = source.nodes()[0].count;
+        }
+    }
+
+//    一次测四个盒子，返回打中的掩码，tNear 为每个盒子的进入距离，origin 是相对 _center 的起点
+    static int HitBoxes(const BVH4Node &node, const float origin[3], const float invDir[3], const int negative[3],
+                        float tMin, float tMax, float tNear[4]) {
+#if defined(__SSE2__)
+        __m128 near = _mm_set1_ps(tMin);
+        __m128 far = _mm_set1_ps(tMax);
+        for (int a = 0; a < 3; a++) {
+            __m128 o = _mm_set1_ps(origin[a]);
+            __m128 inv = _mm_set1_ps(invDir[a]);
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[a + 3 * negative[a]]), o), inv);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[a + 3 * (1 - negative[a])]), o), inv);
+//            0 * inf 得到 NaN 时 max/min 返回第二个操作数，相当于忽略这个轴
+            near = _mm_max_ps(t0, near);
+            far = _mm_min_ps(t1, far);
+        }
+        _mm_storeu_ps(tNear, near);
+        return _mm_movemask_ps(_mm_cmple_ps(near, far)) & ((1 << node.size) - 1);
+#else
+        int mask = 0;
+        for (int k = 0; k < int(node.size); k++) {
+            float near = tMin, far = tMax;
+            for (int a = 0; a < 3; a++) {
+                float t0 = (node.bounds[a + 3 * negative[a]][k] - origin[a]) * invDir[a];
+                float t1 = (node.bounds[a + 3 * (1 - negative[a])][k] - origin[a]) * invDir[a];
+                near = t0 > near ? t0 : near;
+                far = t1 < far ? t1 : far;
+            }
+            tNear[k] = near;
+            mask |= int(near <= far) << k;
+        }
+        return mask;
+#endif
+    }
+
+public:
+    BVH4(const std::vector<Hitable *> &list, double time0, double time1,
+         const BVHBuildOptions &options = BVHBuildOptions(), BVHBuildStats *stats = nullptr) {
+        this->build(LinearBVH(list, time0, time1, options, stats));
+    }
+
+//    折叠一棵现成的 LinearBVH，物体数组会复制一份
+    explicit BVH4(const LinearBVH &source) {
+        this->build(source);
+    }
+
+    const std::vector<BVH4Node> &nodes() const {
+        return this->_nodes;
+    }
+
+    size_t memoryBytes() const {
+        return this->_nodes.size() * sizeof(BVH4Node) + this->_primitives.size() * sizeof(Hitable *);
+    }
+
+    virtual bool hit(const Ray &ray, Float tMin, Float tMax, HitRecord &record) const {
+//        float 计算的进入/离开距离有舍入误差，离开距离稍微放大一点，只会多测不会漏测
+        const float farScale = 1.0f + 4 * std::numeric_limits<float>::epsilon();
+        float origin[3], invDir[3];
+        int negative[3];
+        for (int a = 0; a < 3; a++) {
+            origin[a] = float(ray.origin()[a] - this->_center[a]);
+            invDir[a] = float(ray.invDirection()[a]);
+            negative[a] = ray.sign()[a];
+        }
+        bool hit = false;
+        HitRecord temp;
+        Entry stack[StackSize];
+        int top = 0;
+        stack[top++] = Entry{this->_root, this->_rootCount, float(tMin)};
+        while (top > 0) {
+            Entry entry = stack[--top];
+//            进栈之后已经找到了更近的交点
+            if (entry.tNear > tMax * farScale) {
+                continue;
+            }
+            if (entry.child & LeafFlag) {
+                uint32_t offset = entry.child & ~LeafFlag;
+                BVH_STATS_PRIMITIVES(entry.count);
+                for (uint32_t i = offset; i < offset + entry.count; i++) {
+                    if (this->_primitives[i]->hit(ray, tMin, tMax, temp)) {
+                        hit = true;
+                        tMax = temp.t;
+                        record = temp;
+                    }
+                }
+                continue;
+            }
+            const BVH4Node &node = this->_nodes[entry.child];
+            BVH_STATS_NODE(4);
+            float tNear[4];
+            int mask = HitBoxes(node, origin, invDir, negative, float(tMin), float(tMax) * farScale, tNear);
+//            打中的子节点按进入距离从远到近压栈，最近的最先弹出
+            int order[4], hits = 0;
+            for (int k = 0; k < 4; k++) {
+                if (mask >> k & 1) {
+                    int position = hits++;
+                    while (position > 0 && tNear[order[position - 1]] < tNear[k]) {
+                        order[position] = order[position - 1];
+                        position--;
+                    }
+                    order[position] = k;
+                }
+            }
+            for (int h = 0; h < hits; h++) {
+                int k = order[h];
+                stack[top++] = Entry{node.child[k], node.count[k], tNear[k]};
+            }
+        }
+        return hit;
+    }
+
+    virtual bool boundingBox(Float time0, Float time1, AABB &box) const {
+        box = this->_box;
+        return true;
+    }
+};
+
+#endif //WIDE_BVH_HPP